@@ -1,35 +1,47 @@
 #include "FileMonitoringManager.h"
 
 #include "FileStorageSubSystem/FileStorageManager.h"
+#include "FileStorageSubSystem/FileIngestor.h"
+#include "FileSystemScanner.h"
 #include "Utility/DatabaseRegistry.h"
-#include "Utility/JsonDtoFormat.h"
+#include "Utility/AppConfig.h"
 
 #include <QDir>
 #include <QDebug>
 #include <QFileInfo>
-#include <QDirIterator>
+#include <QtConcurrent>
+#include <QFutureWatcher>
 #include <QRandomGenerator>
 
 FileMonitoringManager::FileMonitoringManager(QObject *parent)
-    : QObject{parent}
+    : QObject{parent}, watchManager(fileWatcher, &fileSystemEventListener)
 {
-    QObject::connect(&fileSystemEventListener, &FileSystemEventListener::signalAddEventDetected,
-                     this, &FileMonitoringManager::slotOnAddEventDetected);
-
-    QObject::connect(&fileSystemEventListener, &FileSystemEventListener::signalDeleteEventDetected,
-                     this, &FileMonitoringManager::slotOnDeleteEventDetected);
-
-    QObject::connect(&fileSystemEventListener, &FileSystemEventListener::signalModificationEventDetected,
-                     this, &FileMonitoringManager::slotOnModificationEventDetected);
-
-    QObject::connect(&fileSystemEventListener, &FileSystemEventListener::signalMoveEventDetected,
-                     this, &FileMonitoringManager::slotOnMoveEventDetected);
+    QObject::connect(&fileSystemEventListener, &FileSystemEventListener::signalEventsAvailable,
+                     this, &FileMonitoringManager::slotOnEventsAvailable);
+
+    database = nullptr;
+    coalescingTimer = nullptr;
+    coalescingWindow = defaultCoalescingWindow;
+    pollTimer = nullptr;
+    pollInterval = defaultPollInterval;
+    snapshotTimer = nullptr;
+    lastReportedWatchCount = -1;
+    lastReportedPolledFolderCount = -1;
+    isEventDbUpdated = false;
 
     fileWatcher.watch();
 }
 
 FileMonitoringManager::~FileMonitoringManager()
 {
+    if(database != nullptr)
+    {
+        // Handle what is already queued so the snapshot matches the disk as closely as possible
+        drainEventQueue();
+        processPendingEvents();
+        saveSnapshot();
+    }
+
     delete database;
 }
 
@@ -43,143 +55,444 @@ void FileMonitoringManager::setPredictionList(const QStringList &newPredictionLi
     predictionList = newPredictionList;
 }
 
+int FileMonitoringManager::getCoalescingWindow() const
+{
+    return coalescingWindow;
+}
+
+void FileMonitoringManager::setCoalescingWindow(int milliseconds)
+{
+    coalescingWindow = milliseconds;
+
+    if(coalescingTimer != nullptr)
+        coalescingTimer->setInterval(coalescingWindow);
+}
+
+int FileMonitoringManager::getPollInterval() const
+{
+    return pollInterval;
+}
+
+void FileMonitoringManager::setPollInterval(int milliseconds)
+{
+    pollInterval = milliseconds;
+
+    if(pollTimer != nullptr)
+        pollTimer->setInterval(pollInterval);
+}
+
+FileSystemWatchManager::Mode FileMonitoringManager::getWatchMode() const
+{
+    return watchManager.getMode();
+}
+
+void FileMonitoringManager::setWatchMode(FileSystemWatchManager::Mode mode)
+{
+    watchManager.setMode(mode);
+}
+
+int FileMonitoringManager::getWatchBudget() const
+{
+    return watchManager.getWatchBudget();
+}
+
+void FileMonitoringManager::setWatchBudget(int watchBudget)
+{
+    watchManager.setWatchBudget(watchBudget);
+}
+
 void FileMonitoringManager::start()
 {
     database = new FileSystemEventDb(DatabaseRegistry::fileSystemEventDatabase());
 
+    // Created here so it belongs to the monitor thread
+    coalescingTimer = new QTimer(this);
+    coalescingTimer->setSingleShot(true);
+    coalescingTimer->setInterval(coalescingWindow);
+
+    QObject::connect(coalescingTimer, &QTimer::timeout,
+                     this, &FileMonitoringManager::processPendingEvents);
+
+    pollTimer = new QTimer(this);
+    pollTimer->setInterval(pollInterval);
+
+    QObject::connect(pollTimer, &QTimer::timeout,
+                     this, &FileMonitoringManager::slotOnPollTimeout);
+
+    snapshotTimer = new QTimer(this);
+    snapshotTimer->setSingleShot(true);
+    snapshotTimer->setInterval(snapshotDelay);
+
+    QObject::connect(snapshotTimer, &QTimer::timeout,
+                     this, &FileMonitoringManager::saveSnapshot);
+
+    bool isRestored = restoreFromSnapshot();
+
+    if(!isRestored) // First run or unusable snapshot, build state from scratch
+    {
+        for(const QString &item : getPredictionList())
+            monitorPredictedItem(item);
+
+        discoverUnmonitoredItems();
+    }
+
+    saveSnapshot();
+    reportWatchUtilization();
+    pollTimer->start();
+
+    emit signalEventDbUpdated();
+}
+
+void FileMonitoringManager::monitorPredictedItem(const QString &item)
+{
+    QFileInfo info(item);
+
+    if(info.exists())
+    {
+        QString folderPath;
+
+        if(info.isDir())
+            folderPath = item;
+        else
+            folderPath = info.absolutePath();
+
+        folderPath = QDir::toNativeSeparators(folderPath);
+
+        if(!folderPath.endsWith(QDir::separator()))
+            folderPath.append(QDir::separator());
+
+        efsw::WatchID watchId = watchManager.addWatch(folderPath);
+
+        if(watchId > 0) // Successfully started monitoring folder
+        {
+            database->addFolder(folderPath);
+            database->setEfswIDofFolder(folderPath, watchId);
+        }
+
+        if(info.isFile()) // Add files in any case
+        {
+            database->addFile(item);
+            database->setStatOfFile(item, FileSystemEventDb::readFileStat(item)); // Baseline for the next warm start
+        }
+    }
+    else
+    {
+        auto fsm = FileStorageManager::instance();
+        FolderDto folderDto = fsm->getFolderByUserPath(item);
+        FileDto fileDto = fsm->getFileByUserPath(item);
+
+        if(folderDto.isExist) // If folder is missing
+        {
+            database->addFolder(item);
+            database->setStatusOfFolder(item, FileSystemEventDb::ItemStatus::Missing);
+        }
+        else if(fileDto.isExist)
+        {
+            database->addFile(item);
+            database->setStatusOfFile(item, FileSystemEventDb::ItemStatus::Missing);
+        }
+        else
+            database->addMonitoringError(item, "Initialization", efsw::Error::FileNotFound);
+    }
+}
+
+bool FileMonitoringManager::restoreFromSnapshot()
+{
+    QStringList watchedFolderList;
+    bool isLoaded = database->loadSnapshot(getSnapshotFilePath(), &watchedFolderList);
+
+    if(!isLoaded)
+        return false;
+
     auto fsm = FileStorageManager::instance();
+    QSet<QString> watchedFolders(watchedFolderList.begin(), watchedFolderList.end());
+    QStringList changedFolderList;
 
-    for(const QString &item : getPredictionList())
+    // Folders, parents come before their children so deleting a parent first skips the rest of its tree
+    QStringList folderList = database->getFolderPathList();
+    folderList.sort();
+
+    for(const QString &folderPath : folderList)
     {
-        QFileInfo info(item);
+        if(!database->isFolderExist(folderPath))
+            continue;
+
+        FileSystemEventDb::ItemStatus status = database->getStatusOfFolder(folderPath);
+        bool isWatched = watchedFolders.contains(folderPath);
 
-        if(info.exists())
+        // Ancestors of monitored folders are kept in index only to link the tree
+        if(!isWatched && status != FileSystemEventDb::ItemStatus::Missing && status != FileSystemEventDb::ItemStatus::Deleted)
+            continue;
+
+        FileSystemEventDb::FileStat stat = FileSystemEventDb::readFileStat(folderPath);
+
+        if(!stat.isExist)
         {
-            QString folderPath;
+            if(status == FileSystemEventDb::ItemStatus::NewAdded)
+                database->deleteFolder(folderPath);
+            else if(status != FileSystemEventDb::ItemStatus::Deleted)
+                database->setStatusOfFolder(folderPath, FileSystemEventDb::ItemStatus::Missing);
 
-            if(info.isDir())
-                folderPath = item;
-            else
-                folderPath = info.absolutePath();
+            continue;
+        }
 
-            folderPath = QDir::toNativeSeparators(folderPath);
+        efsw::WatchID watchId = watchManager.addWatch(folderPath);
 
-            if(!folderPath.endsWith(QDir::separator()))
-                folderPath.append(QDir::separator());
+        if(watchId <= 0)
+        {
+            database->addMonitoringError(folderPath, "Initialization", watchId);
+            continue;
+        }
 
-            efsw::WatchID watchId = fileWatcher.addWatch(folderPath.toStdString(), &fileSystemEventListener, false);
+        database->setEfswIDofFolder(folderPath, watchId);
 
-            if(watchId > 0) // Successfully started monitoring folder
-            {
-                database->addFolder(folderPath);
-                database->setEfswIDofFolder(folderPath, watchId);
-            }
+        // Folder may have been saved after the snapshot was taken
+        if(status == FileSystemEventDb::ItemStatus::NewAdded && fsm->getFolderByUserPath(folderPath).isExist)
+            database->setStatusOfFolder(folderPath, FileSystemEventDb::ItemStatus::Monitored);
 
-            if(info.isFile()) // Add files in any case
-                database->addFile(item);
+        if(!isWatched) // Came back while offline
+        {
+            database->setStatusOfFolder(folderPath, FileSystemEventDb::ItemStatus::Monitored);
+            changedFolderList.append(folderPath);
         }
-        else
+        else if(stat.modifiedTime != database->getStatOfFolder(folderPath).modifiedTime) // Entries were added or removed
+            changedFolderList.append(folderPath);
+    }
+
+    // Only folders whose entries changed are listed, new subfolders are scanned as whole trees
+    QList<FileSystemScanner::ScannedFolder> scanResult;
+    QStringList newFolderList;
+
+    for(const QString &folderPath : changedFolderList)
+    {
+        FileSystemScanner::ScannedFolder scannedFolder = FileSystemScanner::list(folderPath, fsm->getFrozenUserPathsInTree(folderPath));
+
+        for(const QString &childFolderPath : scannedFolder.childFolderPaths)
         {
-            QJsonObject folderJson = fsm->getFolderJsonByUserPath(item);
-            QJsonObject fileJson = fsm->getFileJsonByUserPath(item);
+            if(!database->isFolderExist(childFolderPath))
+                newFolderList.append(childFolderPath);
+        }
 
-            if(folderJson[JsonKeys::IsExist].toBool()) // If folder is missing
-            {
-                database->addFolder(item);
-                database->setStatusOfFolder(item, FileSystemEventDb::ItemStatus::Missing);
-            }
-            else if(fileJson[JsonKeys::IsExist].toBool())
-            {
-                database->addFile(item);
-                database->setStatusOfFile(item, FileSystemEventDb::ItemStatus::Missing);
-            }
-            else
-                database->addMonitoringError(item, "Initialization", efsw::Error::FileNotFound);
+        scanResult.append(scannedFolder);
+    }
+
+    if(!newFolderList.isEmpty())
+    {
+        QSet<QString> frozenPaths;
+
+        for(const QString &folderPath : newFolderList)
+            frozenPaths.unite(fsm->getFrozenUserPathsInTree(folderPath));
+
+        scanResult.append(FileSystemScanner::scan(newFolderList, frozenPaths));
+    }
+
+    addScannedItems(scanResult);
+
+    // Files, a stat call each instead of reading content
+    for(const QString &filePath : database->getFilePathList())
+    {
+        FileSystemEventDb::ItemStatus status = database->getStatusOfFile(filePath);
+        FileSystemEventDb::FileStat stat = FileSystemEventDb::readFileStat(filePath);
+        QFileInfo info(filePath);
+
+        if(!stat.isExist)
+        {
+            if(status == FileSystemEventDb::ItemStatus::NewAdded)
+                database->deleteFile(filePath);
+            else if(status != FileSystemEventDb::ItemStatus::Deleted)
+                database->setStatusOfFile(filePath, FileSystemEventDb::ItemStatus::Missing);
         }
+        else if(status == FileSystemEventDb::ItemStatus::Missing || status == FileSystemEventDb::ItemStatus::Deleted)
+            database->setStatusOfFile(filePath, FileSystemEventDb::ItemStatus::Monitored);
+        else if(status == FileSystemEventDb::ItemStatus::NewAdded ||
+                status == FileSystemEventDb::ItemStatus::Updated ||
+                status == FileSystemEventDb::ItemStatus::Renamed)
+            reconcileFileStatus(filePath, status);
+        else if(status == FileSystemEventDb::ItemStatus::Monitored && isFileStatChanged(filePath, stat))
+            handleModificationEvent(info.fileName(), QDir::toNativeSeparators(info.absolutePath()) + QDir::separator());
+    }
+
+    // Targets added after the snapshot was taken
+    for(const QString &item : getPredictionList())
+    {
+        QString folderPath = QDir::toNativeSeparators(item);
+
+        if(!folderPath.endsWith(QDir::separator()))
+            folderPath.append(QDir::separator());
+
+        if(!database->isFileExist(item) && !database->isFolderExist(folderPath))
+            monitorPredictedItem(item);
     }
 
+    isEventDbUpdated = false; // Start emits once for the whole restore
+
+    return true;
+}
+
+void FileMonitoringManager::reconcileFileStatus(const QString &filePath, FileSystemEventDb::ItemStatus status)
+{
+    // Changes may have been saved after the snapshot was taken, so storage decides the status instead of the snapshot
+    auto fsm = FileStorageManager::instance();
+    QString oldPath = database->getOldPathOfFile(filePath);
+
+    if(!oldPath.isEmpty())
+    {
+        if(fsm->getFileByUserPath(oldPath).isExist) // Rename isn't saved yet
+            return;
+
+        database->setOldPathOfFile(filePath, "");
+    }
+
+    if(!fsm->getFileByUserPath(filePath).isExist)
+    {
+        if(status != FileSystemEventDb::ItemStatus::NewAdded)
+            database->setStatusOfFile(filePath, FileSystemEventDb::ItemStatus::NewAdded);
+
+        return;
+    }
+
+    recheckFileContent(filePath);
+}
+
+void FileMonitoringManager::saveSnapshot()
+{
+    if(snapshotTimer != nullptr)
+        snapshotTimer->stop();
+
+    bool isSaved = database->saveSnapshot(getSnapshotFilePath());
+
+    if(!isSaved)
+        qWarning() << "Couldn't save file monitor snapshot to" << getSnapshotFilePath();
+}
+
+QString FileMonitoringManager::getSnapshotFilePath() const
+{
+    return AppConfig().getStorageFolderPath() + snapshotFileName;
+}
+
+void FileMonitoringManager::discoverUnmonitoredItems()
+{
+    auto fsm = FileStorageManager::instance();
+
+    // Nested monitored folders are covered by walking their topmost ancestor
+    QStringList monitoredFolderList = database->getMonitoredFolderPathList();
+    monitoredFolderList.sort();
+
+    QStringList treeList;
+
+    for(const QString &item : monitoredFolderList)
+    {
+        if(treeList.isEmpty() || !item.startsWith(treeList.last()))
+            treeList.append(item);
+    }
+
+    QSet<QString> frozenPaths;
+
+    for(const QString &item : treeList)
+        frozenPaths.unite(fsm->getFrozenUserPathsInTree(item));
+
     // Discover not predicted folders & files
-    QStringList queryResult = database->getMonitoredFolderPathList();
-    for(const QString &queryItem : queryResult)
+    addScannedItems(FileSystemScanner::scan(treeList, frozenPaths));
+}
+
+void FileMonitoringManager::addScannedItems(const QList<FileSystemScanner::ScannedFolder> &scanResult)
+{
+    for(const FileSystemScanner::ScannedFolder &scannedFolder : scanResult)
     {
-        QDir dir(queryItem);
-        dir.setFilter(QDir::Filter::Dirs | QDir::Filter::NoDotAndDotDot);
-        QDirIterator dirIterator(dir, QDirIterator::IteratorFlag::Subdirectories);
+        QHash<QString, efsw::WatchID> newFolders;
 
-        // Insert folders
-        while(dirIterator.hasNext())
+        for(const QString &candidateFolderPath : scannedFolder.childFolderPaths)
         {
-            QFileInfo info = dirIterator.nextFileInfo();
-            QString candidateFolderPath = QDir::toNativeSeparators(info.absoluteFilePath());
-            if(!candidateFolderPath.endsWith(QDir::separator()))
-                candidateFolderPath.append(QDir::separator());
+            if(database->isFolderExist(candidateFolderPath))
+                continue;
 
-            QJsonObject folderJson = fsm->getFolderJsonByUserPath(candidateFolderPath);
+            efsw::WatchID watchId = watchManager.addWatch(candidateFolderPath);
 
-            bool isFolderMonitored = database->isFolderExist(candidateFolderPath);
-            bool isFolderFrozen = folderJson[JsonKeys::Folder::IsFrozen].toBool();
+            if(watchId <= 0) // Couldn't start monitoring folder successfully
+                database->addMonitoringError(candidateFolderPath, "Discovery", watchId);
+            else // Successfully started monitoring folder
+                newFolders.insert(candidateFolderPath, watchId);
+        }
 
-            if(!isFolderMonitored && !isFolderFrozen)
-            {
-                efsw::WatchID watchId = fileWatcher.addWatch(candidateFolderPath.toStdString(), &fileSystemEventListener, false);
+        QStringList newFiles;
 
-                if(watchId <= 0) // Couldn't start monitoring folder successfully
-                    database->addMonitoringError(candidateFolderPath, "Discovery", watchId);
-                else // Successfully started monitoring folder
-                {
-                    database->addFolder(candidateFolderPath);
-                    database->setEfswIDofFolder(candidateFolderPath, watchId);
-                    database->setStatusOfFolder(candidateFolderPath, FileSystemEventDb::ItemStatus::NewAdded);
-                }
-            }
+        for(const QString &candidateFilePath : scannedFolder.childFilePaths)
+        {
+            if(!database->isFileExist(candidateFilePath))
+                newFiles.append(candidateFilePath);
         }
 
-        dir.setPath(queryItem);
-        dir.setFilter(QDir::Filter::Files | QDir::Filter::NoDotAndDotDot);
-        QDirIterator fileIterator(dir, QDirIterator::IteratorFlag::Subdirectories);
+        database->addFolderBatch(newFolders, FileSystemEventDb::ItemStatus::NewAdded);
+        database->addFileBatch(newFiles, FileSystemEventDb::ItemStatus::NewAdded);
+    }
 
-        // Now insert files
-        while(fileIterator.hasNext())
-        {
-            QFileInfo info = fileIterator.nextFileInfo();
-            QString candidateFilePath = QDir::toNativeSeparators(info.absoluteFilePath());
-            QJsonObject fileJson = fsm->getFileJsonByUserPath(candidateFilePath);
+    // Children may be listed before their parent, so stats are set once every folder is in the index
+    for(const FileSystemScanner::ScannedFolder &scannedFolder : scanResult)
+        database->setStatOfFolder(scannedFolder.folderPath, scannedFolder.stat);
+}
 
-            bool isFileMonitored = database->isFileExist(candidateFilePath);
-            bool isFileFrozen = fileJson[JsonKeys::File::IsFrozen].toBool();
+void FileMonitoringManager::rescanMonitoredFolders()
+{
+    // Events were lost, compare monitored items against the disk instead
+    for(const QString &folderPath : database->getMonitoredFolderPathList())
+    {
+        if(!QFileInfo::exists(folderPath))
+        {
+            handleDeleteEvent("", folderPath);
+            continue;
+        }
 
-            if(!isFileMonitored && !isFileFrozen)
-            {
-                database->addFile(candidateFilePath);
-                database->setStatusOfFile(candidateFilePath, FileSystemEventDb::ItemStatus::NewAdded);
-            }
+        for(const QString &filePath : database->getDirectChildFileListOfFolder(folderPath))
+        {
+            FileSystemEventDb::FileStat stat = FileSystemEventDb::readFileStat(filePath);
+            QString fileName = QFileInfo(filePath).fileName();
+
+            if(!stat.isExist)
+                handleDeleteEvent(fileName, folderPath);
+            else if(database->getStatusOfFile(filePath) == FileSystemEventDb::ItemStatus::Monitored &&
+                    isFileStatChanged(filePath, stat)) // Modifications may be lost too, same check as warm start
+                handleModificationEvent(fileName, folderPath);
         }
     }
 
-    emit signalEventDbUpdated();
+    discoverUnmonitoredItems();
+    isEventDbUpdated = true;
+    scheduleSnapshot();
 }
 
 void FileMonitoringManager::pauseMonitoring()
 {
+    drainEventQueue();
+    processPendingEvents(); // Events seen before pausing are handled as regular events
     fileSystemEventListener.blockSignals(true);
 }
 
 void FileMonitoringManager::continueMonitoring()
 {
     fileSystemEventListener.blockSignals(false);
+    drainEventQueue(); // Re-arms notifications in case one was cut off by pausing
 }
 
 void FileMonitoringManager::addTargetAtRuntime(const QString &pathToFileOrFolder)
 {
     QFileInfo info(pathToFileOrFolder);
     if(info.isDir())
-        slotOnAddEventDetected("", pathToFileOrFolder);
+        handleAddEvent("", pathToFileOrFolder);
     else if(info.isFile())
-        slotOnAddEventDetected(info.fileName(), info.absolutePath());
+        handleAddEvent(info.fileName(), info.absolutePath());
+
+    if(isEventDbUpdated)
+    {
+        isEventDbUpdated = false;
+        emit signalEventDbUpdated();
+    }
 }
 
 void FileMonitoringManager::stopMonitoringTarget(const QString &pathToFileOrFolder)
 {
+    drainEventQueue();
+    processPendingEvents(); // Pending events could start monitoring the target again
+
     QFileInfo info(pathToFileOrFolder);
 
     if(info.isFile())
@@ -193,14 +506,124 @@ void FileMonitoringManager::stopMonitoringTarget(const QString &pathToFileOrFold
             QList<efsw::WatchID> result = database->getEfswIDListOfFolderTree(pathToFileOrFolder);
 
             for(const efsw::WatchID watchId : result)
-                fileWatcher.removeWatch(watchId);
+                watchManager.removeWatch(watchId);
 
             database->deleteFolder(pathToFileOrFolder);
         }
     }
 }
 
-void FileMonitoringManager::slotOnAddEventDetected(const QString &fileName, const QString &dir)
+void FileMonitoringManager::slotOnEventsAvailable()
+{
+    drainEventQueue();
+}
+
+void FileMonitoringManager::slotOnPollTimeout()
+{
+    if(fileSystemEventListener.signalsBlocked()) // Paused, same as watched folders
+        return;
+
+    const QList<FileSystemEventCoalescer::Event> eventList = watchManager.poll();
+
+    for(const FileSystemEventCoalescer::Event &event : eventList)
+        eventCoalescer.push(event);
+
+    if(!eventCoalescer.isEmpty() && !coalescingTimer->isActive())
+        coalescingTimer->start();
+}
+
+void FileMonitoringManager::reportWatchUtilization()
+{
+    int watchCount = watchManager.getWatchCount();
+    int polledFolderCount = watchManager.getPolledFolderCount();
+
+    if(watchCount == lastReportedWatchCount && polledFolderCount == lastReportedPolledFolderCount)
+        return;
+
+    lastReportedWatchCount = watchCount;
+    lastReportedPolledFolderCount = polledFolderCount;
+
+    emit signalWatchUtilizationChanged(watchCount, watchManager.getWatchBudget(), polledFolderCount);
+}
+
+void FileMonitoringManager::processPendingEvents()
+{
+    if(coalescingTimer != nullptr)
+        coalescingTimer->stop();
+
+    QList<FileSystemEventCoalescer::Event> batch = eventCoalescer.takeBatch();
+
+    for(const FileSystemEventCoalescer::Event &event : batch)
+    {
+        // Recursive watches also report folders which aren't monitored, such as frozen ones
+        if(!database->isFolderExist(event.dir))
+            continue;
+
+        if(event.action == efsw::Actions::Add)
+            handleAddEvent(event.fileName, event.dir);
+        else if(event.action == efsw::Actions::Delete)
+            handleDeleteEvent(event.fileName, event.dir);
+        else if(event.action == efsw::Actions::Modified)
+            handleModificationEvent(event.fileName, event.dir);
+        else if(event.action == efsw::Actions::Moved)
+            handleMoveEvent(event.fileName, event.oldFileName, event.dir);
+    }
+
+    if(isEventDbUpdated)
+    {
+        isEventDbUpdated = false;
+        emit signalEventDbUpdated();
+    }
+
+    if(!batch.isEmpty())
+        scheduleSnapshot();
+
+    reportWatchUtilization();
+}
+
+void FileMonitoringManager::scheduleSnapshot()
+{
+    // Fixed delay like the coalescing window, a steady stream of events can't postpone saving forever
+    if(snapshotTimer != nullptr && !snapshotTimer->isActive())
+        snapshotTimer->start();
+}
+
+void FileMonitoringManager::drainEventQueue()
+{
+    fileSystemEventListener.acknowledgeEventsAvailable();
+
+    FileSystemEventListener::Record record;
+
+    while(fileSystemEventListener.takeRecord(record))
+    {
+        FileSystemEventCoalescer::Event event;
+        event.action = record.action;
+        event.dir = QString::fromStdString(record.dir);
+        event.fileName = QString::fromStdString(record.fileName);
+        event.oldFileName = QString::fromStdString(record.oldFileName);
+
+        eventCoalescer.push(event);
+    }
+
+    quint64 droppedEventCount = fileSystemEventListener.takeDroppedEventCount();
+
+    if(droppedEventCount > 0 && database != nullptr)
+    {
+        qWarning() << "File monitor event queue overflowed, dropped" << droppedEventCount << "events. Rescanning.";
+        processPendingEvents();
+        rescanMonitoredFolders();
+
+        if(isEventDbUpdated)
+        {
+            isEventDbUpdated = false;
+            emit signalEventDbUpdated();
+        }
+    }
+    else if(!eventCoalescer.isEmpty() && coalescingTimer != nullptr && !coalescingTimer->isActive())
+        coalescingTimer->start(); // Fixed window, a steady stream of events can't postpone the batch forever
+}
+
+void FileMonitoringManager::handleAddEvent(const QString &fileName, const QString &dir)
 {
     QString _dir = dir;
 
@@ -220,13 +643,13 @@ void FileMonitoringManager::slotOnAddEventDetected(const QString &fileName, cons
         bool isFolderMonitored = database->isFolderExist(currentPath);
 
         auto fsm = FileStorageManager::instance();
-        QJsonObject folderJson = fsm->getFolderJsonByUserPath(currentPath);
-        bool isFolderPersists = folderJson[JsonKeys::IsExist].toBool();
-        bool isFolderFrozen = folderJson[JsonKeys::Folder::IsFrozen].toBool();
+        FolderDto folderDto = fsm->getFolderByUserPath(currentPath);
+        bool isFolderPersists = folderDto.isExist;
+        bool isFolderFrozen = folderDto.isFrozen;
 
         if(!isFolderFrozen) // Only monitor active (un-frozen) folders
         {
-            efsw::WatchID watchId = fileWatcher.addWatch(currentPath.toStdString(), &fileSystemEventListener, false);
+            efsw::WatchID watchId = watchManager.addWatch(currentPath);
 
             if(watchId <= 0) // Coludn't start monitoring folder
                 database->addMonitoringError(currentPath, "AddEvent", watchId);
@@ -249,7 +672,7 @@ void FileMonitoringManager::slotOnAddEventDetected(const QString &fileName, cons
             }
 
             if(!fileSystemEventListener.signalsBlocked()) // If monitoring paused, do not trigger ui events
-                emit signalEventDbUpdated();
+                isEventDbUpdated = true;
         }
     }
     else if(info.isFile() && !info.isHidden()) // Only accept real files
@@ -257,34 +680,44 @@ void FileMonitoringManager::slotOnAddEventDetected(const QString &fileName, cons
         FileSystemEventDb::ItemStatus status = FileSystemEventDb::ItemStatus::Invalid;
 
         auto fsm = FileStorageManager::instance();
-        QJsonObject fileJson = fsm->getFileJsonByUserPath(currentPath);
-        bool isFilePersists = fileJson[JsonKeys::IsExist].toBool();
-        bool isFileFrozen = fileJson[JsonKeys::File::IsFrozen].toBool();
+        FileDto fileDto = fsm->getFileByUserPath(currentPath);
+        bool isFilePersists = fileDto.isExist;
+        bool isFileFrozen = fileDto.isFrozen;
 
         if(!isFilePersists)
         {
             status = FileSystemEventDb::ItemStatus::NewAdded;
             database->addFile(currentPath);
             database->setStatusOfFile(currentPath, status);
-            emit signalEventDbUpdated();
+            isEventDbUpdated = true;
+
+            if(!fileSystemEventListener.signalsBlocked()) // May be the other half of a move between folders
+            {
+                QString oldPath = moveCorrelator.matchAddedFile(currentPath);
+
+                if(!oldPath.isEmpty())
+                    applyFileMove(oldPath, currentPath);
+            }
         }
         else if(isFilePersists & !isFileFrozen)
         {
-            if(fileSystemEventListener.signalsBlocked()) // If adding file at runtime
-                status = FileSystemEventDb::ItemStatus::Monitored;
-            else
-                status = FileSystemEventDb::ItemStatus::Updated;
+            bool isAlreadyUpdated = database->isFileExist(currentPath) &&
+                                    database->getStatusOfFile(currentPath) == FileSystemEventDb::ItemStatus::Updated;
 
             database->addFile(currentPath);
-            database->setStatusOfFile(currentPath, status);
+
+            if(fileSystemEventListener.signalsBlocked()) // If adding file at runtime
+                database->setStatusOfFile(currentPath, FileSystemEventDb::ItemStatus::Monitored);
+            else if(!isAlreadyUpdated) // Atomic saves replace the file, writing the same bytes again is no modification
+                recheckFileContent(currentPath);
 
             if(!fileSystemEventListener.signalsBlocked()) // If monitoring paused, do not trigger ui events
-                emit signalEventDbUpdated();
+                isEventDbUpdated = true;
         }
     }
 }
 
-void FileMonitoringManager::slotOnDeleteEventDetected(const QString &fileName, const QString &dir)
+void FileMonitoringManager::handleDeleteEvent(const QString &fileName, const QString &dir)
 {
     qDebug() << "deleteEvent = " << dir << fileName;
     qDebug() << "";
@@ -302,47 +735,80 @@ void FileMonitoringManager::slotOnDeleteEventDetected(const QString &fileName, c
         else
             database->setStatusOfFolder(currentPath, FileSystemEventDb::ItemStatus::Deleted);
 
-        fileWatcher.removeWatch(watchId);
+        watchManager.removeWatch(watchId);
 
-        emit signalEventDbUpdated();
+        isEventDbUpdated = true;
     }
     else if(database->isFileExist(currentPath)) // When file deleted
     {
-        QString originalFileName = database->getOldNameOfFile(currentPath);
-        QString originalPath = QDir::toNativeSeparators(dir + originalFileName);
+        QString originalPath = database->getOldPathOfFile(currentPath); // Empty unless renamed or moved
+        currentStatus = database->getStatusOfFile(currentPath);
 
         auto fsm = FileStorageManager::instance();
 
-        QJsonObject fileJson = fsm->getFileJsonByUserPath(currentPath);
-        QJsonObject originalFileJson = fsm->getFileJsonByUserPath(originalPath);
+        FileDto fileDto = fsm->getFileByUserPath(currentPath);
+        FileDto originalFileDto;
+
+        if(!originalPath.isEmpty())
+            originalFileDto = fsm->getFileByUserPath(originalPath);
 
-        bool isFilePersists = fileJson[JsonKeys::IsExist].toBool();
+        bool isFilePersists = fileDto.isExist;
 
-        bool isOriginalFilePersists = originalFileJson[JsonKeys::IsExist].toBool();
+        bool isOriginalFilePersists = originalFileDto.isExist;
 
         if(isOriginalFilePersists)
         {
             bool isRenamedFileAlreadyMonitored = database->isFileExist(originalPath);
 
-            if(isRenamedFileAlreadyMonitored)
-                database->deleteFile(currentPath);
-            else
+            database->deleteFile(currentPath);
+
+            if(!isRenamedFileAlreadyMonitored) // Show the file at its original location
             {
-                database->setNameOfFile(currentPath, originalFileName);
+                database->addFile(originalPath);
                 database->setStatusOfFile(originalPath, FileSystemEventDb::ItemStatus::Deleted);
-                database->setOldNameOfFile(originalPath, "");
             }
         }
         else if(isFilePersists)
+        {
             database->setStatusOfFile(currentPath, FileSystemEventDb::ItemStatus::Deleted);
+
+            if(currentStatus == FileSystemEventDb::ItemStatus::Monitored) // Content is known, it may show up in another folder
+            {
+                FileSystemMoveCorrelator::DeletedFile deletedFile;
+                deletedFile.path = currentPath;
+                deletedFile.stat = database->getStatOfFile(currentPath);
+                deletedFile.hash = fsm->getFileVersion(fileDto.symbolFilePath, fileDto.maxVersionNumber).hash;
+
+                QString newPath = moveCorrelator.matchDeletedFile(deletedFile);
+
+                if(!newPath.isEmpty())
+                    applyFileMove(currentPath, newPath);
+            }
+        }
         else
             database->deleteFile(currentPath);
 
-        emit signalEventDbUpdated();
+        isEventDbUpdated = true;
     }
 }
 
-void FileMonitoringManager::slotOnModificationEventDetected(const QString &fileName, const QString &dir)
+void FileMonitoringManager::applyFileMove(const QString &oldPath, const QString &newPath)
+{
+    bool isOldFileDeleted = database->getStatusOfFile(oldPath) == FileSystemEventDb::ItemStatus::Deleted;
+    bool isNewFileAdded = database->getStatusOfFile(newPath) == FileSystemEventDb::ItemStatus::NewAdded;
+
+    if(!isOldFileDeleted || !isNewFileAdded)
+        return;
+
+    // Storage entry is relocated on save, versions stay attached and nothing is copied
+    database->deleteFile(oldPath);
+    database->setStatusOfFile(newPath, FileSystemEventDb::ItemStatus::Renamed);
+    database->setOldPathOfFile(newPath, oldPath);
+
+    isEventDbUpdated = true;
+}
+
+void FileMonitoringManager::handleModificationEvent(const QString &fileName, const QString &dir)
 {
     qDebug() << "updateEvent = " << dir << fileName;
     qDebug() << "";
@@ -356,26 +822,161 @@ void FileMonitoringManager::slotOnModificationEventDetected(const QString &fileN
 
         // Do not count updates for new added and renamed files.
         if(status == FileSystemEventDb::ItemStatus::NewAdded || status == FileSystemEventDb::ItemStatus::Renamed)
-            emit signalEventDbUpdated();
+            isEventDbUpdated = true;
         else
         {
             auto fsm = FileStorageManager::instance();
 
-            QJsonObject fileJson = fsm->getFileJsonByUserPath(currentPath);
+            FileDto fileDto = fsm->getFileByUserPath(currentPath);
 
-            bool isFilePersists = fileJson[JsonKeys::IsExist].toBool();
-            bool isFileFrozen = fileJson[JsonKeys::File::IsFrozen].toBool();
+            bool isFilePersists = fileDto.isExist;
+            bool isFileFrozen = fileDto.isFrozen;
 
-            if(isFilePersists && !isFileFrozen)
+            if(isFilePersists && !isFileFrozen && status == FileSystemEventDb::ItemStatus::Updated)
             {
-                database->setStatusOfFile(currentPath, FileSystemEventDb::ItemStatus::Updated);
-                emit signalEventDbUpdated();
+                // Already reported, content isn't read again. Only a return to the synced metadata is noticed.
+                FileSystemEventDb::FileStat stat = FileSystemEventDb::readFileStat(currentPath);
+
+                if(stat.isExist && !isFileStatChanged(currentPath, stat) && database->getOldNameOfFile(currentPath).isEmpty())
+                {
+                    database->setStatusOfFile(currentPath, FileSystemEventDb::ItemStatus::Monitored);
+                    isEventDbUpdated = true;
+                }
             }
+            else if(isFilePersists && !isFileFrozen)
+            {
+                ContentState contentState = checkFileContent(currentPath, fileDto);
+
+                if(contentState == ContentState::Changed)
+                {
+                    database->setStatusOfFile(currentPath, FileSystemEventDb::ItemStatus::Updated);
+                    isEventDbUpdated = true;
+                }
+                else if(contentState == ContentState::Unchanged && status == FileSystemEventDb::ItemStatus::Monitored)
+                {
+                    // Remember the new metadata so the next touch is settled without hashing
+                    FileSystemEventDb::FileStat hashStat;
+                    QString hash = database->getHashOfFile(currentPath, &hashStat);
+                    database->setStatusOfFile(currentPath, FileSystemEventDb::ItemStatus::Monitored);
+                    database->setHashOfFile(currentPath, hash, hashStat);
+                }
+                // Hashing calls this again once the hash is known
+            }
+        }
+    }
+}
+
+bool FileMonitoringManager::isFileStatChanged(const QString &pathToFile, const FileSystemEventDb::FileStat &stat) const
+{
+    FileSystemEventDb::FileStat oldStat = database->getStatOfFile(pathToFile);
+
+    bool result = stat.size != oldStat.size ||
+                  stat.modifiedTime != oldStat.modifiedTime ||
+                  stat.inode != oldStat.inode;
+
+    return result;
+}
+
+FileMonitoringManager::ContentState FileMonitoringManager::checkFileContent(const QString &pathToFile, const FileDto &fileDto)
+{
+    FileSystemEventDb::FileStat stat = FileSystemEventDb::readFileStat(pathToFile);
+
+    if(!stat.isExist) // Delete event will follow
+        return ContentState::Changed;
+
+    // Metadata as of the last time file was in sync with storage
+    if(database->getStatOfFile(pathToFile).isExist && !isFileStatChanged(pathToFile, stat))
+        return ContentState::Unchanged;
+
+    auto fsm = FileStorageManager::instance();
+    FileVersionDto latestVersion = fsm->getFileVersion(fileDto.symbolFilePath, fileDto.maxVersionNumber);
+
+    if(!latestVersion.isExist || stat.size != latestVersion.size)
+        return ContentState::Changed;
+
+    // Same size with different metadata is ambiguous, only content can tell. A hash is reused while the file keeps its stat.
+    FileSystemEventDb::FileStat hashStat;
+    QString hash = database->getHashOfFile(pathToFile, &hashStat);
+
+    bool isHashValid = !hash.isEmpty() &&
+                       hashStat.isExist &&
+                       stat.size == hashStat.size &&
+                       stat.modifiedTime == hashStat.modifiedTime &&
+                       stat.inode == hashStat.inode;
+
+    if(isHashValid)
+        return hash != latestVersion.hash ? ContentState::Changed : ContentState::Unchanged;
+
+    hashFileInBackground(pathToFile, stat);
+
+    return ContentState::Hashing;
+}
+
+void FileMonitoringManager::recheckFileContent(const QString &pathToFile)
+{
+    // Compared with the stat of the last sync, not the current one
+    QFileInfo info(pathToFile);
+    FileSystemEventDb::FileStat syncedStat = database->getStatOfFile(pathToFile);
+    database->setStatusOfFile(pathToFile, FileSystemEventDb::ItemStatus::Monitored);
+    database->setStatOfFile(pathToFile, syncedStat);
+    handleModificationEvent(info.fileName(), QDir::toNativeSeparators(info.absolutePath()) + QDir::separator());
+}
+
+void FileMonitoringManager::hashFileInBackground(const QString &pathToFile, const FileSystemEventDb::FileStat &stat)
+{
+    if(hashingFilePaths.contains(pathToFile)) // Result is checked against the stat of that time, a stale one is hashed again
+        return;
+
+    hashingFilePaths.insert(pathToFile);
+
+    auto watcher = new QFutureWatcher<QString>(this);
+
+    QObject::connect(watcher, &QFutureWatcher<QString>::finished, this, [=]{
+        onFileHashed(pathToFile, stat, watcher->result());
+        watcher->deleteLater();
+    });
+
+    watcher->setFuture(QtConcurrent::run([=]{
+        FileIngestor ingestor;
+        QString result = "";
+
+        if(ingestor.hashFile(pathToFile))
+            result = ingestor.getHash();
+
+        return result;
+    }));
+}
+
+void FileMonitoringManager::onFileHashed(const QString &pathToFile, const FileSystemEventDb::FileStat &stat, const QString &hash)
+{
+    hashingFilePaths.remove(pathToFile);
+
+    if(!database->isFileExist(pathToFile))
+        return;
+
+    if(hash.isEmpty()) // Couldn't be read, can't be shown as unchanged
+    {
+        if(database->getStatusOfFile(pathToFile) == FileSystemEventDb::ItemStatus::Monitored)
+        {
+            database->setStatusOfFile(pathToFile, FileSystemEventDb::ItemStatus::Updated);
+            isEventDbUpdated = true;
         }
     }
+    else
+    {
+        QFileInfo info(pathToFile);
+        database->setHashOfFile(pathToFile, hash, stat);
+        handleModificationEvent(info.fileName(), QDir::toNativeSeparators(info.absolutePath()) + QDir::separator());
+    }
+
+    if(isEventDbUpdated)
+    {
+        isEventDbUpdated = false;
+        emit signalEventDbUpdated();
+    }
 }
 
-void FileMonitoringManager::slotOnMoveEventDetected(const QString &fileName, const QString &oldFileName, const QString &dir)
+void FileMonitoringManager::handleMoveEvent(const QString &fileName, const QString &oldFileName, const QString &dir)
 {
     qDebug() << "renameEvent (old) -> (new) = " << oldFileName << fileName << dir;
     qDebug() << "";
@@ -399,37 +1000,46 @@ void FileMonitoringManager::slotOnMoveEventDetected(const QString &fileName, con
                 database->setStatusOfFolder(currentOldPath, FileSystemEventDb::ItemStatus::Renamed);
 
             QString userFolderPath = currentOldPath + FileStorageManager::separator;
-            bool isFolderPersists = fsm->getFolderJsonByUserPath(userFolderPath)[JsonKeys::IsExist].toBool();
+            bool isFolderPersists = fsm->getFolderByUserPath(userFolderPath).isExist;
             if(isFolderPersists)
                 database->setOldNameOfFolder(currentOldPath, oldFileName);
 
             database->setPathOfFolder(currentOldPath, currentNewPath);
 
-            emit signalEventDbUpdated();
+            isEventDbUpdated = true;
         }
     }
     else if(info.isFile() && !info.isHidden())
     {
         QString originalFileName = database->getOldNameOfFile(currentOldPath);
+        QString originalPath = database->getOldPathOfFile(currentOldPath);
         FileSystemEventDb::ItemStatus statusOfOldFile = database->getStatusOfFile(currentOldPath);
-        QJsonObject newFileJson = fsm->getFileJsonByUserPath(currentNewPath);
+        FileDto newFileDto = fsm->getFileByUserPath(currentNewPath);
 
-        bool isNewFilePersists = newFileJson[JsonKeys::IsExist].toBool();
-        bool isNewFileFrozen = newFileJson[JsonKeys::File::IsFrozen].toBool();
+        bool isNewFilePersists = newFileDto.isExist;
+        bool isNewFileFrozen = newFileDto.isFrozen;
 
         bool isOldFileMonitored = database->isFileExist(currentOldPath);
         bool isNewFileMonitored = database->isFileExist(currentNewPath);
 
         if(isNewFilePersists && !isNewFileFrozen)
         {
+            bool isAlreadyUpdated = isNewFileMonitored &&
+                                    database->getStatusOfFile(currentNewPath) == FileSystemEventDb::ItemStatus::Updated;
+
             database->deleteFile(currentOldPath);
             database->deleteFile(currentNewPath);
             database->addFile(currentNewPath);
 
-            database->setOldNameOfFile(currentNewPath, originalFileName);
-            database->setStatusOfFile(currentNewPath, FileSystemEventDb::ItemStatus::Updated);
+            database->setOldPathOfFile(currentNewPath, originalPath);
 
-            emit signalEventDbUpdated();
+            // Stored file replaced by a renamed one, typically an atomic save. Only a relocation or new content is a change.
+            if(isAlreadyUpdated || !originalPath.isEmpty())
+                database->setStatusOfFile(currentNewPath, FileSystemEventDb::ItemStatus::Updated);
+            else
+                recheckFileContent(currentNewPath);
+
+            isEventDbUpdated = true;
         }
         else if(isNewFilePersists && isNewFileFrozen)
         {
@@ -442,10 +1052,10 @@ void FileMonitoringManager::slotOnMoveEventDetected(const QString &fileName, con
             database->deleteFile(currentNewPath);
             database->addFile(currentNewPath);
 
-            database->setOldNameOfFile(currentNewPath, originalFileName);
+            database->setOldPathOfFile(currentNewPath, originalPath);
             database->setStatusOfFile(currentNewPath, FileSystemEventDb::ItemStatus::NewAdded);
 
-            emit signalEventDbUpdated();
+            isEventDbUpdated = true;
         }
         else
         {
@@ -457,7 +1067,7 @@ void FileMonitoringManager::slotOnMoveEventDetected(const QString &fileName, con
 
             database->setNameOfFile(currentOldPath, fileName);
 
-            emit signalEventDbUpdated();
+            isEventDbUpdated = true;
         }
     }
 }
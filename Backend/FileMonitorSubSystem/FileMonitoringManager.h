@@ -1,10 +1,16 @@
 #ifndef FILEMONITORINGMANAGER_H
 #define FILEMONITORINGMANAGER_H
 
+#include <QTimer>
 #include <QObject>
 
 #include "Backend/FileMonitorSubSystem/FileSystemEventListener.h"
 #include "Backend/FileMonitorSubSystem/FileSystemEventDb.h"
+#include "Backend/FileMonitorSubSystem/FileSystemEventCoalescer.h"
+#include "Backend/FileMonitorSubSystem/FileSystemScanner.h"
+#include "Backend/FileMonitorSubSystem/FileSystemWatchManager.h"
+#include "Backend/FileMonitorSubSystem/FileSystemMoveCorrelator.h"
+#include "Utility/DtoTypes.h"
 
 
 class FileMonitoringManager : public QObject
@@ -17,6 +23,20 @@ public:
     QStringList getPredictionList() const;
     void setPredictionList(const QStringList &newPredictionList);
 
+    // Events arriving within the window are merged and handled as one batch
+    int getCoalescingWindow() const;
+    void setCoalescingWindow(int milliseconds);
+
+    // Folders over the watch budget are checked for changes this often
+    int getPollInterval() const;
+    void setPollInterval(int milliseconds);
+
+    // Apply to folders watched afterwards, set before start()
+    FileSystemWatchManager::Mode getWatchMode() const;
+    void setWatchMode(FileSystemWatchManager::Mode mode);
+    int getWatchBudget() const;
+    void setWatchBudget(int watchBudget);
+
 public slots:
     void start();
     void pauseMonitoring();
@@ -26,18 +46,65 @@ public slots:
 
 signals:
     void signalEventDbUpdated();
+    void signalWatchUtilizationChanged(int watchCount, int watchBudget, int polledFolderCount);
 
 private slots:
-    void slotOnAddEventDetected(const QString &fileName, const QString &dir);
-    void slotOnDeleteEventDetected(const QString &fileName, const QString &dir);
-    void slotOnModificationEventDetected(const QString &fileName, const QString &dir);
-    void slotOnMoveEventDetected(const QString &fileName, const QString &oldFileName, const QString &dir);
+    void slotOnEventsAvailable();
+    void processPendingEvents();
+    void slotOnPollTimeout();
+    void saveSnapshot();
 
 private:
+    enum ContentState
+    {
+        Unchanged,
+        Changed,
+        Hashing // Result arrives later on the monitor thread
+    };
+
+    void drainEventQueue();
+    void reportWatchUtilization();
+    void monitorPredictedItem(const QString &item);
+    bool restoreFromSnapshot();
+    void reconcileFileStatus(const QString &filePath, FileSystemEventDb::ItemStatus status);
+    void scheduleSnapshot();
+    QString getSnapshotFilePath() const;
+    void discoverUnmonitoredItems();
+    void addScannedItems(const QList<FileSystemScanner::ScannedFolder> &scanResult);
+    void rescanMonitoredFolders();
+    void handleAddEvent(const QString &fileName, const QString &dir);
+    void handleDeleteEvent(const QString &fileName, const QString &dir);
+    void handleModificationEvent(const QString &fileName, const QString &dir);
+    void handleMoveEvent(const QString &fileName, const QString &oldFileName, const QString &dir);
+    bool isFileStatChanged(const QString &pathToFile, const FileSystemEventDb::FileStat &stat) const; // Against the stored stat
+    ContentState checkFileContent(const QString &pathToFile, const FileDto &fileDto);
+    void recheckFileContent(const QString &pathToFile); // Stored file, settles as Updated or Monitored by its content
+    void hashFileInBackground(const QString &pathToFile, const FileSystemEventDb::FileStat &stat);
+    void onFileHashed(const QString &pathToFile, const FileSystemEventDb::FileStat &stat, const QString &hash);
+    void applyFileMove(const QString &oldPath, const QString &newPath);
+
+private:
+    static const inline int defaultCoalescingWindow = 100; // Milliseconds
+    static const inline int defaultPollInterval = 5000; // Milliseconds
+    static const inline int snapshotDelay = 30000; // Milliseconds after a batch, bounds what a crash loses
+    static const inline QString snapshotFileName = "monitor_snapshot.bin";
+
     FileSystemEventDb *database;
+    FileSystemEventCoalescer eventCoalescer;
+    FileSystemMoveCorrelator moveCorrelator;
+    QTimer *coalescingTimer;
+    int coalescingWindow;
+    QTimer *pollTimer;
+    int pollInterval;
+    QTimer *snapshotTimer;
+    int lastReportedWatchCount;
+    int lastReportedPolledFolderCount;
+    bool isEventDbUpdated; // Set by handlers, ui is notified once per batch
+    QSet<QString> hashingFilePaths;
     QStringList predictionList;
     FileSystemEventListener fileSystemEventListener;
     efsw::FileWatcher fileWatcher;
+    FileSystemWatchManager watchManager;
 
 };
 
@@ -0,0 +1,125 @@
+#include "FileSystemEventCoalescer.h"
+
+#include <QDir>
+
+QString FileSystemEventCoalescer::Event::path() const
+{
+    QString result = dir;
+
+    if(!result.endsWith(QDir::separator()))
+        result.append(QDir::separator());
+
+    return QDir::toNativeSeparators(result + fileName);
+}
+
+QString FileSystemEventCoalescer::Event::oldPath() const
+{
+    QString result = dir;
+
+    if(!result.endsWith(QDir::separator()))
+        result.append(QDir::separator());
+
+    return QDir::toNativeSeparators(result + oldFileName);
+}
+
+FileSystemEventCoalescer::FileSystemEventCoalescer()
+{
+    mergedEventCount = 0;
+}
+
+void FileSystemEventCoalescer::push(const Event &event)
+{
+    QString path = event.path();
+    auto last = lastEventOfPath.constFind(path);
+
+    if(event.action == efsw::Actions::Modified && last != lastEventOfPath.constEnd())
+    {
+        efsw::Action previousAction = pendingEvents[*last].action;
+
+        // Add or modification is already going to read the latest state of the file
+        if(previousAction == efsw::Actions::Add || previousAction == efsw::Actions::Modified)
+        {
+            ++mergedEventCount;
+            return;
+        }
+    }
+    else if(event.action == efsw::Actions::Delete && last != lastEventOfPath.constEnd())
+    {
+        qsizetype index = *last;
+        Event &previous = pendingEvents[index];
+
+        if(previous.action == efsw::Actions::Add || previous.action == efsw::Actions::Modified)
+        {
+            previous.action = efsw::Actions::Delete;
+            ++mergedEventCount;
+            return;
+        }
+        else if(previous.action == efsw::Actions::Moved && lastEventOfPath.value(previous.oldPath()) == index)
+        {
+            // Renamed then deleted, only the original path matters
+            previous.action = efsw::Actions::Delete;
+            previous.fileName = previous.oldFileName;
+            previous.oldFileName.clear();
+
+            lastEventOfPath.remove(path);
+            ++mergedEventCount;
+            return;
+        }
+    }
+    else if(event.action == efsw::Actions::Moved)
+    {
+        QString oldPath = event.oldPath();
+        auto lastOfOldPath = lastEventOfPath.constFind(oldPath);
+
+        if(lastOfOldPath != lastEventOfPath.constEnd())
+        {
+            qsizetype index = *lastOfOldPath;
+            Event &previous = pendingEvents[index];
+            bool isNewPathSettled = (last == lastEventOfPath.constEnd() || *last < index);
+
+            // Created then renamed (temp file saves), report it as created under the final name
+            if(previous.action == efsw::Actions::Add && isNewPathSettled)
+            {
+                previous.dir = event.dir;
+                previous.fileName = event.fileName;
+
+                lastEventOfPath.remove(oldPath);
+                lastEventOfPath.insert(path, index);
+                ++mergedEventCount;
+                return;
+            }
+        }
+    }
+
+    pendingEvents.append(event);
+    qsizetype index = pendingEvents.size() - 1;
+
+    lastEventOfPath.insert(path, index);
+
+    if(event.action == efsw::Actions::Moved)
+        lastEventOfPath.insert(event.oldPath(), index);
+}
+
+QList<FileSystemEventCoalescer::Event> FileSystemEventCoalescer::takeBatch()
+{
+    QList<Event> result;
+    result.swap(pendingEvents);
+    lastEventOfPath.clear();
+
+    return result;
+}
+
+bool FileSystemEventCoalescer::isEmpty() const
+{
+    return pendingEvents.isEmpty();
+}
+
+qsizetype FileSystemEventCoalescer::size() const
+{
+    return pendingEvents.size();
+}
+
+qlonglong FileSystemEventCoalescer::getMergedEventCount() const
+{
+    return mergedEventCount;
+}
@@ -0,0 +1,41 @@
+#ifndef FILESYSTEMEVENTCOALESCER_H
+#define FILESYSTEMEVENTCOALESCER_H
+
+#include <efsw/efsw.hpp>
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Collects raw file system events and merges the ones targeting the same path into a single net change.
+// Not thread safe, meant to be used from the file monitor thread only.
+class FileSystemEventCoalescer
+{
+public:
+    struct Event
+    {
+        efsw::Action action;
+        QString dir;
+        QString fileName;
+        QString oldFileName; // Only set for moves
+
+        QString path() const;
+        QString oldPath() const;
+    };
+
+    FileSystemEventCoalescer();
+
+    void push(const Event &event);
+    QList<Event> takeBatch();
+
+    bool isEmpty() const;
+    qsizetype size() const;
+    qlonglong getMergedEventCount() const;
+
+private:
+    QList<Event> pendingEvents;
+    QHash<QString, qsizetype> lastEventOfPath; // Index of the latest pending event touching the path
+    qlonglong mergedEventCount;
+};
+
+#endif // FILESYSTEMEVENTCOALESCER_H
@@ -1,14 +1,64 @@
 #include "FileSystemEventDb.h"
 
+#include "Utility/DatabaseRegistry.h"
+
 #include <QDir>
 #include <QUuid>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QSqlRecord>
+#include <QReadLocker>
+#include <QWriteLocker>
 #include <QStandardPaths>
 #include <QRandomGenerator>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+QReadWriteLock FileSystemEventDb::indexLock;
+QHash<QString, FileSystemEventDb::FolderRow> FileSystemEventDb::folderIndex;
+QHash<QString, FileSystemEventDb::FileRow> FileSystemEventDb::fileIndex;
+QSet<QString> FileSystemEventDb::changedFolderPaths;
+QSet<QString> FileSystemEventDb::changedFilePaths;
+bool FileSystemEventDb::isChangeJournalOverflowed = false;
+
+FileSystemEventDb::FileStat FileSystemEventDb::readFileStat(const QString &path)
+{
+    FileStat result;
+
+#ifdef Q_OS_UNIX
+    struct stat info;
+
+    if(::stat(QFile::encodeName(path).constData(), &info) == 0)
+    {
+        result.isExist = true;
+        result.size = info.st_size;
+        result.inode = info.st_ino;
+#if defined(Q_OS_DARWIN)
+        result.modifiedTime = (qint64) info.st_mtimespec.tv_sec * 1000 + info.st_mtimespec.tv_nsec / 1000000;
+#else
+        result.modifiedTime = (qint64) info.st_mtim.tv_sec * 1000 + info.st_mtim.tv_nsec / 1000000;
+#endif
+    }
+#else
+    QFileInfo info(path);
+
+    if(info.exists())
+    {
+        result.isExist = true;
+        result.size = info.size();
+        result.modifiedTime = info.lastModified().toMSecsSinceEpoch();
+    }
+#endif
+
+    return result;
+}
 
-FileSystemEventDb::FileSystemEventDb(const QSqlDatabase &eventDb)
+FileSystemEventDb::FileSystemEventDb(const QSqlDatabase &eventDb) : queryCache(eventDb)
 {
     database = eventDb;
 
@@ -18,414 +68,364 @@ FileSystemEventDb::FileSystemEventDb(const QSqlDatabase &eventDb)
 
 FileSystemEventDb::~FileSystemEventDb()
 {
+    queryCache.clear();
     database.close();
 }
 
 bool FileSystemEventDb::isFolderExist(const QString &pathToFolder) const
 {
-    bool result = false;
-
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
-
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QString nativePath = toFolderKey(pathToFolder);
 
-    QString queryTemplate = "SELECT * FROM Folder WHERE folder_path = :1;" ;
-
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.bindValue(":1", nativePath);
-    query.exec();
-
-    if(query.next())
-        result = true;
-
-    return result;
+    QReadLocker readLocker(&indexLock);
+    return folderIndex.contains(nativePath);
 }
 
 bool FileSystemEventDb::isFileExist(const QString &pathToFile) const
 {
-    bool result = false;
-
     QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    QString queryTemplate = "SELECT * FROM File WHERE file_path = :1;" ;
-
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.bindValue(":1", nativePath);
-    query.exec();
-
-    if(query.next())
-        result = true;
-
-    return result;
+    QReadLocker readLocker(&indexLock);
+    return fileIndex.contains(nativePath);
 }
 
 bool FileSystemEventDb::addFolder(const QString &pathToFolder)
 {
     QString nativePath = QDir::toNativeSeparators(pathToFolder);
 
-    if(nativePath.endsWith(QDir::separator()))
-        nativePath.chop(1);
-
-    QString queryTemplate = "INSERT INTO Folder(folder_path, parent_folder_path, event_timestamp) VALUES(:1, :2, :3);" ;
-    QStringList folderNames = nativePath.split(QDir::separator());
-    QString parentFolderPath = "";
-
-    for(const QString &folder : folderNames)
-    {
-        // Start constructing from root path
-        QString currentSubFolderPath = folder + QDir::separator();
-        QString currentFolderPath = parentFolderPath + currentSubFolderPath;
-
-        bool isInsertingRootPath = currentFolderPath == QDir::toNativeSeparators(QDir::rootPath());
+    QWriteLocker writeLocker(&indexLock);
+    return insertFolder(nativePath);
+}
 
-        bool isAlreadyInDb = isFolderExist(currentFolderPath);
+bool FileSystemEventDb::addFile(const QString &pathToFile)
+{
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-        if(!isAlreadyInDb) // If root path not in db
-        {
-            QSqlQuery query(database);
-            query.prepare(queryTemplate);
+    QWriteLocker writeLocker(&indexLock);
+    return insertFile(nativePath);
+}
 
-            query.bindValue(":1", currentFolderPath);
-            query.bindValue(":3", QDateTime::currentDateTime());
+bool FileSystemEventDb::addFolderBatch(const QHash<QString, efsw::WatchID> &folderWatchIDs, ItemStatus status)
+{
+    QDateTime timestamp = QDateTime::currentDateTime();
 
-            if(isInsertingRootPath)
-                query.bindValue(":2", QVariant()); // Bind null value.
-            else
-                query.bindValue(":2", parentFolderPath);
+    QWriteLocker writeLocker(&indexLock);
 
-            query.exec();
+    for(auto item = folderWatchIDs.constBegin(); item != folderWatchIDs.constEnd(); ++item)
+    {
+        QString nativePath = toFolderKey(item.key());
 
-            if(query.lastError().type() != QSqlError::ErrorType::NoError)
-                return false;
-        }
+        if(!insertFolder(nativePath))
+            return false;
 
-        // Set last inserted path as root path
-        parentFolderPath += currentSubFolderPath;
+        FolderRow &folder = folderIndex[nativePath];
+        folder.efswID = item.value() > 0 ? item.value() : 0;
+        folder.status = status;
+        folder.eventTimestamp = timestamp;
+        markFolderChanged(nativePath);
     }
 
     return true;
 }
 
-bool FileSystemEventDb::addFile(const QString &pathToFile)
+bool FileSystemEventDb::addFileBatch(const QStringList &filePaths, ItemStatus status)
 {
-    bool result = false;
-    QFileInfo info(pathToFile);
-
-    bool isAlreadyInDb = isFileExist(pathToFile);
-
-    if(isAlreadyInDb)
-        return true;
-
-    QString nativeFolderPath = QDir::toNativeSeparators(info.absolutePath());
-
-    if(!nativeFolderPath.endsWith(QDir::separator()))
-        nativeFolderPath.append(QDir::separator());
+    QDateTime timestamp = QDateTime::currentDateTime();
 
-    bool isFolderAdded = addFolder(nativeFolderPath);
+    QWriteLocker writeLocker(&indexLock);
 
-    if(isFolderAdded)
+    for(const QString &item : filePaths)
     {
-        QString queryTemplate = "INSERT INTO File(folder_path, file_name, event_timestamp) VALUES(:1, :2, :3);" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
+        QString nativePath = QDir::toNativeSeparators(item);
 
-        query.bindValue(":1", nativeFolderPath);
-        query.bindValue(":2", info.fileName());
-        query.bindValue(":3", QDateTime::currentDateTime());
+        if(!insertFile(nativePath))
+            return false;
 
-        query.exec();
+        auto file = fileIndex.find(nativePath);
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
+        if(file != fileIndex.end())
+        {
+            file->status = status;
+            file->eventTimestamp = timestamp;
+            markFileChanged(nativePath);
+        }
     }
 
-    return result;
+    return true;
 }
 
 bool FileSystemEventDb::deleteFolder(const QString &pathToFolder)
 {
-    bool result = false;
-
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QString nativePath = toFolderKey(pathToFolder);
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QWriteLocker writeLocker(&indexLock);
 
-    bool isFolderInDb = isFolderExist(nativePath);
+    auto folder = folderIndex.constFind(nativePath);
 
-    if(isFolderInDb)
-    {
-        QString queryTemplate = "DELETE FROM Folder WHERE folder_path = :1;" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
+    if(folder == folderIndex.constEnd())
+        return false;
 
-        query.bindValue(":1", nativePath);
+    auto parent = folderIndex.find(folder->parentFolderPath);
 
-        query.exec();
+    if(parent != folderIndex.end())
+        parent->childFolders.remove(nativePath);
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
-    }
+    removeFolder(nativePath);
 
-    return result;
+    return true;
 }
 
 bool FileSystemEventDb::deleteFile(const QString &pathToFile)
 {
-    bool result = false;
-
     QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    bool isFileInDb = isFileExist(nativePath);
-
-    if(isFileInDb)
-    {
-        QString queryTemplate = "DELETE FROM File WHERE file_path = :1;" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
-
-        query.bindValue(":1", nativePath);
+    QWriteLocker writeLocker(&indexLock);
 
-        query.exec();
+    if(!fileIndex.contains(nativePath))
+        return false;
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
-    }
+    removeFile(nativePath);
 
-    return result;
+    return true;
 }
 
 bool FileSystemEventDb::setStatusOfFolder(const QString &pathToFolder, ItemStatus status)
 {
-    bool result = false;
-
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QString nativePath = toFolderKey(pathToFolder);
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QWriteLocker writeLocker(&indexLock);
 
-    bool isFolderInDb = isFolderExist(nativePath);
+    auto folder = folderIndex.find(nativePath);
 
-    if(isFolderInDb)
-    {
-        QString queryTemplate = "UPDATE Folder SET status = :1, event_timestamp = :2 WHERE folder_path = :3;" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
-
-        query.bindValue(":1", status);
-        query.bindValue(":2", QDateTime::currentDateTime());
-        query.bindValue(":3", nativePath);
-
-        query.exec();
+    if(folder == folderIndex.end())
+        return false;
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
-    }
+    folder->status = status;
+    folder->eventTimestamp = QDateTime::currentDateTime();
+    markFolderChanged(nativePath);
 
-    return result;
+    return true;
 }
 
 bool FileSystemEventDb::setStatusOfFile(const QString &pathToFile, ItemStatus status)
 {
-    bool result = false;
-
     QString nativePath = QDir::toNativeSeparators(pathToFile);
+    FileStat stat;
 
-    bool isFileInDb = isFileExist(nativePath);
+    if(status == ItemStatus::Monitored) // File is in sync with storage, remember how it looks now
+        stat = readFileStat(nativePath);
 
-    if(isFileInDb)
-    {
-        QString queryTemplate = "UPDATE File SET status = :1, event_timestamp = :2 WHERE file_path = :3;" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
+    QWriteLocker writeLocker(&indexLock);
 
-        query.bindValue(":1", status);
-        query.bindValue(":2", QDateTime::currentDateTime());
-        query.bindValue(":3", nativePath);
+    auto file = fileIndex.find(nativePath);
 
-        query.exec();
+    if(file == fileIndex.end())
+        return false;
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
-    }
+    file->status = status;
+    file->eventTimestamp = QDateTime::currentDateTime();
+    markFileChanged(nativePath);
+    file->hash.clear(); // Content may differ from now on, callers set it again when known
+    file->hashStat = FileStat();
 
-    return result;
+    if(status == ItemStatus::Monitored)
+        file->stat = stat;
+
+    return true;
 }
 
 bool FileSystemEventDb::setPathOfFolder(const QString &pathToFolder, const QString &newPath)
 {
-    bool result = false;
+    QString oldNativePath = toFolderKey(pathToFolder);
+    QString newNativePath = toFolderKey(newPath);
 
-    QString oldNativePath = QDir::toNativeSeparators(pathToFolder);
-    QString newNativePath = QDir::toNativeSeparators(newPath);
+    QWriteLocker writeLocker(&indexLock);
 
-    if(!oldNativePath.endsWith(QDir::separator()))
-        oldNativePath.append(QDir::separator());
+    if(!folderIndex.contains(oldNativePath))
+        return false;
+
+    if(oldNativePath == newNativePath)
+        return true;
+
+    if(folderIndex.contains(newNativePath))
+        return false;
+
+    FolderRow folder = folderIndex.take(oldNativePath);
 
-    if(!newNativePath.endsWith(QDir::separator()))
-        newNativePath.append(QDir::separator());
+    auto parent = folderIndex.find(folder.parentFolderPath);
+
+    if(parent != folderIndex.end())
+    {
+        parent->childFolders.remove(oldNativePath);
+        parent->childFolders.insert(newNativePath);
+    }
 
-    bool isFolderInDb = isFolderExist(oldNativePath);
+    markFolderChanged(oldNativePath);
+    markFolderChanged(newNativePath);
 
-    if(isFolderInDb)
+    // Same as before with foreign keys, direct children follow the new path but keep their own paths.
+    for(const QString &childFolderPath : std::as_const(folder.childFolders))
     {
-        QString queryTemplate = "UPDATE Folder SET folder_path = :1 WHERE folder_path = :2;" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
+        folderIndex[childFolderPath].parentFolderPath = newNativePath;
+        markFolderChanged(childFolderPath);
+    }
 
-        query.bindValue(":1", newNativePath);
-        query.bindValue(":2", oldNativePath);
+    QSet<QString> childFiles;
+
+    for(const QString &childFilePath : std::as_const(folder.childFiles))
+    {
+        FileRow file = fileIndex.take(childFilePath);
+        file.folderPath = newNativePath;
 
-        query.exec();
+        QString newFilePath = file.folderPath + file.fileName;
+        fileIndex.insert(newFilePath, file);
+        childFiles.insert(newFilePath);
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
+        markFileChanged(childFilePath);
+        markFileChanged(newFilePath);
     }
 
-    return result;
+    folder.childFiles = childFiles;
+    folderIndex.insert(newNativePath, folder);
+
+    return true;
 }
 
 bool FileSystemEventDb::setNameOfFile(const QString &pathToFile, const QString &newName)
 {
-    bool result = false;
-
     QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    bool isFileInDb = isFileExist(nativePath);
+    QWriteLocker writeLocker(&indexLock);
 
-    if(isFileInDb)
-    {
-        QString queryTemplate = "UPDATE File SET file_name = :1 WHERE file_path = :2;" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
+    auto file = fileIndex.constFind(nativePath);
 
-        query.bindValue(":1", newName);
-        query.bindValue(":2", nativePath);
+    if(file == fileIndex.constEnd())
+        return false;
 
-        query.exec();
+    QString newFilePath = file->folderPath + newName;
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
-    }
+    if(newFilePath == nativePath)
+        return true;
 
-    return result;
+    if(fileIndex.contains(newFilePath))
+        return false;
+
+    FileRow row = fileIndex.take(nativePath);
+    row.fileName = newName;
+    fileIndex.insert(newFilePath, row);
+    markFileChanged(nativePath);
+    markFileChanged(newFilePath);
+
+    QSet<QString> &childFiles = folderIndex[row.folderPath].childFiles;
+    childFiles.remove(nativePath);
+    childFiles.insert(newFilePath);
+
+    return true;
 }
 
 bool FileSystemEventDb::setOldNameOfFolder(const QString &pathToFolder, const QString &oldName)
 {
-    bool result = false;
+    QString nativePath = toFolderKey(pathToFolder);
 
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QWriteLocker writeLocker(&indexLock);
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    auto folder = folderIndex.find(nativePath);
 
-    bool isFolderInDb = isFolderExist(nativePath);
+    if(folder == folderIndex.end())
+        return false;
 
-    if(isFolderInDb)
-    {
-        QString queryTemplate = "UPDATE Folder SET old_folder_name = :1 WHERE folder_path = :2;" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
+    folder->oldFolderName = oldName;
 
-        if(oldName.isEmpty())
-            query.bindValue(":1", QVariant()); // Bind null value
-        else
-            query.bindValue(":1", oldName);
+    return true;
+}
 
-        query.bindValue(":2", nativePath);
+bool FileSystemEventDb::setOldNameOfFile(const QString &pathToFile, const QString &oldName)
+{
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-        query.exec();
+    QWriteLocker writeLocker(&indexLock);
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
-    }
+    auto file = fileIndex.find(nativePath);
 
-    return result;
+    if(file == fileIndex.end())
+        return false;
+
+    file->oldFileName = oldName;
+
+    if(oldName.isEmpty())
+        file->oldFolderPath.clear();
+
+    return true;
 }
 
-bool FileSystemEventDb::setOldNameOfFile(const QString &pathToFile, const QString &oldName)
+bool FileSystemEventDb::setOldPathOfFile(const QString &pathToFile, const QString &oldPath)
 {
-    bool result = false;
-
     QString nativePath = QDir::toNativeSeparators(pathToFile);
+    QString oldFolderPath;
+    QString oldFileName;
 
-    bool isFileInDb = isFileExist(nativePath);
-
-    if(isFileInDb)
+    if(!oldPath.isEmpty())
     {
-        QString queryTemplate = "UPDATE File SET old_file_name = :1 WHERE file_path = :2;" ;
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
+        QFileInfo info(oldPath);
+        oldFolderPath = QDir::toNativeSeparators(info.absolutePath());
+        oldFileName = info.fileName();
 
-        if(oldName.isEmpty())
-            query.bindValue(":1", QVariant()); // Bind null value
-        else
-            query.bindValue(":1", oldName);
+        if(!oldFolderPath.endsWith(QDir::separator()))
+            oldFolderPath.append(QDir::separator());
+    }
 
-        query.bindValue(":2", nativePath);
+    QWriteLocker writeLocker(&indexLock);
 
-        query.exec();
+    auto file = fileIndex.find(nativePath);
 
-        if(query.lastError().type() == QSqlError::ErrorType::NoError)
-            result = true;
-    }
+    if(file == fileIndex.end())
+        return false;
 
-    return result;
+    file->oldFileName = oldFileName;
+
+    if(oldFolderPath == file->folderPath) // Renamed in place
+        file->oldFolderPath.clear();
+    else
+        file->oldFolderPath = oldFolderPath;
+
+    return true;
 }
 
 bool FileSystemEventDb::setEfswIDofFolder(const QString &pathToFolder, long id)
 {
-    bool result = false;
-
-    bool isFolderInDb = isFolderExist(pathToFolder);
-
-    if(!isFolderInDb)
-        return false;
-
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QString nativePath = toFolderKey(pathToFolder);
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QWriteLocker writeLocker(&indexLock);
 
-    QString queryTemplate = "UPDATE Folder SET efsw_id = :1 WHERE folder_path = :2;" ;
+    auto folder = folderIndex.find(nativePath);
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
+    if(folder == folderIndex.end())
+        return false;
 
     if(id > 0)
-        query.bindValue(":1", (qlonglong) id);
+        folder->efswID = id;
     else
-        query.bindValue(":1", QVariant()); // set efsw_id as NULL
+        folder->efswID = 0;
 
-    query.bindValue(":2", nativePath);
+    // Decides which folders are shown as roots
+    markFolderChanged(nativePath);
 
-    query.exec();
-
-    if(query.lastError().type() == QSqlError::ErrorType::NoError)
-        result = true;
+    for(const QString &childFolderPath : std::as_const(folder->childFolders))
+        markFolderChanged(childFolderPath);
 
-    return result;
+    return true;
 }
 
 efsw::WatchID FileSystemEventDb::getEfswIDofFolder(const QString &pathToFolder) const
 {
     efsw::WatchID result = -1;
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QString nativePath = toFolderKey(pathToFolder);
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QReadLocker readLocker(&indexLock);
 
-    bool isFolderInDb = isFolderExist(nativePath);
+    auto folder = folderIndex.constFind(nativePath);
 
-    if(isFolderInDb)
-    {
-        QSqlRecord record = getFolderRow(nativePath);
-        result = record.value("efsw_id").value<efsw::WatchID>();
-    }
+    if(folder != folderIndex.constEnd())
+        result = folder->efswID;
 
     return result;
 }
@@ -434,29 +434,12 @@ QList<efsw::WatchID> FileSystemEventDb::getEfswIDListOfFolderTree(const QString
 {
     QList<efsw::WatchID> result;
 
-    QString nativePath = QDir::toNativeSeparators(pathToRootFolder);
-
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
-
-    bool isFolderInDb = isFolderExist(nativePath);
-
-    if(isFolderInDb)
-    {
-        QString queryTemplate = "SELECT efsw_id FROM Folder WHERE folder_path LIKE :1;" ;
+    QString nativePath = toFolderKey(pathToRootFolder);
 
-        QSqlQuery query(database);
-        query.prepare(queryTemplate);
-        query.bindValue(":1", QString("%1%").arg(nativePath));
-        query.exec();
+    QReadLocker readLocker(&indexLock);
 
-        while(query.next())
-        {
-            QSqlRecord record = query.record();
-            efsw::WatchID value = record.value("efsw_id").value<efsw::WatchID>();
-            result.append(value);
-        }
-    }
+    if(folderIndex.contains(nativePath))
+        collectEfswIDs(nativePath, result);
 
     return result;
 }
@@ -464,18 +447,14 @@ QList<efsw::WatchID> FileSystemEventDb::getEfswIDListOfFolderTree(const QString
 FileSystemEventDb::ItemStatus FileSystemEventDb::getStatusOfFolder(const QString &pathToFolder) const
 {
     FileSystemEventDb::ItemStatus result = FileSystemEventDb::ItemStatus::Invalid;
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QString nativePath = toFolderKey(pathToFolder);
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QReadLocker readLocker(&indexLock);
 
-    bool isFolderInDb = isFolderExist(nativePath);
+    auto folder = folderIndex.constFind(nativePath);
 
-    if(isFolderInDb)
-    {
-        QSqlRecord row = getFolderRow(nativePath);
-        result = row.value("status").value<FileSystemEventDb::ItemStatus>();
-    }
+    if(folder != folderIndex.constEnd())
+        result = folder->status;
 
     return result;
 }
@@ -485,240 +464,397 @@ FileSystemEventDb::ItemStatus FileSystemEventDb::getStatusOfFile(const QString &
     FileSystemEventDb::ItemStatus result = FileSystemEventDb::ItemStatus::Invalid;
     QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    bool isFileInDb = isFileExist(nativePath);
+    QReadLocker readLocker(&indexLock);
 
-    if(isFileInDb)
-    {
-        QSqlRecord row = getFileRow(nativePath);
-        result = row.value("status").value<FileSystemEventDb::ItemStatus>();
-    }
+    auto file = fileIndex.constFind(nativePath);
+
+    if(file != fileIndex.constEnd())
+        result = file->status;
 
     return result;
 }
 
-QString FileSystemEventDb::getNameOfFile(const QString &pathToFile) const
+QString FileSystemEventDb::getParentOfFolder(const QString &pathToFolder) const
 {
     QString result = "";
+    QString nativePath = toFolderKey(pathToFolder);
 
-    QString nativePath = QDir::toNativeSeparators(pathToFile);
+    QReadLocker readLocker(&indexLock);
 
-    bool isFileInDb = isFileExist(nativePath);
+    auto folder = folderIndex.constFind(nativePath);
 
-    if(isFileInDb)
-    {
-        QSqlRecord row = getFileRow(nativePath);
-        result = row.value("file_name").toString();
-    }
+    if(folder != folderIndex.constEnd())
+        result = folder->parentFolderPath;
 
     return result;
 }
 
-QString FileSystemEventDb::getOldNameOfFolder(const QString &pathToFolder) const
+QString FileSystemEventDb::getParentOfFile(const QString &pathToFile) const
 {
     QString result = "";
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QReadLocker readLocker(&indexLock);
 
-    bool isFolderInDb = isFolderExist(nativePath);
+    auto file = fileIndex.constFind(nativePath);
 
-    if(isFolderInDb)
-    {
-        QSqlRecord row = getFolderRow(nativePath);
-        result = row.value("old_folder_name").toString();
-    }
+    if(file != fileIndex.constEnd())
+        result = file->folderPath;
 
     return result;
 }
 
-QString FileSystemEventDb::getOldNameOfFile(const QString &pathToFile) const
+QString FileSystemEventDb::getNameOfFile(const QString &pathToFile) const
 {
     QString result = "";
 
     QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    bool isFileInDb = isFileExist(nativePath);
+    QReadLocker readLocker(&indexLock);
 
-    if(isFileInDb)
-    {
-        QSqlRecord row = getFileRow(nativePath);
-        result = row.value("old_file_name").toString();
-    }
+    auto file = fileIndex.constFind(nativePath);
+
+    if(file != fileIndex.constEnd())
+        result = file->fileName;
 
     return result;
 }
 
-QStringList FileSystemEventDb::getMonitoredFolderPathList() const
+QString FileSystemEventDb::getOldNameOfFolder(const QString &pathToFolder) const
 {
-    QStringList result;
+    QString result = "";
+    QString nativePath = toFolderKey(pathToFolder);
 
-    QString queryTemplate = "SELECT * FROM Folder WHERE efsw_id IS NOT NULL;" ;
+    QReadLocker readLocker(&indexLock);
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.exec();
+    auto folder = folderIndex.constFind(nativePath);
 
-    while(query.next())
-    {
-        QSqlRecord record = query.record();
-        QString item = record.value("folder_path").toString();
-        result.append(item);
-    }
+    if(folder != folderIndex.constEnd())
+        result = folder->oldFolderName;
 
     return result;
 }
 
-QStringList FileSystemEventDb::getActiveRootFolderList() const
+QString FileSystemEventDb::getOldNameOfFile(const QString &pathToFile) const
 {
-    QStringList result;
-    QString columnName = "result_column";
+    QString result = "";
 
-    QString queryTemplate = " SELECT f1.folder_path AS %1"
-                            " FROM Folder f1 "
-                            " WHERE f1.parent_folder_path IN ("
-                            "                                   SELECT f2.folder_path "
-                            "                                   FROM Folder f2 "
-                            "                                   WHERE f2.efsw_id IS NULL"
-                            "                                 )"
-                            " AND f1.efsw_id IS NOT NULL;" ;
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    queryTemplate = queryTemplate.arg(columnName);
+    QReadLocker readLocker(&indexLock);
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.exec();
+    auto file = fileIndex.constFind(nativePath);
 
-    while(query.next())
-    {
-        QSqlRecord record = query.record();
-        QString item = record.value(columnName).toString();
-        result.append(item);
-    }
+    if(file != fileIndex.constEnd())
+        result = file->oldFileName;
 
     return result;
 }
 
-QStringList FileSystemEventDb::getDirectChildFolderListOfFolder(const QString pathToFolder) const
+QString FileSystemEventDb::getOldPathOfFile(const QString &pathToFile) const
 {
-    QStringList result;
-
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QString result = "";
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    QString queryTemplate = " SELECT * FROM Folder WHERE parent_folder_path = :1;" ;
+    QReadLocker readLocker(&indexLock);
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.bindValue(":1", nativePath);
-    query.exec();
+    auto file = fileIndex.constFind(nativePath);
 
-    while(query.next())
+    if(file != fileIndex.constEnd() && !file->oldFileName.isEmpty())
     {
-        QSqlRecord record = query.record();
-        QString item = record.value("folder_path").toString();
-        result.append(item);
+        if(file->oldFolderPath.isEmpty())
+            result = file->folderPath + file->oldFileName;
+        else
+            result = file->oldFolderPath + file->oldFileName;
     }
 
     return result;
 }
 
-QStringList FileSystemEventDb::getDirectChildFileListOfFolder(const QString &pathToFolder) const
+FileSystemEventDb::FileStat FileSystemEventDb::getStatOfFolder(const QString &pathToFolder) const
 {
-    QStringList result;
-
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
-
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QString nativePath = toFolderKey(pathToFolder);
 
-    QString queryTemplate = " SELECT * FROM File WHERE folder_path = :1;" ;
-
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.bindValue(":1", nativePath);
-    query.exec();
+    QReadLocker readLocker(&indexLock);
+    return folderIndex.value(nativePath).stat;
+}
 
-    while(query.next())
-    {
-        QSqlRecord record = query.record();
-        QString item = record.value("file_path").toString();
-        result.append(item);
-    }
+FileSystemEventDb::FileStat FileSystemEventDb::getStatOfFile(const QString &pathToFile) const
+{
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    return result;
+    QReadLocker readLocker(&indexLock);
+    return fileIndex.value(nativePath).stat;
 }
 
-QStringList FileSystemEventDb::getEventfulFileListOfFolder(const QString &pathToFolder) const
+bool FileSystemEventDb::setStatOfFolder(const QString &pathToFolder, const FileStat &stat)
 {
-    QStringList result;
-
-    QString nativePath = QDir::toNativeSeparators(pathToFolder);
+    QString nativePath = toFolderKey(pathToFolder);
 
-    if(!nativePath.endsWith(QDir::separator()))
-        nativePath.append(QDir::separator());
+    QWriteLocker writeLocker(&indexLock);
 
-    QString queryTemplate = " SELECT * FROM File WHERE folder_path = :1 AND status >= 1;" ;
+    auto folder = folderIndex.find(nativePath);
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.bindValue(":1", nativePath);
-    query.exec();
+    if(folder == folderIndex.end())
+        return false;
 
-    while(query.next())
-    {
-        QSqlRecord record = query.record();
-        QString item = record.value("file_path").toString();
-        result.append(item);
-    }
+    folder->stat = stat;
 
-    return result;
+    return true;
 }
 
-bool FileSystemEventDb::isContainAnyFolderEvent() const
+bool FileSystemEventDb::setStatOfFile(const QString &pathToFile, const FileStat &stat)
 {
-    bool result = false;
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    QString columnName = "result_column";
-    QString queryTemplate = "SELECT COUNT(*) AS %1 FROM Folder WHERE status != :1;" ;
-    queryTemplate = queryTemplate.arg(columnName);
+    QWriteLocker writeLocker(&indexLock);
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.bindValue(":1", ItemStatus::Monitored);
-    query.exec();
-    query.next();
+    auto file = fileIndex.find(nativePath);
 
-    int count = query.record().value(columnName).toInt();
-    if(count >= 1)
-        result = true;
+    if(file == fileIndex.end())
+        return false;
+
+    file->stat = stat;
+
+    return true;
+}
+
+QString FileSystemEventDb::getHashOfFile(const QString &pathToFile, FileStat *stat) const
+{
+    QString result = "";
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
+
+    QReadLocker readLocker(&indexLock);
+
+    auto file = fileIndex.constFind(nativePath);
+
+    if(file != fileIndex.constEnd())
+    {
+        result = file->hash;
+
+        if(stat != nullptr)
+            *stat = file->hashStat;
+    }
 
     return result;
 }
 
-bool FileSystemEventDb::isContainAnyFileEvent() const
+bool FileSystemEventDb::setHashOfFile(const QString &pathToFile, const QString &hash, const FileStat &stat)
 {
-    bool result = false;
+    QString nativePath = QDir::toNativeSeparators(pathToFile);
 
-    QString columnName = "result_column";
-    QString queryTemplate = "SELECT COUNT(*) AS %1 FROM File WHERE status != :1;" ;
-    queryTemplate = queryTemplate.arg(columnName);
+    QWriteLocker writeLocker(&indexLock);
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
-    query.bindValue(":1", ItemStatus::Monitored);
-    query.exec();
-    query.next();
+    auto file = fileIndex.find(nativePath);
 
-    int count = query.record().value(columnName).toInt();
-    if(count >= 1)
-        result = true;
+    if(file == fileIndex.end())
+        return false;
+
+    file->hash = hash;
+    file->hashStat = stat;
+
+    return true;
+}
+
+QStringList FileSystemEventDb::getFolderPathList() const
+{
+    QReadLocker readLocker(&indexLock);
+    return folderIndex.keys();
+}
+
+QStringList FileSystemEventDb::getFilePathList() const
+{
+    QReadLocker readLocker(&indexLock);
+    return fileIndex.keys();
+}
+
+QStringList FileSystemEventDb::getMonitoredFolderPathList() const
+{
+    QStringList result;
+
+    QReadLocker readLocker(&indexLock);
+
+    for(auto folder = folderIndex.constBegin(); folder != folderIndex.constEnd(); ++folder)
+    {
+        if(folder->efswID > 0)
+            result.append(folder.key());
+    }
+
+    return result;
+}
+
+QStringList FileSystemEventDb::getActiveRootFolderList() const
+{
+    QStringList result;
+
+    QReadLocker readLocker(&indexLock);
+
+    // Watched folders whose parent is not watched
+    for(auto folder = folderIndex.constBegin(); folder != folderIndex.constEnd(); ++folder)
+    {
+        if(folder->efswID <= 0)
+            continue;
+
+        auto parent = folderIndex.constFind(folder->parentFolderPath);
+
+        if(parent != folderIndex.constEnd() && parent->efswID <= 0)
+            result.append(folder.key());
+    }
+
+    return result;
+}
+
+QStringList FileSystemEventDb::getDirectChildFolderListOfFolder(const QString pathToFolder) const
+{
+    QStringList result;
+
+    QString nativePath = toFolderKey(pathToFolder);
+
+    QReadLocker readLocker(&indexLock);
+
+    auto folder = folderIndex.constFind(nativePath);
+
+    if(folder != folderIndex.constEnd())
+    {
+        result = folder->childFolders.values();
+        result.sort();
+    }
+
+    return result;
+}
+
+QStringList FileSystemEventDb::getDirectChildFileListOfFolder(const QString &pathToFolder) const
+{
+    QStringList result;
+
+    QString nativePath = toFolderKey(pathToFolder);
+
+    QReadLocker readLocker(&indexLock);
+
+    auto folder = folderIndex.constFind(nativePath);
+
+    if(folder != folderIndex.constEnd())
+    {
+        result = folder->childFiles.values();
+        result.sort();
+    }
 
     return result;
 }
 
+QStringList FileSystemEventDb::getEventfulFileListOfFolder(const QString &pathToFolder) const
+{
+    QStringList result;
+
+    QString nativePath = toFolderKey(pathToFolder);
+
+    QReadLocker readLocker(&indexLock);
+
+    auto folder = folderIndex.constFind(nativePath);
+
+    if(folder != folderIndex.constEnd())
+    {
+        for(const QString &childFilePath : folder->childFiles)
+        {
+            if(fileIndex.value(childFilePath).status >= ItemStatus::NewAdded)
+                result.append(childFilePath);
+        }
+
+        result.sort();
+    }
+
+    return result;
+}
+
+bool FileSystemEventDb::isActiveRootFolder(const QString &pathToFolder) const
+{
+    QString nativePath = toFolderKey(pathToFolder);
+
+    QReadLocker readLocker(&indexLock);
+
+    auto folder = folderIndex.constFind(nativePath);
+
+    if(folder == folderIndex.constEnd() || folder->efswID <= 0)
+        return false;
+
+    auto parent = folderIndex.constFind(folder->parentFolderPath);
+
+    return parent != folderIndex.constEnd() && parent->efswID <= 0;
+}
+
+QList<FileSystemEventDb::TreeEntry> FileSystemEventDb::getEventfulTree(const QString &rootFolderPath) const
+{
+    QList<TreeEntry> result;
+
+    QReadLocker readLocker(&indexLock);
+
+    if(!rootFolderPath.isEmpty())
+    {
+        QString nativePath = toFolderKey(rootFolderPath);
+
+        if(folderIndex.contains(nativePath))
+            appendTreeEntries(nativePath, "", result);
+
+        return result;
+    }
+
+    // Same roots as getActiveRootFolderList()
+    for(auto folder = folderIndex.constBegin(); folder != folderIndex.constEnd(); ++folder)
+    {
+        if(folder->efswID <= 0)
+            continue;
+
+        auto parent = folderIndex.constFind(folder->parentFolderPath);
+
+        if(parent != folderIndex.constEnd() && parent->efswID <= 0)
+            appendTreeEntries(folder.key(), "", result);
+    }
+
+    return result;
+}
+
+bool FileSystemEventDb::takeChangedPaths(QSet<QString> &folderPaths, QSet<QString> &filePaths)
+{
+    QWriteLocker writeLocker(&indexLock);
+
+    bool result = !isChangeJournalOverflowed;
+
+    folderPaths.swap(changedFolderPaths);
+    filePaths.swap(changedFilePaths);
+    changedFolderPaths.clear();
+    changedFilePaths.clear();
+    isChangeJournalOverflowed = false;
+
+    return result;
+}
+
+bool FileSystemEventDb::isContainAnyFolderEvent() const
+{
+    QReadLocker readLocker(&indexLock);
+
+    for(const FolderRow &folder : folderIndex)
+    {
+        if(folder.status != ItemStatus::Monitored)
+            return true;
+    }
+
+    return false;
+}
+
+bool FileSystemEventDb::isContainAnyFileEvent() const
+{
+    QReadLocker readLocker(&indexLock);
+
+    for(const FileRow &file : fileIndex)
+    {
+        if(file.status != ItemStatus::Monitored)
+            return true;
+    }
+
+    return false;
+}
+
 bool FileSystemEventDb::addMonitoringError(const QString &location, const QString &during, qlonglong error)
 {
     bool result = false;
@@ -726,8 +862,7 @@ bool FileSystemEventDb::addMonitoringError(const QString &location, const QStrin
     QString queryTemplate = "INSERT INTO MonitoringError (location, during, error_type, event_timestamp) "
                             "VALUES(:1, :2, :3, :4);" ;
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
 
     query.bindValue(":1", location);
     query.bindValue(":2", during);
@@ -743,30 +878,392 @@ bool FileSystemEventDb::addMonitoringError(const QString &location, const QStrin
 
 }
 
-QSqlRecord FileSystemEventDb::getFolderRow(const QString &pathToFolder) const
+bool FileSystemEventDb::exportSnapshot()
 {
-    QString queryTemplate = "SELECT * FROM Folder WHERE folder_path = :1;" ;
+    QReadLocker readLocker(&indexLock);
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
+    database.transaction();
+    database.exec("PRAGMA defer_foreign_keys = ON;"); // Parent rows aren't inserted in any particular order
+    database.exec("DELETE FROM File;");
+    database.exec("DELETE FROM Folder;");
 
-    query.bindValue(":1", pathToFolder);
-    query.exec();
-    query.next();
+    QString folderQueryTemplate = "INSERT INTO Folder(folder_path, parent_folder_path, old_folder_name, status, efsw_id, event_timestamp) "
+                                  "VALUES(:1, :2, :3, :4, :5, :6);" ;
+
+    for(auto folder = folderIndex.constBegin(); folder != folderIndex.constEnd(); ++folder)
+    {
+        QSqlQuery &query = queryCache.prepare(folderQueryTemplate);
+
+        query.bindValue(":1", folder.key());
+        query.bindValue(":2", folder->parentFolderPath.isEmpty() ? QVariant() : QVariant(folder->parentFolderPath));
+        query.bindValue(":3", folder->oldFolderName.isEmpty() ? QVariant() : QVariant(folder->oldFolderName));
+        query.bindValue(":4", folder->status);
+        query.bindValue(":5", folder->efswID > 0 ? QVariant((qlonglong) folder->efswID) : QVariant());
+        query.bindValue(":6", folder->eventTimestamp);
+
+        if(!query.exec())
+        {
+            database.rollback();
+            return false;
+        }
+    }
+
+    QString fileQueryTemplate = "INSERT INTO File(folder_path, file_name, old_file_name, status, event_timestamp) "
+                                "VALUES(:1, :2, :3, :4, :5);" ;
+
+    for(const FileRow &file : fileIndex)
+    {
+        QSqlQuery &query = queryCache.prepare(fileQueryTemplate);
+
+        query.bindValue(":1", file.folderPath);
+        query.bindValue(":2", file.fileName);
+        query.bindValue(":3", file.oldFileName.isEmpty() ? QVariant() : QVariant(file.oldFileName));
+        query.bindValue(":4", file.status);
+        query.bindValue(":5", file.eventTimestamp);
+
+        if(!query.exec())
+        {
+            database.rollback();
+            return false;
+        }
+    }
 
-    return query.record();
+    return database.commit();
 }
 
-QSqlRecord FileSystemEventDb::getFileRow(const QString &pathToFile) const
+bool FileSystemEventDb::saveSnapshot(const QString &filePath) const
 {
-    QString queryTemplate = "SELECT * FROM File WHERE file_path = :1;" ;
+    QSaveFile file(filePath); // Replaces the previous snapshot only once the new one is complete
 
-    QSqlQuery query(database);
-    query.prepare(queryTemplate);
+    if(!file.open(QIODevice::OpenModeFlag::WriteOnly))
+        return false;
 
-    query.bindValue(":1", pathToFile);
-    query.exec();
-    query.next();
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Version::Qt_6_0);
+
+    QReadLocker readLocker(&indexLock);
+
+    stream << snapshotMagic << snapshotVersion;
+    stream << (qint64) folderIndex.size();
+
+    for(auto folder = folderIndex.constBegin(); folder != folderIndex.constEnd(); ++folder)
+    {
+        // Stat of the last listing, entries changed after it make the folder listed again on restore
+        stream << folder.key() << (qint32) folder->status << folder->oldFolderName << (folder->efswID > 0);
+        stream << folder->stat.modifiedTime << (quint64) folder->stat.inode;
+    }
+
+    stream << (qint64) fileIndex.size();
+
+    for(auto item = fileIndex.constBegin(); item != fileIndex.constEnd(); ++item)
+    {
+        stream << item.key() << (qint32) item->status << item->oldFileName << item->oldFolderPath << item->hash;
+        stream << item->stat.isExist << item->stat.size << item->stat.modifiedTime << (quint64) item->stat.inode;
+        stream << item->hashStat.isExist << item->hashStat.size << item->hashStat.modifiedTime << (quint64) item->hashStat.inode;
+    }
+
+    readLocker.unlock();
+
+    if(stream.status() != QDataStream::Status::Ok)
+    {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+bool FileSystemEventDb::loadSnapshot(const QString &filePath, QStringList *watchedFolderList)
+{
+    QFile file(filePath);
+
+    if(!file.open(QIODevice::OpenModeFlag::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Version::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+
+    if(magic != snapshotMagic || version != snapshotVersion)
+        return false;
+
+    QHash<QString, FolderRow> loadedFolders;
+    QHash<QString, FileRow> loadedFiles;
+    QStringList watchedFolders;
+    QDateTime timestamp = QDateTime::currentDateTime();
+
+    qint64 folderCount = 0;
+    stream >> folderCount;
+
+    for(qint64 index = 0; index < folderCount && stream.status() == QDataStream::Status::Ok; ++index)
+    {
+        QString path;
+        qint32 status = 0;
+        bool isWatched = false;
+        FolderRow row;
+
+        stream >> path >> status >> row.oldFolderName >> isWatched;
+        stream >> row.stat.modifiedTime >> row.stat.inode;
+
+        row.status = (ItemStatus) status;
+        row.stat.isExist = true;
+        row.eventTimestamp = timestamp;
+        loadedFolders.insert(path, row);
+
+        if(isWatched)
+            watchedFolders.append(path);
+    }
+
+    qint64 fileCount = 0;
+    stream >> fileCount;
+
+    for(qint64 index = 0; index < fileCount && stream.status() == QDataStream::Status::Ok; ++index)
+    {
+        QString path;
+        qint32 status = 0;
+        FileRow row;
+
+        stream >> path >> status >> row.oldFileName >> row.oldFolderPath >> row.hash;
+        stream >> row.stat.isExist >> row.stat.size >> row.stat.modifiedTime >> row.stat.inode;
+        stream >> row.hashStat.isExist >> row.hashStat.size >> row.hashStat.modifiedTime >> row.hashStat.inode;
+
+        row.status = (ItemStatus) status;
+        row.eventTimestamp = timestamp;
+        loadedFiles.insert(path, row);
+    }
+
+    if(stream.status() != QDataStream::Status::Ok) // Truncated or corrupt, caller falls back to discovery
+        return false;
+
+    QWriteLocker writeLocker(&indexLock);
+
+    folderIndex.clear();
+    fileIndex.clear();
+
+    // Whole index is replaced, views must rebuild
+    isChangeJournalOverflowed = true;
+    changedFolderPaths.clear();
+    changedFilePaths.clear();
+
+    // Rebuild tree links through the regular insert path, then restore the saved fields
+    for(auto folder = loadedFolders.constBegin(); folder != loadedFolders.constEnd(); ++folder)
+    {
+        insertFolder(folder.key());
+
+        FolderRow &row = folderIndex[folder.key()];
+        row.oldFolderName = folder->oldFolderName;
+        row.status = folder->status;
+        row.stat = folder->stat;
+        row.eventTimestamp = folder->eventTimestamp;
+    }
+
+    for(auto item = loadedFiles.constBegin(); item != loadedFiles.constEnd(); ++item)
+    {
+        insertFile(item.key());
+
+        auto row = fileIndex.find(item.key());
+
+        if(row != fileIndex.end())
+        {
+            row->oldFileName = item->oldFileName;
+            row->oldFolderPath = item->oldFolderPath;
+            row->status = item->status;
+            row->stat = item->stat;
+            row->hash = item->hash;
+            row->hashStat = item->hashStat;
+            row->eventTimestamp = item->eventTimestamp;
+        }
+    }
+
+    if(watchedFolderList != nullptr)
+        *watchedFolderList = watchedFolders;
+
+    return true;
+}
+
+QString FileSystemEventDb::toFolderKey(const QString &pathToFolder)
+{
+    QString result = QDir::toNativeSeparators(pathToFolder);
+
+    if(!result.endsWith(QDir::separator()))
+        result.append(QDir::separator());
+
+    return result;
+}
+
+void FileSystemEventDb::markFolderChanged(const QString &nativeFolderPath)
+{
+    if(isChangeJournalOverflowed)
+        return;
+
+    changedFolderPaths.insert(nativeFolderPath);
+
+    if(changedFolderPaths.size() + changedFilePaths.size() > changeJournalLimit)
+    {
+        isChangeJournalOverflowed = true;
+        changedFolderPaths.clear();
+        changedFilePaths.clear();
+    }
+}
+
+void FileSystemEventDb::markFileChanged(const QString &nativeFilePath)
+{
+    if(isChangeJournalOverflowed)
+        return;
+
+    changedFilePaths.insert(nativeFilePath);
+
+    if(changedFolderPaths.size() + changedFilePaths.size() > changeJournalLimit)
+    {
+        isChangeJournalOverflowed = true;
+        changedFolderPaths.clear();
+        changedFilePaths.clear();
+    }
+}
+
+void FileSystemEventDb::appendTreeEntries(const QString &nativeFolderPath, const QString &parentPath, QList<TreeEntry> &result)
+{
+    // Called under a read lock, so lookups must not insert
+    auto folder = folderIndex.constFind(nativeFolderPath);
+
+    if(folder == folderIndex.constEnd())
+        return;
+
+    TreeEntry folderEntry;
+    folderEntry.isFolder = true;
+    folderEntry.path = nativeFolderPath;
+    folderEntry.parentPath = parentPath;
+    folderEntry.status = folder->status;
+    result.append(folderEntry);
+
+    QStringList childFilePaths = folder->childFiles.values();
+    childFilePaths.sort();
+
+    for(const QString &childFilePath : childFilePaths)
+    {
+        auto file = fileIndex.constFind(childFilePath);
+
+        if(file == fileIndex.constEnd() || file->status < ItemStatus::NewAdded)
+            continue;
+
+        TreeEntry fileEntry;
+        fileEntry.path = childFilePath;
+        fileEntry.parentPath = nativeFolderPath;
+        fileEntry.status = file->status;
+        result.append(fileEntry);
+    }
+
+    QStringList childFolderPaths = folder->childFolders.values();
+    childFolderPaths.sort();
+
+    for(const QString &childFolderPath : childFolderPaths)
+        appendTreeEntries(childFolderPath, nativeFolderPath, result);
+}
+
+bool FileSystemEventDb::insertFolder(const QString &nativeFolderPath)
+{
+    QString nativePath = nativeFolderPath;
+
+    if(nativePath.endsWith(QDir::separator()))
+        nativePath.chop(1);
+
+    QStringList folderNames = nativePath.split(QDir::separator());
+    QString parentFolderPath = "";
+
+    for(const QString &folder : folderNames)
+    {
+        // Start constructing from root path
+        QString currentSubFolderPath = folder + QDir::separator();
+        QString currentFolderPath = parentFolderPath + currentSubFolderPath;
+
+        bool isInsertingRootPath = currentFolderPath == QDir::toNativeSeparators(QDir::rootPath());
+
+        if(!folderIndex.contains(currentFolderPath))
+        {
+            FolderRow row;
+            row.eventTimestamp = QDateTime::currentDateTime();
+
+            if(!isInsertingRootPath)
+            {
+                row.parentFolderPath = parentFolderPath;
+                folderIndex[parentFolderPath].childFolders.insert(currentFolderPath);
+            }
+
+            folderIndex.insert(currentFolderPath, row);
+            markFolderChanged(currentFolderPath);
+        }
+
+        // Set last inserted path as root path
+        parentFolderPath += currentSubFolderPath;
+    }
+
+    return true;
+}
+
+bool FileSystemEventDb::insertFile(const QString &nativeFilePath)
+{
+    if(fileIndex.contains(nativeFilePath))
+        return true;
+
+    QFileInfo info(nativeFilePath);
+    QString nativeFolderPath = QDir::toNativeSeparators(info.absolutePath());
+
+    if(!nativeFolderPath.endsWith(QDir::separator()))
+        nativeFolderPath.append(QDir::separator());
+
+    bool isFolderAdded = insertFolder(nativeFolderPath);
+
+    if(!isFolderAdded)
+        return false;
+
+    FileRow row;
+    row.folderPath = nativeFolderPath;
+    row.fileName = info.fileName();
+    row.eventTimestamp = QDateTime::currentDateTime();
+
+    QString filePath = row.folderPath + row.fileName;
+    fileIndex.insert(filePath, row);
+    markFileChanged(filePath);
+    folderIndex[nativeFolderPath].childFiles.insert(filePath);
+
+    return true;
+}
+
+void FileSystemEventDb::removeFolder(const QString &nativeFolderPath)
+{
+    FolderRow folder = folderIndex.take(nativeFolderPath);
+    markFolderChanged(nativeFolderPath); // Children go with it
+
+    for(const QString &childFolderPath : std::as_const(folder.childFolders))
+        removeFolder(childFolderPath);
+
+    for(const QString &childFilePath : std::as_const(folder.childFiles))
+        fileIndex.remove(childFilePath);
+}
+
+void FileSystemEventDb::removeFile(const QString &nativeFilePath)
+{
+    FileRow file = fileIndex.take(nativeFilePath);
+    markFileChanged(nativeFilePath);
+
+    auto folder = folderIndex.find(file.folderPath);
+
+    if(folder != folderIndex.end())
+        folder->childFiles.remove(nativeFilePath);
+}
+
+void FileSystemEventDb::collectEfswIDs(const QString &nativeFolderPath, QList<efsw::WatchID> &result)
+{
+    auto folder = folderIndex.constFind(nativeFolderPath);
+
+    if(folder == folderIndex.constEnd())
+        return;
+
+    result.append(folder->efswID);
 
-    return query.record();
+    for(const QString &childFolderPath : folder->childFolders)
+        collectEfswIDs(childFolderPath, result);
 }
@@ -2,7 +2,13 @@
 #define FILESYSTEMEVENTDB_H
 
 #include "efsw/efsw.hpp"
+#include "Utility/QueryCache.h"
+
+#include <QSet>
+#include <QHash>
+#include <QDateTime>
 #include <QSqlDatabase>
+#include <QReadWriteLock>
 
 class FileSystemEventDb
 {
@@ -18,6 +24,26 @@ public:
         Missing = 5
     };
 
+    // What a single stat call tells about a path, enough to notice changes without reading content
+    struct FileStat
+    {
+        bool isExist = false;
+        qint64 size = -1;
+        qint64 modifiedTime = -1; // Milliseconds since epoch
+        quint64 inode = 0; // 0 where the platform doesn't provide one
+    };
+
+    static FileStat readFileStat(const QString &path);
+
+    // One row of a monitored tree, enough to build a view without further lookups
+    struct TreeEntry
+    {
+        bool isFolder = false;
+        QString path;
+        QString parentPath; // Empty for the root of the listing
+        ItemStatus status = ItemStatus::Invalid;
+    };
+
     FileSystemEventDb(const QSqlDatabase &eventDb);
     ~FileSystemEventDb();
 
@@ -25,6 +51,8 @@ public:
     bool isFileExist(const QString &pathToFile) const;
     bool addFolder(const QString &pathToFolder);
     bool addFile(const QString &pathToFile);
+    bool addFolderBatch(const QHash<QString, efsw::WatchID> &folderWatchIDs, ItemStatus status); // Single lock for all items
+    bool addFileBatch(const QStringList &filePaths, ItemStatus status);
     bool deleteFolder(const QString &pathToFolder);
     bool deleteFile(const QString &pathToFile);
     bool setStatusOfFolder(const QString &pathToFolder, ItemStatus status);
@@ -33,16 +61,29 @@ public:
     bool setNameOfFile(const QString &pathToFile, const QString &newName);
     bool setOldNameOfFolder(const QString &pathToFolder, const QString &oldName);
     bool setOldNameOfFile(const QString &pathToFile, const QString &oldName);
+    bool setOldPathOfFile(const QString &pathToFile, const QString &oldPath); // Also covers moves from another folder
     bool setEfswIDofFolder(const QString &pathToFolder, long id);
     efsw::WatchID getEfswIDofFolder(const QString &pathToFolder) const;
     QList<efsw::WatchID> getEfswIDListOfFolderTree(const QString &pathToRootFolder) const;
     ItemStatus getStatusOfFolder(const QString &pathToFolder) const;
     ItemStatus getStatusOfFile(const QString &pathToFile) const;
+    QString getParentOfFolder(const QString &pathToFolder) const; // Empty for the root or when folder isn't indexed
+    QString getParentOfFile(const QString &pathToFile) const;
     QString getNameOfFile(const QString &pathToFile) const;
     QString getOldNameOfFolder(const QString &pathToFolder) const;
     QString getOldNameOfFile(const QString &pathToFile) const;
+    QString getOldPathOfFile(const QString &pathToFile) const; // Empty when file wasn't renamed or moved
+    FileStat getStatOfFolder(const QString &pathToFolder) const; // As of the last time the folder was listed
+    bool setStatOfFolder(const QString &pathToFolder, const FileStat &stat);
+    FileStat getStatOfFile(const QString &pathToFile) const; // As of the last time the file was in sync with storage
+    bool setStatOfFile(const QString &pathToFile, const FileStat &stat);
+    QString getHashOfFile(const QString &pathToFile, FileStat *stat = nullptr) const; // Stat is the one the hash was taken at
+    bool setHashOfFile(const QString &pathToFile, const QString &hash, const FileStat &stat);
+    QStringList getFolderPathList() const;
+    QStringList getFilePathList() const;
     QStringList getMonitoredFolderPathList() const;
     QStringList getActiveRootFolderList() const;
+    bool isActiveRootFolder(const QString &pathToFolder) const;
     QStringList getDirectChildFolderListOfFolder(const QString pathToFolder) const;
     QStringList getDirectChildFileListOfFolder(const QString &pathToFolder) const;
     QStringList getEventfulFileListOfFolder(const QString &pathToFolder) const;
@@ -50,12 +91,71 @@ public:
     bool isContainAnyFileEvent() const;
     bool addMonitoringError(const QString &location, const QString &during, qlonglong error);
 
+    // Every folder and eventful file below the root in a single pass, parents come before their children.
+    // Siblings are ordered files first then folders, both sorted. Empty root lists all active roots.
+    QList<TreeEntry> getEventfulTree(const QString &rootFolderPath = "") const;
+
+    // Paths added, removed or changed since the last call, so views can update only those.
+    // Returns false when changes piled up past the journal limit, caller should rebuild from scratch instead.
+    bool takeChangedPaths(QSet<QString> &folderPaths, QSet<QString> &filePaths);
+
+    // Copies current monitor state into Folder and File tables, so they can be browsed with sql.
+    bool exportSnapshot();
+
+    // Persists the index between runs. Watch IDs are only valid for a run, loading reports which folders were watched instead.
+    bool saveSnapshot(const QString &filePath) const;
+    bool loadSnapshot(const QString &filePath, QStringList *watchedFolderList = nullptr);
+
 private:
+    struct FolderRow
+    {
+        QString parentFolderPath; // Empty for root path
+        QString oldFolderName;
+        ItemStatus status = ItemStatus::Monitored;
+        efsw::WatchID efswID = 0; // 0 when folder is not watched
+        QDateTime eventTimestamp;
+        FileStat stat;
+        QSet<QString> childFolders;
+        QSet<QString> childFiles;
+    };
+
+    struct FileRow
+    {
+        QString folderPath;
+        QString fileName;
+        QString oldFileName;
+        QString oldFolderPath; // Empty unless file was moved from another folder
+        ItemStatus status = ItemStatus::Monitored;
+        QDateTime eventTimestamp;
+        FileStat stat;
+        QString hash; // Last known content hash, empty when not known
+        FileStat hashStat; // Hash is valid while the file still has this stat
+    };
+
+    static const inline qsizetype changeJournalLimit = 10000;
+    static const inline quint32 snapshotMagic = 0x4E534D53; // "NSMS"
+    static const inline quint32 snapshotVersion = 3;
+
     QSqlDatabase database;
+    mutable QueryCache queryCache;
+
+    // Monitor state is kept in memory and shared by every instance, lookups never reach sqlite.
+    static QReadWriteLock indexLock;
+    static QHash<QString, FolderRow> folderIndex;
+    static QHash<QString, FileRow> fileIndex;
+    static QSet<QString> changedFolderPaths; // Guarded by indexLock too
+    static QSet<QString> changedFilePaths;
+    static bool isChangeJournalOverflowed;
 
-    QSqlRecord getFolderRow(const QString &pathToFolder) const;
-    QSqlRecord getFileRow(const QString &pathToFile) const;
-    void createDb();
+    static QString toFolderKey(const QString &pathToFolder);
+    static void markFolderChanged(const QString &nativeFolderPath);
+    static void markFileChanged(const QString &nativeFilePath);
+    static bool insertFolder(const QString &nativeFolderPath);
+    static bool insertFile(const QString &nativeFilePath);
+    static void removeFolder(const QString &nativeFolderPath);
+    static void removeFile(const QString &nativeFilePath);
+    static void collectEfswIDs(const QString &nativeFolderPath, QList<efsw::WatchID> &result);
+    static void appendTreeEntries(const QString &nativeFolderPath, const QString &parentPath, QList<TreeEntry> &result);
 };
 
 #endif // FILESYSTEMEVENTDB_H
@@ -1,46 +1,59 @@
 #include "FileSystemEventListener.h"
 
-#include <iostream>
-
 FileSystemEventListener::FileSystemEventListener(QObject *parent)
-    : QObject{parent}
+    : QObject{parent}, eventQueue(defaultQueueCapacity)
+{
+    isNotificationPending.store(false);
+    droppedEventCount.store(0);
+    totalDroppedEventCount.store(0);
+}
+
+bool FileSystemEventListener::takeRecord(Record &record)
 {
+    return eventQueue.tryPop(record);
+}
 
+void FileSystemEventListener::acknowledgeEventsAvailable()
+{
+    // Cleared before draining, so an event pushed during the drain always causes a new notification
+    isNotificationPending.store(false, std::memory_order_release);
 }
 
+quint64 FileSystemEventListener::takeDroppedEventCount()
+{
+    return droppedEventCount.exchange(0, std::memory_order_relaxed);
+}
+
+quint64 FileSystemEventListener::getTotalDroppedEventCount() const
+{
+    return totalDroppedEventCount.load(std::memory_order_relaxed);
+}
+
+// Runs on the efsw watcher thread. Kept allocation light and lock free so the kernel queue is drained quickly.
 void FileSystemEventListener::handleFileAction(efsw::WatchID watchid,
                                                const std::string &dir,
                                                const std::string &filename,
                                                efsw::Action action,
                                                std::string oldFilename)
 {
-    auto _dir = QString::fromStdString(dir);
-    auto _fileName = QString::fromStdString(filename);
-    auto _oldFileName = QString::fromStdString(oldFilename);
+    if(signalsBlocked()) // Monitoring is paused
+        return;
 
-    switch( action )
+    Record record;
+    record.watchId = watchid;
+    record.action = action;
+    record.dir = dir;
+    record.fileName = filename;
+    record.oldFileName = std::move(oldFilename);
+
+    bool isQueued = eventQueue.tryPush(std::move(record));
+
+    if(!isQueued)
     {
-    case efsw::Actions::Add:
-        std::cout << "DIR (" << dir << ") FILE (" << filename << ") has event Added" << std::endl;
-        emit signalAddEventDetected(_fileName, _dir);
-        break;
-
-    case efsw::Actions::Delete:
-        std::cout << "DIR (" << dir << ") FILE (" << filename << ") has event Delete" << std::endl;
-        emit signalDeleteEventDetected(_fileName, _dir);
-        break;
-
-    case efsw::Actions::Modified:
-        std::cout << "DIR (" << dir << ") FILE (" << filename << ") has event Modified" << std::endl;
-        emit signalModificationEventDetected(_fileName, _dir);
-        break;
-
-    case efsw::Actions::Moved:
-        std::cout << "DIR (" << dir << ") FILE (" << filename << ") has event Moved from (" << oldFilename << ")" << std::endl;
-        emit signalMoveEventDetected(_fileName, _oldFileName, _dir);
-        break;
-
-    default:
-        std::cout << "Should never happen!" << std::endl;
+        droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+        totalDroppedEventCount.fetch_add(1, std::memory_order_relaxed);
     }
+
+    if(!isNotificationPending.exchange(true, std::memory_order_acq_rel))
+        emit signalEventsAvailable();
 }
@@ -1,20 +1,42 @@
 #ifndef FILESYSTEMEVENTLISTENER
 #define FILESYSTEMEVENTLISTENER
 
+#include "Utility/MpscRingBuffer.h"
+
 #include <QObject>
 #include <efsw/efsw.hpp>
 
+#include <string>
+#include <atomic>
+
 class FileSystemEventListener : public QObject, public efsw::FileWatchListener
 {
     Q_OBJECT
 public:
+    // Raw event as reported by efsw, converted to Qt types only on the monitor thread
+    struct Record
+    {
+        efsw::WatchID watchId = 0;
+        efsw::Action action = efsw::Actions::Add;
+        std::string dir;
+        std::string fileName;
+        std::string oldFileName;
+    };
+
+    static const inline std::size_t defaultQueueCapacity = 65536;
+
     explicit FileSystemEventListener(QObject *parent = nullptr);
 
+    // Consumer side, must only be called from the thread that handles signalEventsAvailable()
+    bool takeRecord(Record &record);
+    void acknowledgeEventsAvailable();
+
+    quint64 takeDroppedEventCount(); // Events lost because queue was full since the last call
+    quint64 getTotalDroppedEventCount() const;
+
 signals:
-    void signalAddEventDetected(const QString &fileName, const QString &dir);
-    void signalDeleteEventDetected(const QString &fileName, const QString &dir);
-    void signalModificationEventDetected(const QString &fileName, const QString &dir);
-    void signalMoveEventDetected(const QString &newFileName, const QString &oldFileName, const QString &dir);
+    // Emitted once until acknowledged, no matter how many events are queued meanwhile
+    void signalEventsAvailable();
 
     // FileWatchListener interface
 public:
@@ -23,6 +45,12 @@ public:
                           const std::string &filename,
                           efsw::Action action,
                           std::string oldFilename) override;
+
+private:
+    MpscRingBuffer<Record> eventQueue;
+    std::atomic<bool> isNotificationPending;
+    std::atomic<quint64> droppedEventCount;
+    std::atomic<quint64> totalDroppedEventCount;
 };
 
 #endif // FILESYSTEMEVENTLISTENER
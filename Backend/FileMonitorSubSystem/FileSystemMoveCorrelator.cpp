@@ -0,0 +1,105 @@
+#include "FileSystemMoveCorrelator.h"
+
+#include "FileStorageSubSystem/FileIngestor.h"
+
+#include <QDateTime>
+
+FileSystemMoveCorrelator::FileSystemMoveCorrelator()
+{
+    window = defaultWindow;
+}
+
+QString FileSystemMoveCorrelator::matchDeletedFile(const DeletedFile &deletedFile)
+{
+    removeExpired();
+
+    for(qsizetype index = 0; index < pendingAdds.size(); ++index)
+    {
+        if(isSameContent(deletedFile, pendingAdds[index]))
+            return pendingAdds.takeAt(index).path;
+    }
+
+    PendingDelete pendingDelete;
+    pendingDelete.file = deletedFile;
+    pendingDelete.timestamp = QDateTime::currentMSecsSinceEpoch();
+    pendingDeletes.append(pendingDelete);
+
+    return "";
+}
+
+QString FileSystemMoveCorrelator::matchAddedFile(const QString &pathToFile)
+{
+    removeExpired();
+
+    AddedFile addedFile;
+    addedFile.path = pathToFile;
+    addedFile.stat = FileSystemEventDb::readFileStat(pathToFile);
+    addedFile.timestamp = QDateTime::currentMSecsSinceEpoch();
+
+    if(!addedFile.stat.isExist)
+        return "";
+
+    for(qsizetype index = 0; index < pendingDeletes.size(); ++index)
+    {
+        if(isSameContent(pendingDeletes[index].file, addedFile))
+            return pendingDeletes.takeAt(index).file.path;
+    }
+
+    pendingAdds.append(addedFile);
+
+    return "";
+}
+
+int FileSystemMoveCorrelator::getWindow() const
+{
+    return window;
+}
+
+void FileSystemMoveCorrelator::setWindow(int milliseconds)
+{
+    window = milliseconds;
+}
+
+void FileSystemMoveCorrelator::clear()
+{
+    pendingDeletes.clear();
+    pendingAdds.clear();
+}
+
+void FileSystemMoveCorrelator::removeExpired()
+{
+    qint64 oldestTimestamp = QDateTime::currentMSecsSinceEpoch() - window;
+
+    pendingDeletes.removeIf([=](const PendingDelete &item) { return item.timestamp < oldestTimestamp; });
+    pendingAdds.removeIf([=](const AddedFile &item) { return item.timestamp < oldestTimestamp; });
+}
+
+bool FileSystemMoveCorrelator::isSameContent(const DeletedFile &deletedFile, AddedFile &addedFile) const
+{
+    if(deletedFile.stat.size != addedFile.stat.size)
+        return false;
+
+    // A move within the same file system keeps inode and mtime
+    bool isSameInode = deletedFile.stat.inode != 0 &&
+                       deletedFile.stat.inode == addedFile.stat.inode &&
+                       deletedFile.stat.modifiedTime == addedFile.stat.modifiedTime;
+
+    if(isSameInode)
+        return true;
+
+    if(deletedFile.hash.isEmpty())
+        return false;
+
+    if(addedFile.hash.isEmpty()) // Hashed once, kept for the other candidates
+    {
+        FileIngestor ingestor;
+        bool isHashed = ingestor.hashFile(addedFile.path);
+
+        if(!isHashed)
+            return false;
+
+        addedFile.hash = ingestor.getHash();
+    }
+
+    return deletedFile.hash == addedFile.hash;
+}
@@ -0,0 +1,59 @@
+#ifndef FILESYSTEMMOVECORRELATOR_H
+#define FILESYSTEMMOVECORRELATOR_H
+
+#include <QList>
+#include <QString>
+
+#include "Backend/FileMonitorSubSystem/FileSystemEventDb.h"
+
+// Moves between folders are reported as a delete and an add. Remembers both sides for a short while
+// and pairs them when they describe the same content, so the file keeps its identity instead of being re-added.
+// Not thread safe, meant to be used from the file monitor thread only.
+class FileSystemMoveCorrelator
+{
+public:
+    struct DeletedFile
+    {
+        QString path;
+        FileSystemEventDb::FileStat stat; // As of the latest version
+        QString hash; // Of the latest version
+    };
+
+    FileSystemMoveCorrelator();
+
+    // Each returns the path of the matching other side, or records the item and returns empty string
+    QString matchDeletedFile(const DeletedFile &deletedFile);
+    QString matchAddedFile(const QString &pathToFile);
+
+    // Items older than the window are never paired
+    int getWindow() const;
+    void setWindow(int milliseconds);
+
+    void clear();
+
+private:
+    struct AddedFile
+    {
+        QString path;
+        FileSystemEventDb::FileStat stat;
+        QString hash; // Computed only when a size match needs it
+        qint64 timestamp;
+    };
+
+    struct PendingDelete
+    {
+        DeletedFile file;
+        qint64 timestamp;
+    };
+
+    void removeExpired();
+    bool isSameContent(const DeletedFile &deletedFile, AddedFile &addedFile) const;
+
+    static const inline int defaultWindow = 2000; // Milliseconds
+
+    QList<PendingDelete> pendingDeletes;
+    QList<AddedFile> pendingAdds;
+    int window;
+};
+
+#endif // FILESYSTEMMOVECORRELATOR_H
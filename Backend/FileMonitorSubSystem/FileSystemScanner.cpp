@@ -0,0 +1,99 @@
+#include "FileSystemScanner.h"
+
+#include <QDir>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutexLocker>
+
+namespace
+{
+    struct ScanState
+    {
+        QThreadPool pool;
+        QMutex mutex;
+        QSet<QString> excludedPaths;
+        QList<FileSystemScanner::ScannedFolder> result;
+    };
+
+    // Returns paths of subfolders worth entering
+    QStringList listFolder(const QString &folderPath, const QSet<QString> &excludedPaths, FileSystemScanner::ScannedFolder &scannedFolder)
+    {
+        QStringList result;
+        scannedFolder.folderPath = folderPath;
+        scannedFolder.stat = FileSystemEventDb::readFileStat(folderPath);
+
+        // Single listing for both folders and files
+        QDir dir(folderPath);
+        const QFileInfoList entryList = dir.entryInfoList(QDir::Filter::Dirs | QDir::Filter::Files | QDir::Filter::NoDotAndDotDot);
+
+        for(const QFileInfo &info : entryList)
+        {
+            QString path = QDir::toNativeSeparators(info.absoluteFilePath());
+
+            if(info.isDir())
+            {
+                if(!path.endsWith(QDir::separator()))
+                    path.append(QDir::separator());
+
+                if(excludedPaths.contains(path))
+                    continue;
+
+                scannedFolder.childFolderPaths.append(path);
+
+                if(!info.isSymLink()) // Don't follow links, same as QDirIterator
+                    result.append(path);
+            }
+            else if(!excludedPaths.contains(path))
+                scannedFolder.childFilePaths.append(path);
+        }
+
+        return result;
+    }
+
+    void scanFolder(ScanState *state, const QString &folderPath)
+    {
+        FileSystemScanner::ScannedFolder scannedFolder;
+        const QStringList subFolderList = listFolder(folderPath, state->excludedPaths, scannedFolder);
+
+        for(const QString &path : subFolderList)
+            state->pool.start([state, path] { scanFolder(state, path); });
+
+        QMutexLocker locker(&state->mutex);
+        state->result.append(scannedFolder);
+    }
+}
+
+QList<FileSystemScanner::ScannedFolder> FileSystemScanner::scan(const QStringList &rootFolderPaths, const QSet<QString> &excludedPaths)
+{
+    ScanState state;
+    state.excludedPaths = excludedPaths;
+    state.pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+
+    for(const QString &rootFolderPath : rootFolderPaths)
+    {
+        QString path = QDir::toNativeSeparators(rootFolderPath);
+
+        if(!path.endsWith(QDir::separator()))
+            path.append(QDir::separator());
+
+        state.pool.start([&state, path] { scanFolder(&state, path); });
+    }
+
+    state.pool.waitForDone(); // Also waits for subfolders queued meanwhile
+
+    return state.result;
+}
+
+FileSystemScanner::ScannedFolder FileSystemScanner::list(const QString &folderPath, const QSet<QString> &excludedPaths)
+{
+    QString path = QDir::toNativeSeparators(folderPath);
+
+    if(!path.endsWith(QDir::separator()))
+        path.append(QDir::separator());
+
+    ScannedFolder result;
+    listFolder(path, excludedPaths, result);
+
+    return result;
+}
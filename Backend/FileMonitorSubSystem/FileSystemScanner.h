@@ -0,0 +1,29 @@
+#ifndef FILESYSTEMSCANNER_H
+#define FILESYSTEMSCANNER_H
+
+#include "Backend/FileMonitorSubSystem/FileSystemEventDb.h"
+
+#include <QSet>
+#include <QList>
+#include <QStringList>
+
+class FileSystemScanner
+{
+public:
+    struct ScannedFolder
+    {
+        QString folderPath;
+        FileSystemEventDb::FileStat stat; // Taken before listing, so later changes show up as a newer modified time
+        QStringList childFolderPaths; // Native paths ending with separator
+        QStringList childFilePaths;
+    };
+
+    // Lists every tree once, in parallel. Each folder is a separate task and its subfolders are queued back to the pool,
+    // so idle threads keep picking up other subtrees. Excluded paths are neither reported nor entered.
+    static QList<ScannedFolder> scan(const QStringList &rootFolderPaths, const QSet<QString> &excludedPaths);
+
+    // Lists direct children of a single folder only
+    static ScannedFolder list(const QString &folderPath, const QSet<QString> &excludedPaths);
+};
+
+#endif // FILESYSTEMSCANNER_H
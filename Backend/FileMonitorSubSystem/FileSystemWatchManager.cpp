@@ -0,0 +1,295 @@
+#include "FileSystemWatchManager.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+namespace
+{
+    bool isStatChanged(const FileSystemEventDb::FileStat &first, const FileSystemEventDb::FileStat &second)
+    {
+        return first.size != second.size || first.modifiedTime != second.modifiedTime;
+    }
+}
+
+FileSystemWatchManager::FileSystemWatchManager(efsw::FileWatcher &fileWatcher, efsw::FileWatchListener *listener)
+    : fileWatcher(fileWatcher)
+{
+    this->listener = listener;
+    mode = defaultMode();
+    watchBudget = defaultWatchBudget();
+    watchCount = 0;
+    lastWatchId = 0;
+}
+
+efsw::WatchID FileSystemWatchManager::addWatch(const QString &folderPath)
+{
+    QString path = QDir::toNativeSeparators(folderPath);
+
+    if(!path.endsWith(QDir::separator()))
+        path.append(QDir::separator());
+
+    if(mode == Mode::Recursive)
+    {
+        for(auto root = recursiveRoots.constBegin(); root != recursiveRoots.constEnd(); ++root)
+        {
+            if(path.startsWith(root.key()))
+            {
+                Entry entry;
+                entry.kind = Kind::Covered;
+                entry.folderPath = path;
+
+                return insertEntry(entry);
+            }
+        }
+
+        efsw::WatchID efswID = fileWatcher.addWatch(path.toStdString(), listener, true);
+
+        if(efswID <= 0)
+            return efswID;
+
+        ++watchCount;
+
+        Entry entry;
+        entry.kind = Kind::Watched;
+        entry.efswID = efswID;
+        entry.folderPath = path;
+
+        efsw::WatchID result = insertEntry(entry);
+        recursiveRoots.insert(path, result);
+
+        return result;
+    }
+
+    if(watchBudget >= 0 && watchCount >= watchBudget)
+        return addPolledFolder(path);
+
+    efsw::WatchID efswID = fileWatcher.addWatch(path.toStdString(), listener, false);
+
+    if(efswID <= 0)
+    {
+        // Kernel ran out of watches or the file system can't be watched, polling still works
+        bool isPollable = efswID == efsw::Error::WatcherFailed ||
+                          efswID == efsw::Error::FileRemote ||
+                          efswID == efsw::Error::Unspecified;
+
+        if(isPollable)
+            return addPolledFolder(path);
+
+        return efswID;
+    }
+
+    ++watchCount;
+
+    Entry entry;
+    entry.kind = Kind::Watched;
+    entry.efswID = efswID;
+    entry.folderPath = path;
+
+    return insertEntry(entry);
+}
+
+void FileSystemWatchManager::removeWatch(efsw::WatchID watchId)
+{
+    auto entry = entries.find(watchId);
+
+    if(entry == entries.end())
+        return;
+
+    if(entry->kind == Kind::Watched)
+    {
+        fileWatcher.removeWatch(entry->efswID);
+        --watchCount;
+
+        auto root = recursiveRoots.find(entry->folderPath);
+
+        if(root != recursiveRoots.end() && root.value() == watchId)
+            recursiveRoots.erase(root);
+    }
+    else if(entry->kind == Kind::Polled)
+        polledFolders.remove(entry->folderPath);
+
+    entries.erase(entry);
+}
+
+QList<FileSystemEventCoalescer::Event> FileSystemWatchManager::poll()
+{
+    QList<FileSystemEventCoalescer::Event> result;
+
+    auto appendEvent = [&result](efsw::Action action, const QString &dir, const QString &fileName)
+    {
+        FileSystemEventCoalescer::Event event;
+        event.action = action;
+        event.dir = dir;
+        event.fileName = fileName;
+
+        result.append(event);
+    };
+
+    for(auto folder = polledFolders.begin(); folder != polledFolders.end(); ++folder)
+    {
+        const QString &folderPath = folder.key();
+        FileSystemEventDb::FileStat folderStat = FileSystemEventDb::readFileStat(folderPath);
+
+        if(!folderStat.isExist) // Stays polled until monitor handles the delete and removes the watch
+        {
+            appendEvent(efsw::Actions::Delete, folderPath, "");
+            continue;
+        }
+
+        if(folderStat.modifiedTime != folder->modifiedTime) // Entries were added or removed, list folder again
+        {
+            PolledFolder current = readPolledFolder(folderPath);
+
+            for(const QString &name : std::as_const(current.childFolderNames))
+            {
+                if(!folder->childFolderNames.contains(name))
+                    appendEvent(efsw::Actions::Add, folderPath, name);
+            }
+
+            for(const QString &name : std::as_const(folder->childFolderNames))
+            {
+                if(!current.childFolderNames.contains(name))
+                    appendEvent(efsw::Actions::Delete, folderPath, name);
+            }
+
+            for(auto file = current.childFiles.constBegin(); file != current.childFiles.constEnd(); ++file)
+            {
+                auto previous = folder->childFiles.constFind(file.key());
+
+                if(previous == folder->childFiles.constEnd())
+                    appendEvent(efsw::Actions::Add, folderPath, file.key());
+                else if(isStatChanged(file.value(), previous.value()))
+                    appendEvent(efsw::Actions::Modified, folderPath, file.key());
+            }
+
+            for(auto file = folder->childFiles.constBegin(); file != folder->childFiles.constEnd(); ++file)
+            {
+                if(!current.childFiles.contains(file.key()))
+                    appendEvent(efsw::Actions::Delete, folderPath, file.key());
+            }
+
+            *folder = current;
+        }
+        else // Same entries, only contents may have changed
+        {
+            for(auto file = folder->childFiles.begin(); file != folder->childFiles.end(); ++file)
+            {
+                FileSystemEventDb::FileStat fileStat = FileSystemEventDb::readFileStat(folderPath + file.key());
+
+                if(isStatChanged(fileStat, file.value()))
+                {
+                    appendEvent(efsw::Actions::Modified, folderPath, file.key());
+                    file.value() = fileStat;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+FileSystemWatchManager::Mode FileSystemWatchManager::getMode() const
+{
+    return mode;
+}
+
+void FileSystemWatchManager::setMode(Mode newMode)
+{
+    mode = newMode;
+}
+
+int FileSystemWatchManager::getWatchBudget() const
+{
+    return watchBudget;
+}
+
+void FileSystemWatchManager::setWatchBudget(int newWatchBudget)
+{
+    watchBudget = newWatchBudget;
+}
+
+int FileSystemWatchManager::getWatchCount() const
+{
+    return watchCount;
+}
+
+int FileSystemWatchManager::getPolledFolderCount() const
+{
+    return polledFolders.size();
+}
+
+FileSystemWatchManager::Mode FileSystemWatchManager::defaultMode()
+{
+#ifdef Q_OS_LINUX
+    return Mode::PerFolder; // efsw still takes one inotify watch per folder for recursive watches
+#else
+    return Mode::Recursive;
+#endif
+}
+
+int FileSystemWatchManager::defaultWatchBudget()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/sys/fs/inotify/max_user_watches");
+
+    if(file.open(QIODevice::OpenModeFlag::ReadOnly))
+    {
+        bool isNumber = false;
+        int maxUserWatches = file.readAll().trimmed().toInt(&isNumber);
+
+        if(isNumber && maxUserWatches > 0)
+            return maxUserWatches / 2; // Leave the other half to the rest of the system
+    }
+
+    return 4096;
+#else
+    return -1;
+#endif
+}
+
+efsw::WatchID FileSystemWatchManager::addPolledFolder(const QString &folderPath)
+{
+    polledFolders.insert(folderPath, readPolledFolder(folderPath));
+
+    Entry entry;
+    entry.kind = Kind::Polled;
+    entry.folderPath = folderPath;
+
+    return insertEntry(entry);
+}
+
+FileSystemWatchManager::PolledFolder FileSystemWatchManager::readPolledFolder(const QString &folderPath) const
+{
+    PolledFolder result;
+    result.modifiedTime = FileSystemEventDb::readFileStat(folderPath).modifiedTime;
+
+    QDir dir(folderPath);
+    const QFileInfoList entryList = dir.entryInfoList(QDir::Filter::Dirs | QDir::Filter::Files | QDir::Filter::NoDotAndDotDot);
+
+    for(const QFileInfo &info : entryList)
+    {
+        if(info.isDir())
+            result.childFolderNames.insert(info.fileName());
+        else
+        {
+            // Listing already carries the metadata, no extra stat call needed
+            FileSystemEventDb::FileStat stat;
+            stat.isExist = true;
+            stat.size = info.size();
+            stat.modifiedTime = info.lastModified().toMSecsSinceEpoch();
+
+            result.childFiles.insert(info.fileName(), stat);
+        }
+    }
+
+    return result;
+}
+
+efsw::WatchID FileSystemWatchManager::insertEntry(const Entry &entry)
+{
+    ++lastWatchId;
+    entries.insert(lastWatchId, entry);
+
+    return lastWatchId;
+}
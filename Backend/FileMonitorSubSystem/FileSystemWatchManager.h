@@ -0,0 +1,84 @@
+#ifndef FILESYSTEMWATCHMANAGER_H
+#define FILESYSTEMWATCHMANAGER_H
+
+#include <efsw/efsw.hpp>
+
+#include <QSet>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include "Backend/FileMonitorSubSystem/FileSystemEventDb.h"
+#include "Backend/FileMonitorSubSystem/FileSystemEventCoalescer.h"
+
+// Decides how each monitored folder is watched and hands out watch ids stored in event db.
+// Recursive mode places a single efsw watch on every root and covers folders below it.
+// Per folder mode places one efsw watch on each folder until the budget runs out, remaining folders are polled.
+// Not thread safe, meant to be used from the file monitor thread only.
+class FileSystemWatchManager
+{
+public:
+    enum class Mode
+    {
+        PerFolder,
+        Recursive
+    };
+
+    FileSystemWatchManager(efsw::FileWatcher &fileWatcher, efsw::FileWatchListener *listener);
+
+    // Returns an id greater than 0 when folder is watched or polled, efsw error code otherwise
+    efsw::WatchID addWatch(const QString &folderPath);
+    void removeWatch(efsw::WatchID watchId);
+
+    // Compares polled folders with their previous state and returns differences as regular events
+    QList<FileSystemEventCoalescer::Event> poll();
+
+    Mode getMode() const;
+    void setMode(Mode newMode); // Applies to watches added afterwards
+    int getWatchBudget() const;
+    void setWatchBudget(int newWatchBudget); // Negative means unlimited
+
+    int getWatchCount() const; // Watches taken from efsw
+    int getPolledFolderCount() const;
+
+    static Mode defaultMode();
+    static int defaultWatchBudget();
+
+private:
+    enum class Kind
+    {
+        Watched,
+        Covered, // Below a recursive watch
+        Polled
+    };
+
+    struct Entry
+    {
+        Kind kind = Kind::Watched;
+        efsw::WatchID efswID = 0;
+        QString folderPath;
+    };
+
+    struct PolledFolder
+    {
+        qint64 modifiedTime = -1;
+        QSet<QString> childFolderNames;
+        QHash<QString, FileSystemEventDb::FileStat> childFiles; // File name -> stat
+    };
+
+    efsw::WatchID addPolledFolder(const QString &folderPath);
+    PolledFolder readPolledFolder(const QString &folderPath) const;
+    efsw::WatchID insertEntry(const Entry &entry);
+
+    efsw::FileWatcher &fileWatcher;
+    efsw::FileWatchListener *listener;
+    Mode mode;
+    int watchBudget;
+    int watchCount;
+    efsw::WatchID lastWatchId;
+    QHash<efsw::WatchID, Entry> entries;
+    QHash<QString, efsw::WatchID> recursiveRoots; // Root path -> id
+    QHash<QString, PolledFolder> polledFolders;
+};
+
+#endif // FILESYSTEMWATCHMANAGER_H
@@ -0,0 +1,268 @@
+#include "BlobReader.h"
+
+#include <algorithm>
+
+BlobReader::BlobReader(const QList<Layer> &chain)
+{
+    this->chain = chain;
+}
+
+BlobReader::~BlobReader()
+{
+    close();
+}
+
+bool BlobReader::open(OpenMode mode)
+{
+    if(mode != OpenModeFlag::ReadOnly || chain.isEmpty())
+        return false;
+
+    layers.clear();
+
+    for(const Layer &currentLayer : qAsConst(chain))
+    {
+        OpenLayer layer;
+        layer.kind = currentLayer.kind;
+
+        if(layer.kind == Kind::Chunked)
+        {
+            layer.chunkList = currentLayer.chunkList;
+
+            for(const Chunk &chunk : qAsConst(layer.chunkList))
+            {
+                layer.chunkOffsets.append(layer.size);
+                layer.size += chunk.size;
+            }
+
+            layers.append(layer);
+            continue;
+        }
+
+        layer.file = QSharedPointer<QFile>::create(currentLayer.filePath);
+
+        if(!layer.file->open(QFile::OpenModeFlag::ReadOnly))
+        {
+            layers.clear();
+            return false;
+        }
+
+        if(layer.kind == Kind::Delta)
+        {
+            bool isRead = DeltaCodec::readOpList(*layer.file, layer.opList, layer.size);
+
+            if(!isRead)
+            {
+                layers.clear();
+                return false;
+            }
+        }
+        else if(layer.kind == Kind::Compressed)
+        {
+            bool isRead = CompressionCodec::readBlockList(*layer.file, layer.blockList, layer.size);
+
+            if(!isRead)
+            {
+                layers.clear();
+                return false;
+            }
+        }
+        else
+            layer.size = layer.file->size();
+
+        layers.append(layer);
+    }
+
+    // Chain must end with a full content, otherwise copy ops have nowhere to read from
+    if(layers.last().kind == Kind::Delta)
+    {
+        layers.clear();
+        return false;
+    }
+
+    // Caller's reads already come in large chunks, no need for another buffer
+    return QIODevice::open(mode | OpenModeFlag::Unbuffered);
+}
+
+void BlobReader::close()
+{
+    if(isOpen())
+        QIODevice::close();
+
+    layers.clear();
+    packFiles.clear();
+}
+
+bool BlobReader::isSequential() const
+{
+    return false;
+}
+
+qint64 BlobReader::size() const
+{
+    if(layers.isEmpty())
+        return 0;
+
+    return layers.first().size;
+}
+
+qint64 BlobReader::readData(char *data, qint64 maxSize)
+{
+    qint64 length = qMin(maxSize, size() - pos());
+
+    if(length <= 0)
+        return 0;
+
+    bool isRead = readAt(0, pos(), data, length);
+
+    if(!isRead)
+        return -1;
+
+    return length;
+}
+
+qint64 BlobReader::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+
+    return -1;
+}
+
+bool BlobReader::readAt(int layerIndex, qint64 offset, char *data, qint64 length)
+{
+    OpenLayer &layer = layers[layerIndex];
+
+    if(layer.kind == Kind::Chunked)
+        return readChunksAt(layer, offset, data, length);
+
+    if(layer.kind == Kind::Compressed)
+        return readBlocksAt(layer, offset, data, length);
+
+    if(layer.kind == Kind::File)
+    {
+        if(!layer.file->seek(offset))
+            return false;
+
+        return layer.file->read(data, length) == length;
+    }
+
+    // Last op starting at or before the offset
+    auto op = std::upper_bound(layer.opList.cbegin(), layer.opList.cend(), offset,
+                               [](qint64 value, const DeltaCodec::Op &item) { return value < item.targetOffset; });
+
+    if(op == layer.opList.cbegin())
+        return false;
+
+    --op;
+    qint64 bytesDone = 0;
+
+    for(; op != layer.opList.cend() && bytesDone < length; ++op)
+    {
+        qint64 innerOffset = offset + bytesDone - op->targetOffset;
+        qint64 bytesToRead = qMin(op->length - innerOffset, length - bytesDone);
+
+        if(op->kind == DeltaCodec::OpKind::Copy)
+        {
+            if(layerIndex + 1 >= layers.size())
+                return false;
+
+            if(!readAt(layerIndex + 1, op->sourceOffset + innerOffset, data + bytesDone, bytesToRead))
+                return false;
+        }
+        else
+        {
+            if(!layer.file->seek(op->sourceOffset + innerOffset))
+                return false;
+
+            if(layer.file->read(data + bytesDone, bytesToRead) != bytesToRead)
+                return false;
+        }
+
+        bytesDone += bytesToRead;
+    }
+
+    return bytesDone == length;
+}
+
+bool BlobReader::readChunksAt(OpenLayer &layer, qint64 offset, char *data, qint64 length)
+{
+    // Last chunk starting at or before the offset
+    auto chunkOffset = std::upper_bound(layer.chunkOffsets.cbegin(), layer.chunkOffsets.cend(), offset);
+
+    if(chunkOffset == layer.chunkOffsets.cbegin())
+        return false;
+
+    qsizetype index = std::distance(layer.chunkOffsets.cbegin(), chunkOffset) - 1;
+    qint64 bytesDone = 0;
+
+    for(; index < layer.chunkList.size() && bytesDone < length; ++index)
+    {
+        const Chunk &chunk = layer.chunkList.at(index);
+        qint64 innerOffset = offset + bytesDone - layer.chunkOffsets.at(index);
+        qint64 bytesToRead = qMin(chunk.size - innerOffset, length - bytesDone);
+
+        QSharedPointer<QFile> packFile = packFiles.value(chunk.packFilePath);
+
+        if(packFile.isNull())
+        {
+            packFile = QSharedPointer<QFile>::create(chunk.packFilePath);
+
+            if(!packFile->open(QFile::OpenModeFlag::ReadOnly))
+                return false;
+
+            packFiles.insert(chunk.packFilePath, packFile);
+        }
+
+        if(!packFile->seek(chunk.offset + innerOffset))
+            return false;
+
+        if(packFile->read(data + bytesDone, bytesToRead) != bytesToRead)
+            return false;
+
+        bytesDone += bytesToRead;
+    }
+
+    return bytesDone == length;
+}
+
+bool BlobReader::readBlocksAt(OpenLayer &layer, qint64 offset, char *data, qint64 length)
+{
+    qint64 bytesDone = 0;
+
+    while(bytesDone < length)
+    {
+        qint64 index = (offset + bytesDone) / CompressionCodec::blockSize;
+
+        if(index >= layer.blockList.size())
+            return false;
+
+        if(index != layer.cachedBlockIndex)
+        {
+            const CompressionCodec::Block &block = layer.blockList.at(index);
+
+            if(!layer.file->seek(block.offset))
+                return false;
+
+            QByteArray compressedBlock = layer.file->read(block.length);
+
+            if(compressedBlock.size() != block.length || !CompressionCodec::decompressBlock(compressedBlock, layer.cachedBlock))
+            {
+                layer.cachedBlockIndex = -1;
+                return false;
+            }
+
+            layer.cachedBlockIndex = index;
+        }
+
+        qint64 innerOffset = offset + bytesDone - (index * CompressionCodec::blockSize);
+        qint64 bytesToRead = qMin(layer.cachedBlock.size() - innerOffset, length - bytesDone);
+
+        if(bytesToRead <= 0)
+            return false;
+
+        std::copy_n(layer.cachedBlock.constData() + innerOffset, bytesToRead, data + bytesDone);
+        bytesDone += bytesToRead;
+    }
+
+    return true;
+}
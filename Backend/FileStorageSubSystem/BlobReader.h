@@ -0,0 +1,77 @@
+#ifndef BLOBREADER_H
+#define BLOBREADER_H
+
+#include "DeltaCodec.h"
+#include "CompressionCodec.h"
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QIODevice>
+#include <QSharedPointer>
+
+// Read only, random access view of a stored blob's content. Deltas and compressed blocks are resolved on the fly,
+// copy ops read from the next layer of the chain, so nothing is reconstructed on disk.
+class BlobReader : public QIODevice
+{
+public:
+    enum class Kind
+    {
+        File,
+        Delta,
+        Chunked,
+        Compressed
+    };
+
+    struct Chunk
+    {
+        QString packFilePath;
+        qint64 offset = 0;
+        qint64 size = 0;
+    };
+
+    struct Layer
+    {
+        Kind kind = Kind::File;
+        QString filePath; // Empty for chunked layers
+        QList<Chunk> chunkList; // In content order, chunked layers only
+    };
+
+    // Blob itself comes first, each delta is followed by its base
+    BlobReader(const QList<Layer> &chain);
+    ~BlobReader();
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    struct OpenLayer
+    {
+        Kind kind = Kind::File;
+        QSharedPointer<QFile> file;
+        qint64 size = 0;
+        QList<DeltaCodec::Op> opList;
+        QList<Chunk> chunkList;
+        QList<qint64> chunkOffsets; // Content offset of each chunk
+        QList<CompressionCodec::Block> blockList;
+        qint64 cachedBlockIndex = -1; // Reads come in order mostly, last inflated block is kept
+        QByteArray cachedBlock;
+    };
+
+    bool readAt(int layerIndex, qint64 offset, char *data, qint64 length);
+    bool readChunksAt(OpenLayer &layer, qint64 offset, char *data, qint64 length);
+    bool readBlocksAt(OpenLayer &layer, qint64 offset, char *data, qint64 length);
+
+    QHash<QString, QSharedPointer<QFile>> packFiles; // Opened on first use, chunks of a blob share few packs
+
+    QList<Layer> chain;
+    QList<OpenLayer> layers;
+};
+
+#endif // BLOBREADER_H
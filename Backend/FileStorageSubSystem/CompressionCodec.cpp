@@ -0,0 +1,240 @@
+#include "CompressionCodec.h"
+
+#include <QFile>
+#include <QThread>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+#include <cmath>
+
+namespace
+{
+    // QIODevice::read() may return less than asked before the end, keeps reading until length or end.
+    qint64 readFully(QIODevice &device, char *data, qint64 length)
+    {
+        qint64 result = 0;
+
+        while(result < length)
+        {
+            qint64 bytesRead = device.read(data + result, length - result);
+
+            if(bytesRead < 0)
+                return -1;
+
+            if(bytesRead == 0)
+                break;
+
+            result += bytesRead;
+        }
+
+        return result;
+    }
+}
+
+CompressionCodec::CompressionCodec()
+{
+    hash = "";
+    size = 0;
+    compressedSize = 0;
+}
+
+bool CompressionCodec::isCompressible(const QString &pathToFile)
+{
+    QFile file(pathToFile);
+
+    if(!file.open(QFile::OpenModeFlag::ReadOnly) || file.size() < minFileSize)
+        return false;
+
+    // Head and middle, headers alone don't tell much about the rest of the file
+    QByteArray sample = file.read(probeSize / 2);
+
+    if(file.size() > probeSize && file.seek(file.size() / 2))
+        sample += file.read(probeSize / 2);
+
+    if(sample.isEmpty())
+        return false;
+
+    return entropy(sample.constData(), sample.size()) <= maxProbeEntropy;
+}
+
+bool CompressionCodec::compress(QIODevice &source, const QString &compressedFilePath, int level, qint64 sizeLimit)
+{
+    hash = "";
+    size = 0;
+    compressedSize = 0;
+
+    if(!source.seek(0))
+        return false;
+
+    // Buffered, block table is written field by field
+    QFile compressedFile(compressedFilePath);
+    bool isOpen = compressedFile.open(QFile::OpenModeFlag::WriteOnly | QFile::OpenModeFlag::Truncate);
+
+    if(!isOpen)
+        return false;
+
+    QCryptographicHash hasher(QCryptographicHash::Algorithm::Sha3_256);
+    QByteArray buffer(blockSize, Qt::Initialization::Uninitialized);
+    QList<qint64> blockLengthList;
+    qint64 dataSize = 0;
+
+    while(true)
+    {
+        qint64 bytesRead = readFully(source, buffer.data(), blockSize);
+
+        if(bytesRead < 0)
+            return false;
+
+        if(bytesRead == 0)
+            break;
+
+        if(QThread::currentThread()->isInterruptionRequested()) // Background maintenance is stopping
+            return false;
+
+        hasher.addData(QByteArrayView(buffer.constData(), bytesRead));
+        size += bytesRead;
+
+        QByteArray block = qCompress(reinterpret_cast<const uchar *>(buffer.constData()), bytesRead, level);
+
+        if(block.size() >= bytesRead) // Incompressible block, stored so the output barely grows past the content
+        {
+            QByteArray storedBlock = qCompress(reinterpret_cast<const uchar *>(buffer.constData()), bytesRead, 0);
+
+            if(!storedBlock.isEmpty() && storedBlock.size() < block.size())
+                block = storedBlock;
+        }
+
+        if(block.isEmpty() || compressedFile.write(block) != block.size())
+            return false;
+
+        blockLengthList.append(block.size());
+        dataSize += block.size();
+
+        bool isOverLimit = sizeLimit >= 0 && dataSize + (blockLengthList.size() * blockEntrySize) + footerSize > sizeLimit;
+
+        if(isOverLimit)
+            return false;
+
+        if(bytesRead < blockSize)
+            break;
+    }
+
+    QDataStream stream(&compressedFile);
+
+    for(qint64 blockLength : qAsConst(blockLengthList))
+        stream << blockLength;
+
+    stream << footerMagic << formatVersion << static_cast<quint32>(level)
+           << static_cast<qint64>(size) << dataSize << static_cast<qint64>(blockLengthList.size());
+
+    if(stream.status() != QDataStream::Status::Ok)
+        return false;
+
+    compressedSize = compressedFile.size();
+    compressedFile.close();
+
+    if(compressedFile.error() != QFile::FileError::NoError)
+        return false;
+
+    hash = QString(hasher.result().toHex());
+
+    return true;
+}
+
+QString CompressionCodec::getHash() const
+{
+    return hash;
+}
+
+qlonglong CompressionCodec::getSize() const
+{
+    return size;
+}
+
+qlonglong CompressionCodec::getCompressedSize() const
+{
+    return compressedSize;
+}
+
+bool CompressionCodec::readBlockList(QIODevice &compressedFile, QList<Block> &blockList, qint64 &contentSize)
+{
+    blockList.clear();
+    contentSize = 0;
+
+    qint64 fileSize = compressedFile.size();
+
+    if(fileSize < footerSize || !compressedFile.seek(fileSize - footerSize))
+        return false;
+
+    QDataStream stream(&compressedFile);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 level = 0;
+    qint64 storedContentSize = 0;
+    qint64 blockTableOffset = 0;
+    qint64 blockCount = 0;
+
+    stream >> magic >> version >> level >> storedContentSize >> blockTableOffset >> blockCount;
+
+    if(stream.status() != QDataStream::Status::Ok || magic != footerMagic || version != formatVersion)
+        return false;
+
+    if(blockTableOffset < 0 || blockCount < 0 || blockTableOffset + (blockCount * blockEntrySize) != fileSize - footerSize)
+        return false;
+
+    if(storedContentSize < 0 || blockCount != (storedContentSize + blockSize - 1) / blockSize)
+        return false;
+
+    if(!compressedFile.seek(blockTableOffset))
+        return false;
+
+    blockList.reserve(blockCount);
+    qint64 offset = 0;
+
+    for(qint64 index = 0; index < blockCount; ++index)
+    {
+        Block block;
+        stream >> block.length;
+
+        block.offset = offset;
+        offset += block.length;
+
+        blockList.append(block);
+    }
+
+    if(stream.status() != QDataStream::Status::Ok || offset != blockTableOffset)
+        return false;
+
+    contentSize = storedContentSize;
+
+    return true;
+}
+
+bool CompressionCodec::decompressBlock(const QByteArray &compressedBlock, QByteArray &block)
+{
+    block = qUncompress(compressedBlock);
+
+    return !block.isEmpty(); // Empty blocks are never written
+}
+
+double CompressionCodec::entropy(const char *data, qint64 length)
+{
+    qint64 histogram[256] = {};
+
+    for(qint64 index = 0; index < length; ++index)
+        ++histogram[static_cast<unsigned char>(data[index])];
+
+    double result = 0;
+
+    for(qint64 count : histogram)
+    {
+        if(count == 0)
+            continue;
+
+        double probability = static_cast<double>(count) / length;
+        result -= probability * std::log2(probability);
+    }
+
+    return result;
+}
@@ -0,0 +1,56 @@
+#ifndef COMPRESSIONCODEC_H
+#define COMPRESSIONCODEC_H
+
+#include <QList>
+#include <QString>
+#include <QIODevice>
+#include <QByteArray>
+
+// Compresses content in independent fixed size blocks, so any offset can be read without inflating what comes before.
+// Compressed file holds the blocks first, then the block table and a fixed size footer, so it's written in one pass.
+class CompressionCodec
+{
+public:
+    struct Block
+    {
+        qint64 offset = 0; // In compressed file
+        qint64 length = 0; // Compressed length
+    };
+
+    static const inline qint64 blockSize = 256 * 1024;
+    static const inline qint64 minFileSize = 4096; // Smaller files gain a few bytes at most
+    static const inline qint64 probeSize = 64 * 1024;
+    static const inline double maxProbeEntropy = 7.5; // Bits per byte, compressed or encrypted data is close to 8
+
+    CompressionCodec();
+
+    // Samples the file and tells whether compressing it is worth the time
+    static bool isCompressible(const QString &pathToFile);
+
+    // Writes compressed content of the source, source is hashed on the way. Level is a zlib level, 1 is fastest.
+    // Gives up and returns false once the output grows past sizeLimit, negative means no limit.
+    // Blocks which don't compress are stored, so output is only a few bytes per block larger than the content at worst.
+    bool compress(QIODevice &source, const QString &compressedFilePath, int level, qint64 sizeLimit = -1);
+
+    QString getHash() const; // Of the uncompressed content
+    qlonglong getSize() const;
+    qlonglong getCompressedSize() const;
+
+    // Reads the block table of a compressed file, every block but the last one holds blockSize bytes
+    static bool readBlockList(QIODevice &compressedFile, QList<Block> &blockList, qint64 &contentSize);
+    static bool decompressBlock(const QByteArray &compressedBlock, QByteArray &block);
+
+private:
+    static const inline quint32 footerMagic = 0x4E535A42; // "NSZB"
+    static const inline quint32 formatVersion = 1;
+    static const inline qint64 blockEntrySize = 8; // Compressed length, offsets are calculated while reading
+    static const inline qint64 footerSize = 36;
+
+    static double entropy(const char *data, qint64 length);
+
+    QString hash;
+    qlonglong size;
+    qlonglong compressedSize;
+};
+
+#endif // COMPRESSIONCODEC_H
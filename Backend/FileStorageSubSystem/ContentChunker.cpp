@@ -0,0 +1,143 @@
+#include "ContentChunker.h"
+
+#include "FileIngestor.h"
+
+ContentChunker::ContentChunker() : hasher(QCryptographicHash::Algorithm::Sha3_256)
+{
+    source = nullptr;
+    bufferBegin = 0;
+    isFileEnd = false;
+    hash = "";
+    size = 0;
+}
+
+bool ContentChunker::open(const QString &pathToFile)
+{
+    file.close();
+    file.setFileName(pathToFile);
+
+    if(!file.open(QFile::OpenModeFlag::ReadOnly | QFile::OpenModeFlag::Unbuffered))
+        return false;
+
+    return open(&file);
+}
+
+bool ContentChunker::open(QIODevice *device)
+{
+    source = device;
+    buffer.clear();
+    bufferBegin = 0;
+    isFileEnd = false;
+    hasher.reset();
+    hash = "";
+    size = 0;
+
+    return source != nullptr && source->isReadable();
+}
+
+qint64 ContentChunker::nextChunk(QByteArray &chunk)
+{
+    chunk.clear();
+
+    if(source == nullptr)
+        return -1;
+
+    if(buffer.size() - bufferBegin < maxChunkSize && !isFileEnd) // Cut point may be beyond the buffered bytes
+    {
+        buffer.remove(0, bufferBegin);
+        bufferBegin = 0;
+
+        qint64 oldSize = buffer.size();
+        buffer.resize(oldSize + FileIngestor::chunkSize);
+        qint64 bytesRead = source->read(buffer.data() + oldSize, FileIngestor::chunkSize);
+
+        if(bytesRead < 0)
+            return -1;
+
+        buffer.resize(oldSize + bytesRead);
+        hasher.addData(QByteArrayView(buffer.constData() + oldSize, bytesRead));
+        size += bytesRead;
+
+        isFileEnd = bytesRead == 0;
+    }
+
+    qint64 available = buffer.size() - bufferBegin;
+
+    if(available == 0)
+    {
+        if(hash.isEmpty())
+            hash = QString(hasher.result().toHex());
+
+        return 0;
+    }
+
+    qint64 cutPoint = findCutPoint(buffer.constData() + bufferBegin, available);
+    chunk = buffer.mid(bufferBegin, cutPoint);
+    bufferBegin += cutPoint;
+
+    return cutPoint;
+}
+
+QString ContentChunker::getHash() const
+{
+    return hash;
+}
+
+qlonglong ContentChunker::getSize() const
+{
+    return size;
+}
+
+const quint64 *ContentChunker::gearTable()
+{
+    // Fixed seed, cut points must be the same on every run for chunks to be shared
+    static const QList<quint64> table = []
+    {
+        QList<quint64> result;
+        quint64 state = 0x4E6553796E634344; // splitmix64
+
+        for(int index = 0; index < 256; ++index)
+        {
+            state += 0x9E3779B97F4A7C15;
+            quint64 value = state;
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+            result.append(value ^ (value >> 31));
+        }
+
+        return result;
+    }();
+
+    return table.constData();
+}
+
+qint64 ContentChunker::findCutPoint(const char *data, qint64 length)
+{
+    if(length <= minChunkSize)
+        return length;
+
+    qint64 limit = qMin(length, maxChunkSize);
+    qint64 normalSize = qMin(limit, averageChunkSize);
+
+    const quint64 *gear = gearTable();
+    quint64 fingerprint = 0;
+    qint64 index = minChunkSize;
+
+    for(; index < normalSize; ++index)
+    {
+        fingerprint = (fingerprint << 1) + gear[static_cast<unsigned char>(data[index])];
+
+        if((fingerprint & maskSmall) == 0)
+            return index + 1;
+    }
+
+    for(; index < limit; ++index)
+    {
+        fingerprint = (fingerprint << 1) + gear[static_cast<unsigned char>(data[index])];
+
+        if((fingerprint & maskLarge) == 0)
+            return index + 1;
+    }
+
+    return limit;
+}
@@ -0,0 +1,46 @@
+#ifndef CONTENTCHUNKER_H
+#define CONTENTCHUNKER_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QCryptographicHash>
+
+// Splits a file into content defined chunks (FastCDC with normalized chunking) and hashes the whole file on the way.
+// Cut points depend only on nearby bytes, so an insertion moves just the chunks around it and the rest stay shareable.
+class ContentChunker
+{
+public:
+    static const inline qint64 minChunkSize = 16 * 1024;
+    static const inline qint64 averageChunkSize = 64 * 1024;
+    static const inline qint64 maxChunkSize = 256 * 1024;
+
+    ContentChunker();
+
+    bool open(const QString &pathToFile);
+    bool open(QIODevice *device); // Read from the current position, device is not owned
+
+    // Size of the next chunk, 0 at the end of file and -1 on read error
+    qint64 nextChunk(QByteArray &chunk);
+
+    QString getHash() const; // Of the whole file, valid once nextChunk() returns 0
+    qlonglong getSize() const;
+
+private:
+    static const inline quint64 maskSmall = 0xFFFFC00000000000; // 18 bits, harder to cut before the average size
+    static const inline quint64 maskLarge = 0xFFFC000000000000; // 14 bits, easier to cut after it
+
+    static const quint64 *gearTable();
+    static qint64 findCutPoint(const char *data, qint64 length);
+
+    QFile file;
+    QIODevice *source;
+    QByteArray buffer;
+    qint64 bufferBegin;
+    bool isFileEnd;
+    QCryptographicHash hasher;
+    QString hash;
+    qlonglong size;
+};
+
+#endif // CONTENTCHUNKER_H
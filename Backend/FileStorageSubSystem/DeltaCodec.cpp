@@ -0,0 +1,349 @@
+#include "DeltaCodec.h"
+
+#include "FileIngestor.h"
+
+#include <QFile>
+#include <QThread>
+#include <QMultiHash>
+#include <QByteArray>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+#include <cstring>
+
+namespace
+{
+    // QIODevice::read() may return less than asked before the end, keeps reading until length or end.
+    qint64 readFully(QIODevice &device, char *data, qint64 length)
+    {
+        qint64 result = 0;
+
+        while(result < length)
+        {
+            qint64 bytesRead = device.read(data + result, length - result);
+
+            if(bytesRead < 0)
+                return -1;
+
+            if(bytesRead == 0)
+                break;
+
+            result += bytesRead;
+        }
+
+        return result;
+    }
+}
+
+DeltaCodec::DeltaCodec()
+{
+    hash = "";
+    size = 0;
+    deltaSize = 0;
+}
+
+bool DeltaCodec::encode(QIODevice &base, const QString &sourceFilePath, const QString &deltaFilePath, qint64 sizeLimit)
+{
+    QFile sourceFile(sourceFilePath);
+    bool isSourceOpen = sourceFile.open(QFile::OpenModeFlag::ReadOnly | QFile::OpenModeFlag::Unbuffered);
+
+    if(!isSourceOpen)
+        return false;
+
+    return encode(base, sourceFile, deltaFilePath, sizeLimit);
+}
+
+bool DeltaCodec::encode(QIODevice &base, QIODevice &source, const QString &deltaFilePath, qint64 sizeLimit)
+{
+    hash = "";
+    size = 0;
+    deltaSize = 0;
+
+    qint64 baseSize = base.size();
+    qint64 blockSize = minBlockSize;
+
+    while(baseSize / blockSize > maxBlockCount)
+        blockSize *= 2;
+
+    qint64 readSize = qMax(FileIngestor::chunkSize, blockSize); // Both are powers of 2, so it's a multiple of block size
+    QByteArray buffer(readSize, Qt::Initialization::Uninitialized);
+
+    // Weak checksum of every full block of the base -> its offset
+    QMultiHash<quint32, qint64> signature;
+    signature.reserve(baseSize / blockSize);
+
+    if(!base.seek(0))
+        return false;
+
+    for(qint64 offset = 0; offset + blockSize <= baseSize;)
+    {
+        qint64 length = qMin(readSize, baseSize - offset);
+        length -= length % blockSize;
+
+        if(readFully(base, buffer.data(), length) != length)
+            return false;
+
+        for(qint64 index = 0; index < length; index += blockSize)
+        {
+            quint32 a = 0, b = 0;
+            checksum(buffer.constData() + index, blockSize, a, b);
+            signature.insert((b << 16) | a, offset + index);
+        }
+
+        offset += length;
+    }
+
+    if(!source.seek(0))
+        return false;
+
+    // Buffered, op table is written field by field
+    QFile deltaFile(deltaFilePath);
+    bool isDeltaOpen = deltaFile.open(QFile::OpenModeFlag::WriteOnly | QFile::OpenModeFlag::Truncate);
+
+    if(!isDeltaOpen)
+        return false;
+
+    QCryptographicHash hasher(QCryptographicHash::Algorithm::Sha3_256);
+    QList<Op> opList;
+    qint64 literalSize = 0;
+
+    QByteArray window; // Source bytes not written yet, pending literal comes first
+    qint64 literalBegin = 0;
+    qint64 position = 0;
+    bool isSourceEnd = false;
+    bool isChecksumValid = false;
+    quint32 a = 0, b = 0;
+    QByteArray baseBlock(blockSize, Qt::Initialization::Uninitialized);
+
+    auto flushLiteral = [&]() -> bool
+    {
+        qint64 length = position - literalBegin;
+
+        if(length <= 0)
+            return true;
+
+        if(deltaFile.write(window.constData() + literalBegin, length) != length)
+            return false;
+
+        if(!opList.isEmpty() && opList.last().kind == OpKind::Literal)
+            opList.last().length += length;
+        else
+        {
+            Op op;
+            op.kind = OpKind::Literal;
+            op.length = length;
+            op.sourceOffset = literalSize;
+            opList.append(op);
+        }
+
+        literalSize += length;
+        literalBegin = position;
+
+        bool isOverLimit = sizeLimit >= 0 && literalSize + (opList.size() * opSize) + footerSize > sizeLimit;
+        return !isOverLimit;
+    };
+
+    while(true)
+    {
+        if(window.size() - position < blockSize && !isSourceEnd) // Less than a block left, read more of the source
+        {
+            if(!flushLiteral())
+                return false;
+
+            if(QThread::currentThread()->isInterruptionRequested()) // Background maintenance is stopping
+                return false;
+
+            window.remove(0, position);
+            literalBegin = 0;
+            position = 0;
+
+            qint64 oldSize = window.size();
+            window.resize(oldSize + readSize);
+            qint64 bytesRead = readFully(source, window.data() + oldSize, readSize);
+
+            if(bytesRead < 0)
+                return false;
+
+            window.resize(oldSize + bytesRead);
+            hasher.addData(QByteArrayView(window.constData() + oldSize, bytesRead));
+            size += bytesRead;
+            isSourceEnd = bytesRead == 0;
+
+            continue;
+        }
+
+        if(window.size() - position < blockSize) // Tail shorter than a block is always a literal
+            break;
+
+        const char *data = window.constData();
+
+        if(!isChecksumValid)
+        {
+            checksum(data + position, blockSize, a, b);
+            isChecksumValid = true;
+        }
+
+        quint32 key = (b << 16) | a;
+        qint64 matchOffset = -1;
+
+        // Weak checksums collide, bytes are compared before a block is referenced
+        for(auto candidate = signature.constFind(key); candidate != signature.constEnd() && candidate.key() == key; ++candidate)
+        {
+            if(!base.seek(candidate.value()) || readFully(base, baseBlock.data(), blockSize) != blockSize)
+                return false;
+
+            if(std::memcmp(baseBlock.constData(), data + position, blockSize) == 0)
+            {
+                matchOffset = candidate.value();
+                break;
+            }
+        }
+
+        if(matchOffset >= 0)
+        {
+            if(!flushLiteral())
+                return false;
+
+            if(!opList.isEmpty() && opList.last().kind == OpKind::Copy &&
+               opList.last().sourceOffset + opList.last().length == matchOffset)
+            {
+                opList.last().length += blockSize;
+            }
+            else
+            {
+                Op op;
+                op.kind = OpKind::Copy;
+                op.length = blockSize;
+                op.sourceOffset = matchOffset;
+                opList.append(op);
+            }
+
+            position += blockSize;
+            literalBegin = position;
+            isChecksumValid = false;
+            continue;
+        }
+
+        if(position + blockSize < window.size()) // Roll the checksum one byte forward
+        {
+            quint32 outByte = static_cast<unsigned char>(data[position]);
+            quint32 inByte = static_cast<unsigned char>(data[position + blockSize]);
+
+            a = (a - outByte + inByte) & 0xFFFF;
+            b = (b - static_cast<quint32>(blockSize) * outByte + a) & 0xFFFF;
+        }
+        else
+            isChecksumValid = false;
+
+        ++position;
+    }
+
+    position = window.size();
+
+    if(!flushLiteral())
+        return false;
+
+    QDataStream stream(&deltaFile);
+
+    for(const Op &op : qAsConst(opList))
+        stream << static_cast<quint8>(op.kind) << op.length << op.sourceOffset;
+
+    stream << footerMagic << formatVersion << static_cast<qint64>(size) << literalSize << static_cast<qint64>(opList.size());
+
+    if(stream.status() != QDataStream::Status::Ok)
+        return false;
+
+    deltaSize = deltaFile.size();
+    deltaFile.close();
+
+    if(deltaFile.error() != QFile::FileError::NoError)
+        return false;
+
+    hash = QString(hasher.result().toHex());
+
+    return true;
+}
+
+QString DeltaCodec::getHash() const
+{
+    return hash;
+}
+
+qlonglong DeltaCodec::getSize() const
+{
+    return size;
+}
+
+qlonglong DeltaCodec::getDeltaSize() const
+{
+    return deltaSize;
+}
+
+bool DeltaCodec::readOpList(QIODevice &deltaFile, QList<Op> &opList, qint64 &targetSize)
+{
+    opList.clear();
+    targetSize = 0;
+
+    qint64 fileSize = deltaFile.size();
+
+    if(fileSize < footerSize || !deltaFile.seek(fileSize - footerSize))
+        return false;
+
+    QDataStream stream(&deltaFile);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint64 storedTargetSize = 0;
+    qint64 opTableOffset = 0;
+    qint64 opCount = 0;
+
+    stream >> magic >> version >> storedTargetSize >> opTableOffset >> opCount;
+
+    if(stream.status() != QDataStream::Status::Ok || magic != footerMagic || version != formatVersion)
+        return false;
+
+    if(opTableOffset < 0 || opCount < 0 || opTableOffset + (opCount * opSize) != fileSize - footerSize)
+        return false;
+
+    if(!deltaFile.seek(opTableOffset))
+        return false;
+
+    opList.reserve(opCount);
+    qint64 targetOffset = 0;
+
+    for(qint64 index = 0; index < opCount; ++index)
+    {
+        quint8 kind = 0;
+        Op op;
+
+        stream >> kind >> op.length >> op.sourceOffset;
+
+        op.kind = static_cast<OpKind>(kind);
+        op.targetOffset = targetOffset;
+        targetOffset += op.length;
+
+        opList.append(op);
+    }
+
+    if(stream.status() != QDataStream::Status::Ok || targetOffset != storedTargetSize)
+        return false;
+
+    targetSize = storedTargetSize;
+
+    return true;
+}
+
+void DeltaCodec::checksum(const char *data, qint64 length, quint32 &a, quint32 &b)
+{
+    a = 0;
+    b = 0;
+
+    for(qint64 index = 0; index < length; ++index)
+    {
+        a += static_cast<unsigned char>(data[index]);
+        b += a;
+    }
+
+    a &= 0xFFFF;
+    b &= 0xFFFF;
+}
@@ -0,0 +1,59 @@
+#ifndef DELTACODEC_H
+#define DELTACODEC_H
+
+#include <QList>
+#include <QString>
+#include <QIODevice>
+
+// Encodes a file as copies from a base content plus literal bytes, rsync style.
+// Base is split into fixed blocks, source is scanned with a rolling checksum and matching blocks become copies.
+// Delta file holds the literal bytes first, then the op table and a fixed size footer, so it's written in one pass.
+class DeltaCodec
+{
+public:
+    enum OpKind : quint8
+    {
+        Copy = 0,   // Bytes from the base, sourceOffset is an offset in base content
+        Literal = 1 // Bytes from the delta file, sourceOffset is an offset in delta file
+    };
+
+    struct Op
+    {
+        OpKind kind = OpKind::Literal;
+        qint64 length = 0;
+        qint64 sourceOffset = 0;
+        qint64 targetOffset = 0; // Not stored, calculated while reading
+    };
+
+    static const inline qint64 minBlockSize = 4096;
+    static const inline qint64 maxBlockCount = 262144; // Bounds memory of the base signature
+
+    DeltaCodec();
+
+    // Writes the delta turning base into the source file, source is hashed on the way.
+    // Gives up and returns false once the delta grows past sizeLimit, negative means no limit.
+    bool encode(QIODevice &base, const QString &sourceFilePath, const QString &deltaFilePath, qint64 sizeLimit = -1);
+    bool encode(QIODevice &base, QIODevice &source, const QString &deltaFilePath, qint64 sizeLimit = -1);
+
+    QString getHash() const; // Of the source file
+    qlonglong getSize() const;
+    qlonglong getDeltaSize() const;
+
+    // Reads the op table of a delta file, ops are ordered by target offset
+    static bool readOpList(QIODevice &deltaFile, QList<Op> &opList, qint64 &targetSize);
+
+private:
+    static const inline quint32 footerMagic = 0x4E53444C; // "NSDL"
+    static const inline quint32 formatVersion = 1;
+    static const inline qint64 opSize = 17; // Kind, length and source offset
+    static const inline qint64 footerSize = 32;
+
+    // Rolling checksum of rsync, a is the sum of bytes and b is the sum of a's. Key is (b << 16) | a.
+    static void checksum(const char *data, qint64 length, quint32 &a, quint32 &b);
+
+    QString hash;
+    qlonglong size;
+    qlonglong deltaSize;
+};
+
+#endif // DELTACODEC_H
@@ -0,0 +1,98 @@
+#include "FileIngestor.h"
+
+#include <QFile>
+#include <QByteArray>
+#include <QCryptographicHash>
+
+FileIngestor::FileIngestor()
+{
+    hash = "";
+    size = 0;
+}
+
+bool FileIngestor::hashFile(const QString &pathToFile)
+{
+    return ingest(pathToFile, "");
+}
+
+bool FileIngestor::copyFile(const QString &sourceFilePath, const QString &destinationFilePath)
+{
+    if(destinationFilePath.isEmpty())
+        return false;
+
+    return ingest(sourceFilePath, destinationFilePath);
+}
+
+QString FileIngestor::getHash() const
+{
+    return hash;
+}
+
+qlonglong FileIngestor::getSize() const
+{
+    return size;
+}
+
+bool FileIngestor::ingest(const QString &sourceFilePath, const QString &destinationFilePath)
+{
+    hash = "";
+    size = 0;
+
+    // Unbuffered I/O, chunks go straight from the read call to the hasher and the writer.
+    QFile sourceFile(sourceFilePath);
+    bool isSourceOpen = sourceFile.open(QFile::OpenModeFlag::ReadOnly | QFile::OpenModeFlag::Unbuffered);
+
+    if(!isSourceOpen)
+        return false;
+
+    bool isCopying = !destinationFilePath.isEmpty();
+    QFile destinationFile(destinationFilePath);
+
+    if(isCopying)
+    {
+        bool isDestinationOpen = destinationFile.open(QFile::OpenModeFlag::WriteOnly |
+                                                      QFile::OpenModeFlag::Truncate |
+                                                      QFile::OpenModeFlag::Unbuffered);
+        if(!isDestinationOpen)
+            return false;
+    }
+
+    QCryptographicHash hasher(QCryptographicHash::Algorithm::Sha3_256);
+    QByteArray buffer(chunkSize, Qt::Initialization::Uninitialized);
+    qlonglong totalBytes = 0;
+
+    while(true)
+    {
+        qint64 bytesRead = sourceFile.read(buffer.data(), chunkSize);
+
+        if(bytesRead < 0)
+            return false;
+
+        if(bytesRead == 0)
+            break;
+
+        hasher.addData(QByteArrayView(buffer.constData(), bytesRead));
+
+        if(isCopying)
+        {
+            qint64 bytesWritten = destinationFile.write(buffer.constData(), bytesRead);
+            if(bytesWritten != bytesRead)
+                return false;
+        }
+
+        totalBytes += bytesRead;
+    }
+
+    if(isCopying)
+    {
+        destinationFile.close();
+
+        if(destinationFile.error() != QFile::FileError::NoError)
+            return false;
+    }
+
+    hash = QString(hasher.result().toHex());
+    size = totalBytes;
+
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef FILEINGESTOR_H
+#define FILEINGESTOR_H
+
+#include <QString>
+
+// Reads a file in large chunks and feeds the same buffer to the SHA3-256 hasher and (optionally) to the destination.
+class FileIngestor
+{
+public:
+    static const inline qint64 chunkSize = 4 * 1024 * 1024; // Multiple of the page size
+
+    FileIngestor();
+
+    bool hashFile(const QString &pathToFile);
+    bool copyFile(const QString &sourceFilePath, const QString &destinationFilePath);
+
+    QString getHash() const;
+    qlonglong getSize() const;
+
+private:
+    bool ingest(const QString &sourceFilePath, const QString &destinationFilePath);
+
+    QString hash;
+    qlonglong size;
+};
+
+#endif // FILEINGESTOR_H
@@ -3,15 +3,26 @@
 #include "Utility/AppConfig.h"
 #include "Utility/JsonDtoFormat.h"
 #include "Utility/DatabaseRegistry.h"
+#include "Utility/FileSync.h"
+#include "FileIngestor.h"
+#include "DeltaCodec.h"
+#include "BlobReader.h"
+#include "CompressionCodec.h"
 
 #include <QDir>
+#include <QHash>
 #include <QUuid>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadStorage>
+#include <QSqlQuery>
 #include <QJsonArray>
 #include <QStandardPaths>
-#include <QCryptographicHash>
 
 FileStorageManager::FileStorageManager(const QSqlDatabase &db, const QString &backupFolderPath)
 {
+    packWriter = nullptr;
+    readThrottle = nullptr;
     setStorageFolderPath(backupFolderPath);
     database = db;
 
@@ -21,26 +32,51 @@ FileStorageManager::FileStorageManager(const QSqlDatabase &db, const QString &ba
     folderRepository = new FolderRepository(database);
     fileRepository = new FileRepository(database);
     fileVersionRepository = new FileVersionRepository(database);
+    blobRepository = new BlobRepository(database);
+    chunkRepository = new ChunkRepository(database);
+
+    transactionDepth = 0;
+    isStorageFolderChanged = false;
+    storageFolderPathRevision = -1;
+    isChunkStoreEnabled = false;
 }
 
 QSharedPointer<FileStorageManager> FileStorageManager::instance()
 {
+    // Each thread keeps its own manager, so connection and prepared statements are set up once per thread.
+    static QThreadStorage<QSharedPointer<FileStorageManager>> threadInstance;
+
+    int revision = AppConfig::getStorageFolderPathRevision();
+
+    if(threadInstance.hasLocalData() && threadInstance.localData()->storageFolderPathRevision == revision)
+        return threadInstance.localData();
+
     AppConfig config;
     QSqlDatabase storageDb = DatabaseRegistry::fileStorageDatabase();
 
     auto *rawPtr = new FileStorageManager(storageDb, config.getStorageFolderPath());
+    rawPtr->storageFolderPathRevision = revision;
+    rawPtr->isChunkStoreEnabled = config.isChunkStoreEnabled(); // Settings are read once per manager, not per staged file
     auto result = QSharedPointer<FileStorageManager>(rawPtr);
 
+    threadInstance.setLocalData(result); // Callers still holding the previous manager keep it alive until they're done
+
     return result;
 }
 
 FileStorageManager::~FileStorageManager()
 {
-    database.close();
+    while(transactionDepth > 0) // Unfinished units of work are never committed implicitly
+        rollbackTransaction();
 
     delete folderRepository;
     delete fileRepository;
     delete fileVersionRepository;
+    delete blobRepository;
+    delete chunkRepository;
+    delete packWriter;
+
+    DatabaseRegistry::releaseFileStorageDatabase(database);
 }
 
 bool FileStorageManager::addNewFolder(const QString &symbolFolderPath, const QString &userFolderPath)
@@ -70,6 +106,9 @@ bool FileStorageManager::addNewFolder(const QString &symbolFolderPath, const QSt
 
     if(!entityBySymbolPath.isExist() && !entityByUserPath.isExist())
     {
+        if(!beginTransaction()) // Folders would be written one by one, outside of any unit of work otherwise
+            return false;
+
         QStringList tokenList = _symbolFolderPath.chopped(1).split(separator); // Remove last seperator.
         for(QString &currentToken : tokenList)
             currentToken.append(separator);
@@ -97,10 +136,21 @@ bool FileStorageManager::addNewFolder(const QString &symbolFolderPath, const QSt
                     entity.userFolderPath = _userFolderPath;
 
                 result = folderRepository->save(entity);
+
+                if(!result)
+                {
+                    rollbackTransaction();
+                    return false;
+                }
             }
 
             parentSymbolFolderPath.append(suffixPath);
         }
+
+        if(result)
+            result = commitTransaction();
+        else
+            rollbackTransaction();
     }
 
     return result;
@@ -110,103 +160,325 @@ bool FileStorageManager::addNewFile(const QString &symbolFolderPath,
                                     const QString &pathToFile,
                                     bool isFrozen,
                                     const QString newFileName,
-                                    const QString &description)
+                                    const QString &description,
+                                    IngestStrategy strategy)
 {
-    QString _symbolFolderPath = QDir::fromNativeSeparators(symbolFolderPath);
     QFileInfo info(pathToFile);
 
     if(!info.isFile() || !info.exists())
         return false;
 
-    if(!_symbolFolderPath.startsWith(separator))
-        _symbolFolderPath.prepend(separator);
+    StagedFile stagedFile = stageVersion(pathToFile, strategy);
 
-    if(!_symbolFolderPath.endsWith(separator))
-        _symbolFolderPath.append(separator);
+    bool result = addNewFile(symbolFolderPath, stagedFile, isFrozen, newFileName, description);
+    return result;
+}
 
-    QString _fileName = info.fileName();
-    if(!newFileName.isEmpty())
-        _fileName = newFileName;
+bool FileStorageManager::addNewFile(const QString &symbolFolderPath,
+                                    const StagedFile &stagedFile,
+                                    bool isFrozen,
+                                    const QString &newFileName,
+                                    const QString &description)
+{
+    if(!stagedFile.isStaged)
+        return false;
 
-    FolderEntity folderEntity = folderRepository->findBySymbolPath(_symbolFolderPath);
+    QString fileName = QFileInfo(stagedFile.pathToFile).fileName();
+    if(!newFileName.isEmpty())
+        fileName = newFileName;
 
-    if(!folderEntity.isExist()) // Symbol folder does not exist
+    if(!beginTransaction())
+    {
+        discardStagedFile(stagedFile);
         return false;
+    }
 
-    QString symbolFilePath = folderEntity.symbolFolderPath() + _fileName;
-    FileEntity fileEntity = fileRepository->findBySymbolPath(symbolFilePath);
+    QString symbolFilePath = insertFileEntity(symbolFolderPath, fileName, isFrozen);
 
-    if(fileEntity.isExist()) // Symbol folder is already exist
+    if(symbolFilePath.isEmpty())
+    {
+        rollbackTransaction();
+        discardStagedFile(stagedFile);
         return false;
+    }
 
-    fileEntity.fileName = _fileName;
-    fileEntity.symbolFolderPath = folderEntity.symbolFolderPath();
-    fileEntity.isFrozen = isFrozen;
-
-    bool isFileInserted = fileRepository->save(fileEntity);
+    bool result = appendVersion(symbolFilePath, stagedFile, description);
 
-    if(!isFileInserted)
-        return false;
+    if(result)
+        result = commitTransaction();
+    else
+        rollbackTransaction(); // Don't leave a file without any version
 
-    bool result = appendVersion(symbolFilePath, pathToFile, description);
     return result;
 }
 
-bool FileStorageManager::appendVersion(const QString &symbolFilePath, const QString &pathToFile, const QString &description)
+bool FileStorageManager::appendVersion(const QString &symbolFilePath,
+                                       const QString &pathToFile,
+                                       const QString &description,
+                                       IngestStrategy strategy)
 {
     QFileInfo info(pathToFile);
 
     if(!info.isFile() || !info.exists())
         return false;
 
-    FileEntity fileEntity = fileRepository->findBySymbolPath(symbolFilePath);
+    StagedFile stagedFile = stageVersion(pathToFile, strategy, symbolFilePath);
+
+    bool result = appendVersion(symbolFilePath, stagedFile, description);
+    return result;
+}
 
-    if(!fileEntity.isExist())
+bool FileStorageManager::appendVersion(const QString &symbolFilePath,
+                                       const StagedFile &stagedFile,
+                                       const QString &description)
+{
+    if(!stagedFile.isStaged)
+        return false;
+
+    if(!beginTransaction())
+    {
+        discardStagedFile(stagedFile);
         return false;
+    }
 
-    qlonglong versionNumber = fileVersionRepository->maxVersionNumber(fileEntity.symbolFilePath());
+    FileEntity fileEntity = fileRepository->findBySymbolPath(symbolFilePath);
+    BlobEntity blob;
+    bool result = fileEntity.isExist();
 
-    if(versionNumber <= 0)
-        versionNumber = 1;
+    if(result)
+    {
+        blob = adoptStagedFile(stagedFile);
+        result = !blob.internalFileName.isEmpty();
+    }
+
+    if(result)
+        result = insertVersion(fileEntity.symbolFilePath(), blob, description);
+
+    if(result)
+        result = commitTransaction();
     else
-        versionNumber += 1;
+        rollbackTransaction();
 
-    QFile file(pathToFile);
-    QString internalFileName = generateRandomFileName();
-    QString generatedFilePath = getStorageFolderPath() + internalFileName;
-    bool isCopied = file.copy(generatedFilePath);
+    if(!result)
+        discardStagedFile(stagedFile);
 
-    if(!isCopied)
-        return false;
+    return result;
+}
+
+FileStorageManager::StagedFile FileStorageManager::stageFile(const QString &pathToFile) const
+{
+    StagedFile result;
+    result.pathToFile = pathToFile;
+    result.tempFilePath = getStorageFolderPath() + generateRandomFileName();
+
+    // Small files end up in packs, which hold content as is.
+    // Probe decides up front so content is read once. Giving up half way would mean reading it again to copy it.
+    if(QFileInfo(pathToFile).size() > maxPackedBlobSize && CompressionCodec::isCompressible(pathToFile))
+    {
+        QFile sourceFile(pathToFile);
+        CompressionCodec codec;
 
-    bool isOpen = file.open(QFile::OpenModeFlag::ReadOnly);
+        bool isCompressed = sourceFile.open(QFile::OpenModeFlag::ReadOnly | QFile::OpenModeFlag::Unbuffered) &&
+                            codec.compress(sourceFile, result.tempFilePath, fastCompressionLevel) &&
+                            FileSync::syncFile(result.tempFilePath);
 
-    if(!isOpen)
+        if(isCompressed)
+        {
+            result.isStaged = true;
+            result.hash = codec.getHash();
+            result.size = codec.getSize();
+            result.codec = BlobEntity::Codec::ZlibFast;
+
+            return result;
+        }
+    }
+
+    // Rows pointing to content are committed later, content must not be lost to a power cut by then
+    FileIngestor ingestor;
+    result.isStaged = ingestor.copyFile(pathToFile, result.tempFilePath) && FileSync::syncFile(result.tempFilePath);
+
+    if(result.isStaged)
+    {
+        result.hash = ingestor.getHash();
+        result.size = ingestor.getSize();
+    }
+    else
+        QFile::remove(result.tempFilePath);
+
+    return result;
+}
+
+FileStorageManager::StagedFile FileStorageManager::stageVersion(const QString &pathToFile,
+                                                                IngestStrategy strategy,
+                                                                const QString &symbolFilePath)
+{
+    StagedFile result;
+    result.pathToFile = pathToFile;
+
+    if(strategy == IngestStrategy::HashBeforeCopy)
+    {
+        FileIngestor ingestor;
+        bool isHashed = ingestor.hashFile(pathToFile);
+
+        if(!isHashed)
+            return result;
+
+        // Nothing to copy, reference is added once the staged file is adopted
+        if(blobRepository->findByHash(ingestor.getHash(), ingestor.getSize()).isExist())
+        {
+            result.hash = ingestor.getHash();
+            result.size = ingestor.getSize();
+            result.isStaged = true;
+
+            return result;
+        }
+    }
+
+    // Chunks are shared across all files, deltas only with the previous version.
+    // Small files are always packed, a file of their own costs more than the content itself.
+    if(isChunkStoreEnabled || QFileInfo(pathToFile).size() <= maxPackedBlobSize)
+    {
+        StagedFile chunkedFile = stageChunkedFile(pathToFile);
+
+        if(chunkedFile.isStaged)
+            return chunkedFile;
+    }
+    else if(!symbolFilePath.isEmpty())
+    {
+        FileEntity fileEntity = fileRepository->findBySymbolPath(symbolFilePath);
+        FileVersionEntity latestVersion = fileVersionRepository->findVersion(fileEntity.symbolFilePath(),
+                                                                             fileEntity.getMaxVersionNumber());
+
+        StagedFile deltaFile = stageDeltaFile(pathToFile, latestVersion.internalFileName);
+
+        if(deltaFile.isStaged)
+            return deltaFile;
+    }
+
+    return stageFile(pathToFile);
+}
+
+void FileStorageManager::packStagedFile(StagedFile &stagedFile)
+{
+    bool isPackable = stagedFile.isStaged &&
+                      stagedFile.layout == BlobEntity::Layout::File &&
+                      stagedFile.codec == BlobEntity::Codec::None &&
+                      !stagedFile.tempFilePath.isEmpty() &&
+                      stagedFile.size <= maxPackedBlobSize;
+
+    if(!isPackable)
+        return;
+
+    StagedFile chunkedFile = stageChunkedFile(stagedFile.tempFilePath);
+
+    if(!chunkedFile.isStaged || chunkedFile.hash != stagedFile.hash) // Copy is adopted as is then
+        return;
+
+    QFile::remove(stagedFile.tempFilePath);
+
+    chunkedFile.pathToFile = stagedFile.pathToFile;
+    stagedFile = chunkedFile;
+}
+
+void FileStorageManager::discardStagedFile(const StagedFile &stagedFile)
+{
+    // Appended chunks stay in their pack unreferenced until the pack is compacted
+    if(!stagedFile.tempFilePath.isEmpty())
+        QFile::remove(stagedFile.tempFilePath);
+}
+
+bool FileStorageManager::beginTransaction()
+{
+    bool result = false;
+
+    // Write lock is taken up front. A deferred transaction upgrading from read to write can fail right away with
+    // a busy snapshot once another connection wrote meanwhile, busy timeout only helps before the transaction begins.
+    // Staging happens before, so the lock is held for row writes only.
+    if(transactionDepth == 0)
+        result = QSqlQuery(database).exec("BEGIN IMMEDIATE;");
+    else // Nested units of work are savepoints, so they can be rolled back without dooming the outer one
+        result = QSqlQuery(database).exec(QString("SAVEPOINT sp_%1;").arg(transactionDepth));
+
+    if(result)
+    {
+        blobRemovalMarks.push(pendingBlobRemovals.size());
+        blobAdoptionMarks.push(adoptedBlobFiles.size());
+        ++transactionDepth;
+    }
+
+    return result;
+}
+
+bool FileStorageManager::commitTransaction()
+{
+    if(transactionDepth <= 0)
         return false;
 
-    QCryptographicHash hasher(QCryptographicHash::Algorithm::Sha3_256);
-    hasher.addData(&file);
-    QString fileHash = QString(hasher.result().toHex());
+    --transactionDepth;
+    qsizetype removalMark = blobRemovalMarks.pop();
+    blobAdoptionMarks.pop();
 
-    file.close();
+    if(transactionDepth > 0)
+        return QSqlQuery(database).exec(QString("RELEASE sp_%1;").arg(transactionDepth));
 
-    FileVersionEntity versionEntity;
-    versionEntity.symbolFilePath = fileEntity.symbolFilePath();
-    versionEntity.versionNumber = versionNumber;
-    versionEntity.size = file.size();
-    versionEntity.internalFileName = internalFileName;
-    versionEntity.timestamp = QDateTime::currentDateTime();
-    versionEntity.description = description;
-    versionEntity.hash = fileHash;
+    // Contents are synced while staging, rows must not point to files whose names are lost to a power cut
+    bool isFolderSynced = !isStorageFolderChanged || FileSync::syncFolder(getStorageFolderPath());
+    isStorageFolderChanged = false;
 
-    bool isVersionInserted = fileVersionRepository->save(versionEntity);
+    if(!isFolderSynced)
+    {
+        database.rollback();
+        pendingBlobRemovals.resize(removalMark);
+        removeAdoptedBlobFiles();
+        return false;
+    }
 
-    if(!isVersionInserted)
+    bool result = database.commit();
+
+    if(!result) // Failed commits leave the transaction open
+    {
+        database.rollback();
+        pendingBlobRemovals.resize(removalMark);
+        removeAdoptedBlobFiles();
         return false;
+    }
+
+    adoptedBlobFiles.clear();
+
+    // Blob files are removed only when the rows releasing them are durable.
+    removePendingBlobFiles();
 
     return true;
 }
 
+bool FileStorageManager::rollbackTransaction()
+{
+    if(transactionDepth <= 0)
+        return false;
+
+    --transactionDepth;
+    pendingBlobRemovals.resize(blobRemovalMarks.pop());
+    qsizetype adoptionMark = blobAdoptionMarks.pop();
+
+    if(transactionDepth > 0)
+    {
+        // Outer unit of work may still commit, files adopted by this one go once nothing refers to them
+        pendingBlobRemovals.append(adoptedBlobFiles.mid(adoptionMark));
+        QSqlQuery query(database);
+        bool isRolledBack = query.exec(QString("ROLLBACK TO sp_%1;").arg(transactionDepth));
+        bool isReleased = query.exec(QString("RELEASE sp_%1;").arg(transactionDepth));
+
+        return isRolledBack && isReleased;
+    }
+
+    isStorageFolderChanged = false;
+
+    bool result = database.rollback();
+    removeAdoptedBlobFiles();
+
+    return result;
+}
+
 bool FileStorageManager::deleteFolder(const QString &symbolFolderPath)
 {
     bool result = false;
@@ -214,11 +486,28 @@ bool FileStorageManager::deleteFolder(const QString &symbolFolderPath)
 
     if(entity.isExist())
     {
+        if(!beginTransaction())
+            return false;
+
+        result = true;
+
+        // Cascade would remove versions without releasing their blobs, so every file goes through deleteFile()
         QList<FileEntity> fileList = fileRepository->findAllChildFiles(symbolFolderPath);
         for(const FileEntity &fileEntity : fileList)
-            deleteFile(fileEntity.symbolFilePath());
+        {
+            result = deleteFile(fileEntity.symbolFilePath());
+
+            if(!result)
+                break;
+        }
 
-        result = folderRepository->deleteEntity(entity);
+        if(result)
+            result = folderRepository->deleteEntity(entity);
+
+        if(result)
+            result = commitTransaction();
+        else
+            rollbackTransaction();
     }
 
     return result;
@@ -232,18 +521,22 @@ bool FileStorageManager::deleteFile(const QString &symbolFilePath)
     if(entity.isExist())
     {
         QList<FileVersionEntity> fileVersionList = entity.getVersionList();
-        QStringList internalPathList;
 
-        for(const FileVersionEntity &version : fileVersionList)
-            internalPathList.append(getStorageFolderPath() + version.internalFileName);
+        // Released files would be removed before the rows releasing them are committed otherwise
+        if(!beginTransaction())
+            return false;
 
         result = fileRepository->deleteEntity(entity);
 
         if(result == true)
         {
-            for(const QString &filePath : internalPathList)
-                QFile::remove(filePath);
+            for(const FileVersionEntity &version : fileVersionList)
+                releaseBlob(version.internalFileName);
+
+            result = commitTransaction();
         }
+        else
+            rollbackTransaction();
     }
 
     return result;
@@ -260,17 +553,24 @@ bool FileStorageManager::deleteFileVersion(const QString &symbolFilePath, qlongl
         if(maxVersionNumber <= 1) // Don't delete single version (therefore the entire file)
             return false;
 
+        if(!beginTransaction())
+            return false;
+
         result = fileVersionRepository->deleteEntity(entity);
 
         if(result == true)
         {
-            QString internalFilePath = getStorageFolderPath() + entity.internalFileName;
-            QFile::remove(internalFilePath);
+            releaseBlob(entity.internalFileName);
 
             FileEntity parentEntity = fileRepository->findBySymbolPath(symbolFilePath, true);
 
             result = sortFileVersionEntities(parentEntity);
         }
+
+        if(result)
+            result = commitTransaction();
+        else
+            rollbackTransaction();
     }
 
     return result;
@@ -296,11 +596,23 @@ bool FileStorageManager::updateFolderEntity(QJsonObject folderDto, bool updateFr
     if(!isParentFolderPathString || !isSuffixPathString || !isSymbolFolderPathString || !isUserFolderPathString || !isFrozenBool)
         return false;
 
-    FolderEntity entity = folderRepository->findBySymbolPath(folderDto[JsonKeys::Folder::SymbolFolderPath].toString());
-    entity.parentFolderPath = folderDto[JsonKeys::Folder::ParentFolderPath].toString();
-    entity.suffixPath = folderDto[JsonKeys::Folder::SuffixPath].toString();
-    entity.userFolderPath = folderDto[JsonKeys::Folder::UserFolderPath].toString();
-    entity.isFrozen = folderDto[JsonKeys::Folder::IsFrozen].toBool();
+    FolderDto dto;
+    dto.parentFolderPath = folderDto[JsonKeys::Folder::ParentFolderPath].toString();
+    dto.suffixPath = folderDto[JsonKeys::Folder::SuffixPath].toString();
+    dto.symbolFolderPath = folderDto[JsonKeys::Folder::SymbolFolderPath].toString();
+    dto.userFolderPath = folderDto[JsonKeys::Folder::UserFolderPath].toString();
+    dto.isFrozen = folderDto[JsonKeys::Folder::IsFrozen].toBool();
+
+    return updateFolderEntity(dto, updateFrozenStatusOfChildren);
+}
+
+bool FileStorageManager::updateFolderEntity(const FolderDto &folderDto, bool updateFrozenStatusOfChildren)
+{
+    FolderEntity entity = folderRepository->findBySymbolPath(folderDto.symbolFolderPath);
+    entity.parentFolderPath = folderDto.parentFolderPath;
+    entity.suffixPath = folderDto.suffixPath;
+    entity.userFolderPath = folderDto.userFolderPath;
+    entity.isFrozen = folderDto.isFrozen;
 
     if(!entity.parentFolderPath.startsWith(separator))
         entity.parentFolderPath.prepend(separator);
@@ -311,14 +623,21 @@ bool FileStorageManager::updateFolderEntity(QJsonObject folderDto, bool updateFr
     if(!entity.suffixPath.endsWith(separator))
         entity.suffixPath.append(separator);
 
+    if(!beginTransaction())
+        return false;
+
     bool result = folderRepository->save(entity);
 
     if(result == true && updateFrozenStatusOfChildren == true)
     {
-        result = folderRepository->setIsFrozenOfChildren(entity.getPrimaryKey(),
-                                                         folderDto[JsonKeys::Folder::IsFrozen].toBool());
+        result = folderRepository->setIsFrozenOfChildren(entity.getPrimaryKey(), folderDto.isFrozen);
     }
 
+    if(result)
+        result = commitTransaction();
+    else
+        rollbackTransaction();
+
     return result;
 }
 
@@ -340,10 +659,21 @@ bool FileStorageManager::updateFileEntity(QJsonObject fileDto)
     if(!isFileNameString || !isSymbolFilePathString || !isSymbolFolderPathString || !isFrozenBool)
         return false;
 
-    FileEntity entity = fileRepository->findBySymbolPath(fileDto[JsonKeys::File::SymbolFilePath].toString());
-    entity.fileName = fileDto[JsonKeys::File::FileName].toString();
-    entity.symbolFolderPath = fileDto[JsonKeys::File::SymbolFolderPath].toString();
-    entity.isFrozen = fileDto[JsonKeys::File::IsFrozen].toBool();
+    FileDto dto;
+    dto.fileName = fileDto[JsonKeys::File::FileName].toString();
+    dto.symbolFilePath = fileDto[JsonKeys::File::SymbolFilePath].toString();
+    dto.symbolFolderPath = fileDto[JsonKeys::File::SymbolFolderPath].toString();
+    dto.isFrozen = fileDto[JsonKeys::File::IsFrozen].toBool();
+
+    return updateFileEntity(dto);
+}
+
+bool FileStorageManager::updateFileEntity(const FileDto &fileDto)
+{
+    FileEntity entity = fileRepository->findBySymbolPath(fileDto.symbolFilePath);
+    entity.fileName = fileDto.fileName;
+    entity.symbolFolderPath = fileDto.symbolFolderPath;
+    entity.isFrozen = fileDto.isFrozen;
 
     bool result = fileRepository->save(entity);
 
@@ -381,215 +711,1094 @@ bool FileStorageManager::sortFileVersionsInIncreasingOrder(const QString &symbol
     FileEntity parentEntity = fileRepository->findBySymbolPath(symbolFilePath, true);
 
     if(parentEntity.isExist())
+    {
+        if(!beginTransaction())
+            return false;
+
         result = sortFileVersionEntities(parentEntity);
 
+        if(result)
+            result = commitTransaction();
+        else
+            rollbackTransaction();
+    }
+
     return result;
 }
 
-QJsonObject FileStorageManager::getFolderJsonBySymbolPath(const QString &symbolFolderPath, bool includeChildren) const
+FolderDto FileStorageManager::getFolderBySymbolPath(const QString &symbolFolderPath, bool includeChildren) const
 {
-    QJsonObject result;
-
     FolderEntity entity = folderRepository->findBySymbolPath(symbolFolderPath, includeChildren);
-    result = folderEntityToJsonObject(entity);
-
-    return result;
+    return folderEntityToDto(entity);
 }
 
-QJsonObject FileStorageManager::getFolderJsonByUserPath(const QString &userFolderPath, bool includeChildren) const
+FolderDto FileStorageManager::getFolderByUserPath(const QString &userFolderPath, bool includeChildren) const
 {
     QString symbolPath = folderRepository->findSymbolPathByUserFolderPath(userFolderPath);
-    QJsonObject result = getFolderJsonBySymbolPath(symbolPath, includeChildren);
-    return result;
+    return getFolderBySymbolPath(symbolPath, includeChildren);
 }
 
-QJsonObject FileStorageManager::getFileJsonBySymbolPath(const QString &symbolFilePath, bool includeVersions) const
+FileDto FileStorageManager::getFileBySymbolPath(const QString &symbolFilePath, bool includeVersions) const
 {
-    QJsonObject result;
-
     FileEntity entity = fileRepository->findBySymbolPath(symbolFilePath, includeVersions);
-    result = fileEntityToJsonObject(entity);
-
-    return result;
+    return fileEntityToDto(entity);
 }
 
-QJsonObject FileStorageManager::getFileJsonByUserPath(const QString &userFilePath, bool includeVersions) const
+FileDto FileStorageManager::getFileByUserPath(const QString &userFilePath, bool includeVersions) const
 {
     QFileInfo info(userFilePath);
     QString userFolderPath = QDir::toNativeSeparators(info.absolutePath()) + QDir::separator();
     QString symbolFolderPath = folderRepository->findSymbolPathByUserFolderPath(userFolderPath);
     QString symbolFilePath = symbolFolderPath + info.fileName();
 
-    QJsonObject result = getFileJsonBySymbolPath(symbolFilePath, includeVersions);
-    return result;
+    return getFileBySymbolPath(symbolFilePath, includeVersions);
 }
 
-QJsonObject FileStorageManager::getFileVersionJson(const QString &symbolFilePath, qlonglong versionNumber) const
+FileVersionDto FileStorageManager::getFileVersion(const QString &symbolFilePath, qlonglong versionNumber) const
 {
-    QJsonObject result;
-
     FileVersionEntity entity = fileVersionRepository->findVersion(symbolFilePath, versionNumber);
-    result = fileVersionEntityToJsonObject(entity);
+    return fileVersionEntityToDto(entity);
+}
+
+QList<FolderDto> FileStorageManager::getActiveFolders() const
+{
+    QList<FolderDto> result;
+
+    for(const FolderEntity &entity : folderRepository->findActiveFolders())
+        result.append(folderEntityToDto(entity));
 
     return result;
 }
 
-QJsonArray FileStorageManager::getActiveFolderList() const
+QList<FileDto> FileStorageManager::getActiveFiles() const
 {
-    QJsonArray result;
-
-    QList<FolderEntity> queryResult = folderRepository->findActiveFolders();
+    QList<FileDto> result;
 
-    for(const FolderEntity &entity : queryResult)
-    {
-        QJsonObject folderJson = folderEntityToJsonObject(entity);
-        result.append(folderJson);
-    }
+    for(const FileEntity &entity : fileRepository->findActiveFiles())
+        result.append(fileEntityToDto(entity));
 
     return result;
 }
 
-QJsonArray FileStorageManager::getActiveFileList() const
+QSet<QString> FileStorageManager::getFrozenUserPathsInTree(const QString &userFolderPath) const
 {
-    QJsonArray result;
+    QSet<QString> result;
 
-    QList<FileEntity> queryResult = fileRepository->findActiveFiles();
+    for(const QString &item : folderRepository->findFrozenUserFolderPaths(userFolderPath))
+        result.insert(item);
 
-    for(const FileEntity &entity : queryResult)
-    {
-        QJsonObject folderJson = fileEntityToJsonObject(entity);
-        result.append(folderJson);
-    }
+    for(const QString &item : fileRepository->findFrozenUserFilePaths(userFolderPath))
+        result.insert(item);
 
     return result;
 }
 
-QString FileStorageManager::getStorageFolderPath() const
+QJsonObject FileStorageManager::getFolderJsonBySymbolPath(const QString &symbolFolderPath, bool includeChildren) const
 {
-    return storageFolderPath;
+    return getFolderBySymbolPath(symbolFolderPath, includeChildren).toJson();
 }
 
-void FileStorageManager::setStorageFolderPath(const QString &newStorageFolderPath)
+QJsonObject FileStorageManager::getFolderJsonByUserPath(const QString &userFolderPath, bool includeChildren) const
 {
-    storageFolderPath = QDir::toNativeSeparators(newStorageFolderPath);
+    return getFolderByUserPath(userFolderPath, includeChildren).toJson();
+}
 
-    if(!storageFolderPath.endsWith(QDir::separator()))
-        storageFolderPath.append(QDir::separator());
+QJsonObject FileStorageManager::getFileJsonBySymbolPath(const QString &symbolFilePath, bool includeVersions) const
+{
+    return getFileBySymbolPath(symbolFilePath, includeVersions).toJson();
 }
 
-QString FileStorageManager::generateRandomFileName()
+QJsonObject FileStorageManager::getFileJsonByUserPath(const QString &userFilePath, bool includeVersions) const
 {
-    QString result = QUuid::createUuid().toString(QUuid::StringFormat::Id128) + ".file";
-    return result;
+    return getFileByUserPath(userFilePath, includeVersions).toJson();
 }
 
-QJsonObject FileStorageManager::folderEntityToJsonObject(const FolderEntity &entity) const
+QJsonObject FileStorageManager::getFileVersionJson(const QString &symbolFilePath, qlonglong versionNumber) const
 {
-    QJsonObject result;
+    return getFileVersion(symbolFilePath, versionNumber).toJson();
+}
 
-    result[JsonKeys::IsExist] = entity.isExist();
-    result[JsonKeys::Folder::ParentFolderPath] = entity.parentFolderPath;
-    result[JsonKeys::Folder::SuffixPath] = entity.suffixPath;
-    result[JsonKeys::Folder::SymbolFolderPath] = entity.symbolFolderPath();
-    result[JsonKeys::Folder::IsFrozen] = entity.isFrozen;
+QJsonArray FileStorageManager::getActiveFolderList() const
+{
+    QJsonArray result;
 
-    result[JsonKeys::Folder::UserFolderPath] = QJsonValue(QJsonValue::Type::Null);
-    result[JsonKeys::Folder::ChildFolders] = QJsonValue(QJsonValue::Type::Null);
-    result[JsonKeys::Folder::ChildFiles] = QJsonValue(QJsonValue::Type::Null);
+    for(const FolderDto &folder : getActiveFolders())
+        result.append(folder.toJson());
 
-    if(!entity.isFrozen)
-        result[JsonKeys::Folder::UserFolderPath] = entity.userFolderPath;
+    return result;
+}
 
-    if(!entity.getChildFolders().isEmpty())
-    {
-        QJsonArray jsonArrayChildFolder;
-        for(const FolderEntity &entityChildFolder : entity.getChildFolders())
-        {
-            QJsonObject jsonChildFolder;
+QJsonArray FileStorageManager::getActiveFileList() const
+{
+    QJsonArray result;
 
-            jsonChildFolder[JsonKeys::IsExist] = entityChildFolder.isExist();
-            jsonChildFolder[JsonKeys::Folder::ParentFolderPath] = entityChildFolder.parentFolderPath;
-            jsonChildFolder[JsonKeys::Folder::SuffixPath] = entityChildFolder.suffixPath;
-            jsonChildFolder[JsonKeys::Folder::SymbolFolderPath] = entityChildFolder.symbolFolderPath();
-            jsonChildFolder[JsonKeys::Folder::IsFrozen] = entityChildFolder.isFrozen;
+    for(const FileDto &file : getActiveFiles())
+        result.append(file.toJson());
 
-            jsonChildFolder[JsonKeys::Folder::UserFolderPath] = QJsonValue(QJsonValue::Type::Null);
-            if(!entityChildFolder.isFrozen)
-                jsonChildFolder[JsonKeys::Folder::UserFolderPath] = entityChildFolder.userFolderPath;
+    return result;
+}
 
-            jsonChildFolder[JsonKeys::Folder::ChildFolders] = QJsonValue(QJsonValue::Type::Null);
-            jsonChildFolder[JsonKeys::Folder::ChildFiles] = QJsonValue(QJsonValue::Type::Null);
-            jsonArrayChildFolder.append(jsonChildFolder);
-        }
+QSharedPointer<QIODevice> FileStorageManager::openFileVersion(const QString &symbolFilePath, qlonglong versionNumber) const
+{
+    FileVersionEntity entity = fileVersionRepository->findVersion(symbolFilePath, versionNumber);
 
-        result[JsonKeys::Folder::ChildFolders] = jsonArrayChildFolder;
-    }
+    if(!entity.isExist())
+        return nullptr;
 
-    if(!entity.getChildFiles().isEmpty())
-    {
-        QJsonArray jsonArrayFileList;
+    return openBlob(entity.internalFileName);
+}
 
-        for(const FileEntity &entityFile : entity.getChildFiles())
-        {
-            QJsonObject jsonChildFile;
-            jsonChildFile = fileEntityToJsonObject(entityFile);
-            jsonArrayFileList.append(jsonChildFile);
-        }
+bool FileStorageManager::copyFileVersion(const QString &symbolFilePath, qlonglong versionNumber, const QString &destinationFilePath) const
+{
+    FileVersionEntity entity = fileVersionRepository->findVersion(symbolFilePath, versionNumber);
 
-        result[JsonKeys::Folder::ChildFiles] = jsonArrayFileList;
+    if(!entity.isExist())
+        return false;
+
+    BlobEntity blob = blobRepository->findByInternalFileName(entity.internalFileName);
+
+    // Stored as is, let the file system copy it
+    if(blob.layout == BlobEntity::Layout::File && blob.codec == BlobEntity::Codec::None)
+    {
+        QFile::remove(destinationFilePath);
+        return QFile::copy(getStorageFolderPath() + entity.internalFileName, destinationFilePath);
     }
 
-    return result;
-}
+    QSharedPointer<QIODevice> content = openBlob(entity.internalFileName);
 
-QJsonObject FileStorageManager::fileEntityToJsonObject(const FileEntity &entity) const
-{
-    QJsonObject result;
+    if(content.isNull())
+        return false;
 
-    result[JsonKeys::IsExist] = entity.isExist();
-    result[JsonKeys::File::FileName] = entity.fileName;
-    result[JsonKeys::File::IsFrozen] = entity.isFrozen;
-    result[JsonKeys::File::SymbolFolderPath] = entity.symbolFolderPath;
-    result[JsonKeys::File::SymbolFilePath] = entity.symbolFilePath();
-    result[JsonKeys::File::MaxVersionNumber] = fileVersionRepository->maxVersionNumber(entity.symbolFilePath());
-    result[JsonKeys::File::UserFilePath] = QJsonValue(QJsonValue::Type::Null);
-    result[JsonKeys::File::VersionList] = QJsonValue(QJsonValue::Type::Null);
+    QSaveFile destinationFile(destinationFilePath);
 
-    FolderEntity parentEntity = folderRepository->findBySymbolPath(entity.symbolFolderPath);
+    if(!destinationFile.open(QFile::OpenModeFlag::WriteOnly))
+        return false;
 
-    if(!parentEntity.userFolderPath.isEmpty() && !entity.isFrozen)
-        result[JsonKeys::File::UserFilePath] = parentEntity.userFolderPath + entity.fileName;
+    QByteArray buffer(FileIngestor::chunkSize, Qt::Initialization::Uninitialized);
 
-    if(!entity.getVersionList().isEmpty())
+    while(true)
     {
-        QJsonArray jsonArrayVersionList;
-        for(const FileVersionEntity &entityFileVersion : entity.getVersionList())
+        qint64 bytesRead = content->read(buffer.data(), FileIngestor::chunkSize);
+
+        if(bytesRead < 0)
         {
-            QJsonObject jsonFileVersion;
-            jsonFileVersion = fileVersionEntityToJsonObject(entityFileVersion);
-            jsonArrayVersionList.append(jsonFileVersion);
+            destinationFile.cancelWriting();
+            return false;
         }
 
-        result[JsonKeys::File::VersionList] = jsonArrayVersionList;
+        if(bytesRead == 0)
+            break;
+
+        if(destinationFile.write(buffer.constData(), bytesRead) != bytesRead)
+        {
+            destinationFile.cancelWriting();
+            return false;
+        }
     }
 
-    return result;
+    return destinationFile.commit();
 }
 
-QJsonObject FileStorageManager::fileVersionEntityToJsonObject(const FileVersionEntity &entity) const
+QStringList FileStorageManager::getColdBlobs(const QDateTime &lastUsedBefore) const
 {
-    QJsonObject result;
+    return blobRepository->findColdBlobs(lastUsedBefore);
+}
+
+qlonglong FileStorageManager::compactBlob(const QString &internalFileName)
+{
+    BlobEntity blob = blobRepository->findByInternalFileName(internalFileName);
+
+    // Deltas and chunks are compact already, only full content files are rewritten
+    if(!blob.isExist() || blob.layout != BlobEntity::Layout::File)
+        return 0;
+
+    if(blob.size <= maxPackedBlobSize) // A file of its own costs more than the content itself
+        return packBlob(blob) ? blob.size : -1;
+
+    QString blobFilePath = getStorageFolderPath() + blob.internalFileName;
+
+    // Older content becomes a delta against the newer one, so the latest version stays cheap to read.
+    // Deltas already based on this blob would get longer chains than they record, blob is left as is then.
+    BlobEntity base = blobRepository->findByInternalFileName(fileVersionRepository->findNextVersionBlob(blob.internalFileName));
+
+    bool isDeltaWorthy = base.isExist() &&
+                         base.chainDepth < maxDeltaChainDepth &&
+                         base.size >= minDeltaFileSize &&
+                         blob.size >= minDeltaFileSize &&
+                         blobRepository->countDependentDeltas(blob.internalFileName) == 0;
+
+    bool isCompressionWorthy = blob.codec == BlobEntity::Codec::ZlibFast ||
+                               (blob.codec == BlobEntity::Codec::None && CompressionCodec::isCompressible(blobFilePath));
+
+    if(!isDeltaWorthy && !isCompressionWorthy)
+        return 0;
+
+    // Throttled within the codecs, a single large blob would be read at full disk speed otherwise
+    QSharedPointer<QIODevice> content = throttleReads(openBlob(blob.internalFileName));
+
+    if(content.isNull())
+        return -1;
+
+    BlobEntity newBlob;
+
+    if(isDeltaWorthy)
+    {
+        QSharedPointer<QIODevice> baseContent = throttleReads(openBlob(base.internalFileName));
+        QString deltaFileName = generateRandomFileName(".delta");
+        DeltaCodec codec;
+
+        bool isEncoded = !baseContent.isNull() &&
+                         codec.encode(*baseContent,
+                                      *content,
+                                      getStorageFolderPath() + deltaFileName,
+                                      static_cast<qint64>(blob.size * maxDeltaRatio)) &&
+                         codec.getHash() == blob.hash; // Content not matching its hash is never spread further
+
+        if(isEncoded)
+        {
+            newBlob.internalFileName = deltaFileName;
+            newBlob.layout = BlobEntity::Layout::Delta;
+            newBlob.baseInternalFileName = base.internalFileName;
+            newBlob.chainDepth = base.chainDepth + 1;
+        }
+        else
+            QFile::remove(getStorageFolderPath() + deltaFileName);
+    }
+
+    if(newBlob.internalFileName.isEmpty() && isCompressionWorthy)
+    {
+        qint64 storedSize = QFileInfo(blobFilePath).size();
+        qint64 sizeLimit = storedSize;
+
+        if(blob.codec == BlobEntity::Codec::None)
+            sizeLimit = static_cast<qint64>(storedSize * maxCompressionRatio);
+
+        QString compressedFileName = generateRandomFileName(blobFileExtension(BlobEntity::Codec::ZlibBest));
+        CompressionCodec codec;
+
+        bool isCompressed = codec.compress(*content, getStorageFolderPath() + compressedFileName, bestCompressionLevel, sizeLimit) &&
+                            codec.getHash() == blob.hash;
+
+        if(isCompressed)
+        {
+            newBlob.internalFileName = compressedFileName;
+            newBlob.codec = BlobEntity::Codec::ZlibBest;
+        }
+        else
+            QFile::remove(getStorageFolderPath() + compressedFileName);
+    }
+
+    if(newBlob.internalFileName.isEmpty()) // Nothing smaller, content is read anyway
+        return blob.size;
+
+    // Old file is removed once the unit of work commits, its replacement must be on the disk by then
+    if(!FileSync::syncFile(getStorageFolderPath() + newBlob.internalFileName))
+    {
+        QFile::remove(getStorageFolderPath() + newBlob.internalFileName);
+        return -1;
+    }
+
+    newBlob.hash = blob.hash;
+    newBlob.size = blob.size;
+
+    // Replacement would autocommit row by row otherwise, and the new file is removed below on failure
+    if(!beginTransaction())
+    {
+        QFile::remove(getStorageFolderPath() + newBlob.internalFileName);
+        return -1;
+    }
+
+    bool result = replaceBlob(blob, newBlob);
+
+    if(result)
+        result = commitTransaction();
+    else
+        rollbackTransaction();
+
+    if(!result)
+    {
+        QFile::remove(getStorageFolderPath() + newBlob.internalFileName);
+        return -1;
+    }
+
+    return blob.size;
+}
+
+QStringList FileStorageManager::getSparsePacks() const
+{
+    QStringList result;
+    QStringList smallPacks;
+
+    QDir packFolder(getPackFolderPath());
+    const QFileInfoList packFileList = packFolder.entryInfoList({"*.pack"}, QDir::Filter::Files);
+
+    for(const QFileInfo &packFile : packFileList)
+    {
+        // Open packs may hold chunks whose records are not committed yet
+        if(PackWriter::isPackOpen(packFile.fileName()))
+            continue;
+
+        qlonglong liveSize = chunkRepository->sumChunkSizesInPack(packFile.fileName());
+
+        if(liveSize < 0)
+            continue;
+
+        if(liveSize == 0 || liveSize < packFile.size() * minPackUsage)
+            result.append(packFile.fileName());
+        else if(packFile.size() < minPackFileSize)
+            smallPacks.append(packFile.fileName());
+    }
+
+    // Every writer starts a pack of its own, a single small one is left alone so it isn't rewritten on every run
+    if(smallPacks.size() > 1)
+        result.append(smallPacks);
+
+    return result;
+}
+
+qlonglong FileStorageManager::compactPack(const QString &packFileName)
+{
+    if(PackWriter::isPackOpen(packFileName))
+        return 0;
+
+    QString relativePath = "packs" + QString(QDir::separator()) + packFileName;
+    QFile packFile(getStorageFolderPath() + relativePath);
+
+    // Live chunks are copied first, unit of work only moves their records.
+    // Released ones are left behind, pack is removed once the new locations are durable.
+    QList<ChunkEntity> chunkList = chunkRepository->findChunksInPack(packFileName);
+    bool result = chunkList.isEmpty() || packFile.open(QFile::OpenModeFlag::ReadOnly);
+    qlonglong bytesMoved = 0;
+
+    if(result && !chunkList.isEmpty() && packWriter == nullptr)
+        packWriter = new PackWriter(getPackFolderPath());
+
+    for(ChunkEntity &chunk : chunkList)
+    {
+        if(!result || QThread::currentThread()->isInterruptionRequested())
+        {
+            result = false;
+            break;
+        }
+
+        QByteArray data;
+
+        if(packFile.seek(chunk.packOffset))
+            data = packFile.read(chunk.size);
+
+        if(readThrottle != nullptr)
+            readThrottle->consume(data.size());
+
+        // Chunk not matching its hash is never spread further, pack is left as is then
+        result = data.size() == chunk.size &&
+                 QString(QCryptographicHash::hash(data, QCryptographicHash::Algorithm::Sha3_256).toHex()) == chunk.hash &&
+                 packWriter->append(data.constData(), chunk.size, chunk.packFileName, chunk.packOffset);
+
+        bytesMoved += chunk.size;
+    }
+
+    if(result && packWriter != nullptr)
+        result = packWriter->flush();
+
+    if(!result) // Bytes already copied stay in the new pack unreferenced
+        return -1;
+
+    if(!beginTransaction()) // Save tasks may hold the write lock past the busy timeout, pack is compacted on a later run
+        return -1;
+
+    // Chunks released since they're listed are simply gone, nothing new is ever added to a closed pack
+    for(const ChunkEntity &chunk : qAsConst(chunkList))
+    {
+        result = chunkRepository->updatePackLocation(chunk, packFileName);
+
+        if(!result)
+            break;
+    }
+
+    if(result)
+    {
+        pendingBlobRemovals.append(relativePath);
+        result = commitTransaction();
+    }
+    else
+        rollbackTransaction();
+
+    if(!result)
+        return -1;
+
+    return bytesMoved;
+}
+
+void FileStorageManager::setReadThrottle(ReadThrottle *throttle)
+{
+    readThrottle = throttle;
+}
+
+QString FileStorageManager::getStorageFolderPath() const
+{
+    return storageFolderPath;
+}
+
+void FileStorageManager::setStorageFolderPath(const QString &newStorageFolderPath)
+{
+    storageFolderPath = QDir::toNativeSeparators(newStorageFolderPath);
+
+    if(!storageFolderPath.endsWith(QDir::separator()))
+        storageFolderPath.append(QDir::separator());
 
-    result[JsonKeys::IsExist] = entity.isExist();
-    result[JsonKeys::FileVersion::SymbolFilePath] = entity.symbolFilePath;
-    result[JsonKeys::FileVersion::VersionNumber] = entity.versionNumber;
-    result[JsonKeys::FileVersion::Size] = entity.size;
-    result[JsonKeys::FileVersion::Timestamp] = entity.timestamp.toString(Qt::DateFormat::TextDate);
-    result[JsonKeys::FileVersion::Description] = entity.description;
-    result[JsonKeys::FileVersion::Hash] = entity.hash;
-    result[JsonKeys::FileVersion::InternalFileName] = entity.internalFileName;
+    delete packWriter; // Packs of the old folder are done
+    packWriter = nullptr;
+}
+
+QString FileStorageManager::generateRandomFileName(const QString &extension) const
+{
+    QString result = QUuid::createUuid().toString(QUuid::StringFormat::Id128) + extension;
+    return result;
+}
+
+QString FileStorageManager::insertFileEntity(const QString &symbolFolderPath, const QString &fileName, bool isFrozen)
+{
+    QString _symbolFolderPath = QDir::fromNativeSeparators(symbolFolderPath);
+
+    if(!_symbolFolderPath.startsWith(separator))
+        _symbolFolderPath.prepend(separator);
+
+    if(!_symbolFolderPath.endsWith(separator))
+        _symbolFolderPath.append(separator);
+
+    FolderEntity folderEntity = folderRepository->findBySymbolPath(_symbolFolderPath);
+
+    if(!folderEntity.isExist()) // Symbol folder does not exist
+        return "";
+
+    QString symbolFilePath = folderEntity.symbolFolderPath() + fileName;
+    FileEntity fileEntity = fileRepository->findBySymbolPath(symbolFilePath);
+
+    if(fileEntity.isExist()) // Symbol folder is already exist
+        return "";
+
+    fileEntity.fileName = fileName;
+    fileEntity.symbolFolderPath = folderEntity.symbolFolderPath();
+    fileEntity.isFrozen = isFrozen;
+
+    bool isFileInserted = fileRepository->save(fileEntity);
+
+    if(!isFileInserted)
+        return "";
+
+    return symbolFilePath;
+}
+
+bool FileStorageManager::insertVersion(const QString &symbolFilePath, const BlobEntity &blob, const QString &description)
+{
+    qlonglong versionNumber = fileVersionRepository->maxVersionNumber(symbolFilePath);
+
+    if(versionNumber <= 0)
+        versionNumber = 1;
+    else
+        versionNumber += 1;
+
+    FileVersionEntity versionEntity;
+    versionEntity.symbolFilePath = symbolFilePath;
+    versionEntity.versionNumber = versionNumber;
+    versionEntity.size = blob.size;
+    versionEntity.internalFileName = blob.internalFileName;
+    versionEntity.timestamp = QDateTime::currentDateTime();
+    versionEntity.description = description;
+    versionEntity.hash = blob.hash;
+
+    bool isVersionInserted = fileVersionRepository->save(versionEntity);
+
+    if(!isVersionInserted)
+    {
+        releaseBlob(blob.internalFileName);
+        return false;
+    }
 
-    result[JsonKeys::FileVersion::NewVersionNumber] = QJsonValue(QJsonValue::Type::Null);
+    return true;
+}
+
+FileStorageManager::StagedFile FileStorageManager::stageDeltaFile(const QString &pathToFile, const QString &baseInternalFileName)
+{
+    StagedFile result;
+    result.pathToFile = pathToFile;
+
+    BlobEntity base = blobRepository->findByInternalFileName(baseInternalFileName);
+    qint64 fileSize = QFileInfo(pathToFile).size();
+
+    bool isDeltaWorthy = base.isExist() &&
+                         base.chainDepth < maxDeltaChainDepth &&
+                         base.size >= minDeltaFileSize &&
+                         fileSize >= minDeltaFileSize;
+
+    if(!isDeltaWorthy)
+        return result;
+
+    QSharedPointer<QIODevice> baseContent = openBlob(base.internalFileName);
+
+    if(baseContent.isNull())
+        return result;
+
+    // Random name, deltas of same content against different bases must not collide
+    QString deltaFilePath = getStorageFolderPath() + generateRandomFileName(".delta");
+
+    DeltaCodec codec;
+    bool isEncoded = codec.encode(*baseContent, pathToFile, deltaFilePath, static_cast<qint64>(fileSize * maxDeltaRatio)) &&
+                     FileSync::syncFile(deltaFilePath);
+
+    if(!isEncoded) // Too different from the base, full copy is better
+    {
+        QFile::remove(deltaFilePath);
+        return result;
+    }
+
+    result.tempFilePath = deltaFilePath;
+    result.hash = codec.getHash();
+    result.size = codec.getSize();
+    result.layout = BlobEntity::Layout::Delta;
+    result.baseInternalFileName = base.internalFileName;
+    result.isStaged = true;
+
+    return result;
+}
+
+FileStorageManager::StagedFile FileStorageManager::stageChunkedFile(const QString &pathToFile)
+{
+    StagedFile result;
+    result.pathToFile = pathToFile;
+
+    ContentChunker chunker;
+
+    if(!chunker.open(pathToFile))
+        return result;
+
+    bool isStaged = stageChunks(chunker, result.chunkList) && packWriter->flush();
+
+    if(!isStaged)
+    {
+        result.chunkList.clear();
+        return result;
+    }
+
+    result.hash = chunker.getHash();
+    result.size = chunker.getSize();
+    result.layout = BlobEntity::Layout::Chunked;
+    result.isStaged = true;
+
+    return result;
+}
+
+bool FileStorageManager::stageChunks(ContentChunker &chunker, QList<ChunkEntity> &chunkList)
+{
+    if(packWriter == nullptr)
+        packWriter = new PackWriter(getPackFolderPath());
+
+    QHash<QString, ChunkEntity> stagedChunks; // Content repeating within the file is appended once
+
+    QByteArray chunk;
+    qint64 chunkSize = chunker.nextChunk(chunk);
+
+    for(; chunkSize > 0; chunkSize = chunker.nextChunk(chunk))
+    {
+        QString chunkHash = QString(QCryptographicHash::hash(chunk, QCryptographicHash::Algorithm::Sha3_256).toHex());
+        ChunkEntity chunkEntity = stagedChunks.value(chunkHash);
+
+        if(chunkEntity.hash.isEmpty())
+        {
+            chunkEntity.hash = chunkHash;
+            chunkEntity.size = chunkSize;
+
+            // Stored chunks are only referenced on adoption, so they get no pack location here
+            if(!chunkRepository->findByHash(chunkHash).isExist())
+            {
+                bool isAppended = packWriter->append(chunk.constData(), chunkSize, chunkEntity.packFileName, chunkEntity.packOffset);
+
+                if(!isAppended)
+                    return false;
+            }
+
+            stagedChunks.insert(chunkHash, chunkEntity);
+        }
+
+        chunkList.append(chunkEntity);
+    }
+
+    // Read or write error when not at the end, bytes already appended stay in the pack unreferenced
+    return chunkSize == 0;
+}
+
+BlobEntity FileStorageManager::adoptStagedFile(const StagedFile &stagedFile)
+{
+    BlobEntity blob = blobRepository->findByHash(stagedFile.hash, stagedFile.size);
+
+    if(blob.isExist())
+    {
+        bool isReferenced = blobRepository->addReference(blob.internalFileName);
+
+        if(!isReferenced)
+            return BlobEntity();
+
+        discardStagedFile(stagedFile);
+        return blob;
+    }
+
+    if(stagedFile.layout == BlobEntity::Layout::Chunked)
+    {
+        blob = BlobEntity();
+        blob.internalFileName = generateRandomFileName(".chunks"); // No file of its own, name only keys the chunk list
+        blob.hash = stagedFile.hash;
+        blob.size = stagedFile.size;
+        blob.referenceCount = 1;
+        blob.layout = BlobEntity::Layout::Chunked;
+
+        bool result = blobRepository->insert(blob) && adoptChunkList(blob.internalFileName, stagedFile.chunkList);
+
+        if(!result)
+            return BlobEntity();
+
+        return blob;
+    }
+
+    if(stagedFile.tempFilePath.isEmpty()) // Hashed only, content is released since then
+        return BlobEntity();
+
+    if(stagedFile.layout == BlobEntity::Layout::Delta)
+    {
+        BlobEntity base = blobRepository->findByInternalFileName(stagedFile.baseInternalFileName);
+
+        if(!base.isExist() || base.chainDepth >= maxDeltaChainDepth) // Base might be released or replaced meanwhile
+            return BlobEntity();
+
+        blob = BlobEntity();
+        blob.internalFileName = QFileInfo(stagedFile.tempFilePath).fileName(); // Delta is encoded in place
+        blob.hash = stagedFile.hash;
+        blob.size = stagedFile.size;
+        blob.referenceCount = 1;
+        blob.baseInternalFileName = base.internalFileName;
+        blob.chainDepth = base.chainDepth + 1;
+        blob.layout = BlobEntity::Layout::Delta;
+
+        // Base is kept as long as a delta refers to it
+        bool result = blobRepository->insert(blob) && blobRepository->addReference(base.internalFileName);
+
+        if(!result)
+            return BlobEntity();
+
+        adoptedBlobFiles.append(blob.internalFileName);
+        isStorageFolderChanged = true;
+        return blob;
+    }
+
+    blob = BlobEntity();
+    blob.internalFileName = stagedFile.hash + blobFileExtension(stagedFile.codec);
+    blob.hash = stagedFile.hash;
+    blob.size = stagedFile.size;
+    blob.referenceCount = 1;
+    blob.codec = stagedFile.codec;
+
+    QString blobFilePath = getStorageFolderPath() + blob.internalFileName;
+
+    // Blob files are only created by renaming a fully written temp file, so an existing one is always complete.
+    // It might be released earlier in this unit of work, it's in use again then.
+    if(QFile::exists(blobFilePath))
+    {
+        QFile::remove(stagedFile.tempFilePath);
+        cancelBlobRemoval(blob.internalFileName);
+    }
+    else
+    {
+        bool isRenamed = QFile::rename(stagedFile.tempFilePath, blobFilePath);
+
+        if(!isRenamed)
+        {
+            QFile::remove(stagedFile.tempFilePath);
+
+            if(!QFile::exists(blobFilePath))
+                return BlobEntity();
+        }
+        else
+            adoptedBlobFiles.append(blob.internalFileName); // Renamed by another connection otherwise, it's theirs
+
+        isStorageFolderChanged = true;
+    }
+
+    bool isInserted = blobRepository->insert(blob);
+
+    if(!isInserted) // Same content might be inserted by another connection meanwhile
+    {
+        bool isReferenced = blobRepository->addReference(blob.internalFileName);
+        if(!isReferenced)
+            return BlobEntity();
+    }
+
+    return blob;
+}
+
+bool FileStorageManager::adoptChunkList(const QString &internalFileName, const QList<ChunkEntity> &chunkList)
+{
+    QStringList chunkHashList;
+
+    for(const ChunkEntity &stagedChunk : chunkList)
+    {
+        bool isStored = false;
+
+        if(chunkRepository->findByHash(stagedChunk.hash).isExist())
+            isStored = chunkRepository->addReference(stagedChunk.hash);
+        else if(!stagedChunk.packFileName.isEmpty()) // Chunk released since staging has no bytes of its own
+        {
+            ChunkEntity chunkEntity = stagedChunk;
+            chunkEntity.referenceCount = 1;
+
+            isStored = chunkRepository->insert(chunkEntity);
+        }
+
+        if(!isStored)
+            return false;
+
+        chunkHashList.append(stagedChunk.hash);
+    }
+
+    return chunkRepository->insertChunkList(internalFileName, chunkHashList);
+}
+
+void FileStorageManager::cancelBlobRemoval(const QString &relativePath)
+{
+    qsizetype index = pendingBlobRemovals.indexOf(relativePath);
+
+    for(; index != -1; index = pendingBlobRemovals.indexOf(relativePath, index))
+    {
+        pendingBlobRemovals.removeAt(index);
+
+        // Marks of the open units of work past the entry shift with it
+        for(qsizetype &mark : blobRemovalMarks)
+        {
+            if(mark > index)
+                --mark;
+        }
+    }
+}
+
+void FileStorageManager::removePendingBlobFiles()
+{
+    if(pendingBlobRemovals.isEmpty())
+        return;
+
+    // Connection syncs commits only at checkpoints. A power cut could bring back rows pointing to a removed file otherwise.
+    // Files stay queued until a later commit when the checkpoint doesn't complete.
+    if(!checkpointDatabase())
+        return;
+
+    // Another connection may adopt a released hash named file again. Holding the write lock while checking and
+    // removing keeps it out, and a file is kept when a row refers to it by then.
+    QSqlQuery query(database);
+
+    if(!query.exec("BEGIN IMMEDIATE;")) // Files stay queued rather than risking one in use
+        return;
+
+    QStringList removalList = pendingBlobRemovals;
+    pendingBlobRemovals.clear();
+
+    QString packPrefix = "packs" + QString(QDir::separator());
+
+    for(const QString &relativePath : qAsConst(removalList))
+    {
+        bool isInUse = false;
+
+        if(relativePath.startsWith(packPrefix))
+            isInUse = chunkRepository->countChunksInPack(relativePath.mid(packPrefix.size())) != 0;
+        else
+            isInUse = blobRepository->findByInternalFileName(relativePath).isExist();
+
+        if(!isInUse)
+            QFile::remove(getStorageFolderPath() + relativePath);
+    }
+
+    query.exec("COMMIT;");
+}
+
+void FileStorageManager::removeAdoptedBlobFiles()
+{
+    if(adoptedBlobFiles.isEmpty())
+        return;
+
+    // Same checks as for released files, another connection may have adopted the same hash named file meanwhile
+    pendingBlobRemovals.append(adoptedBlobFiles);
+    adoptedBlobFiles.clear();
+
+    removePendingBlobFiles();
+}
+
+bool FileStorageManager::checkpointDatabase()
+{
+    // Complete checkpoint syncs the log and copies every committed row into the database file, busy is 0 then
+    QSqlQuery query(database);
+
+    bool result = query.exec("PRAGMA wal_checkpoint(FULL);") && query.next() && query.value(0).toInt() == 0;
+    query.finish();
+
+    return result;
+}
+
+QString FileStorageManager::blobFileExtension(BlobEntity::Codec codec)
+{
+    // Each codec gets its own name, so a content addressed file always holds what its name says
+    if(codec == BlobEntity::Codec::ZlibFast)
+        return ".zfast";
+    else if(codec == BlobEntity::Codec::ZlibBest)
+        return ".zbest";
+
+    return ".file";
+}
+
+void FileStorageManager::releaseBlob(const QString &internalFileName)
+{
+    BlobEntity blob = blobRepository->findByInternalFileName(internalFileName); // Base is needed once the row is gone
+
+    blobRepository->removeReference(internalFileName);
+
+    bool isDeleted = blobRepository->deleteIfUnreferenced(internalFileName);
+
+    if(isDeleted && blob.layout == BlobEntity::Layout::Chunked) // Content lives in shared chunks, there is no file to remove
+    {
+        releaseChunkList(internalFileName);
+        return;
+    }
+
+    if(isDeleted && transactionDepth > 0)
+        pendingBlobRemovals.append(internalFileName);
+    else if(isDeleted)
+        QFile::remove(getStorageFolderPath() + internalFileName);
+
+    if(isDeleted && !blob.baseInternalFileName.isEmpty()) // Delta's reference on its base goes with it
+        releaseBlob(blob.baseInternalFileName);
+}
+
+void FileStorageManager::releaseChunkList(const QString &internalFileName)
+{
+    QList<ChunkEntity> chunkList = chunkRepository->findChunkListOfBlob(internalFileName);
+    chunkRepository->deleteChunkList(internalFileName);
+
+    QSet<QString> affectedPacks;
+
+    for(const ChunkEntity &chunk : qAsConst(chunkList))
+    {
+        chunkRepository->removeReference(chunk.hash);
+
+        bool isDeleted = chunkRepository->deleteIfUnreferenced(chunk.hash);
+
+        if(isDeleted)
+            affectedPacks.insert(chunk.packFileName);
+    }
+
+    // Packs are never rewritten here, one is removed only once none of its chunks is left.
+    // Partly released packs are rewritten by compactPack() in the background.
+    for(const QString &packFileName : qAsConst(affectedPacks))
+    {
+        if(PackWriter::isPackOpen(packFileName) || chunkRepository->countChunksInPack(packFileName) != 0)
+            continue;
+
+        QString relativePath = "packs" + QString(QDir::separator()) + packFileName;
+
+        if(transactionDepth > 0)
+            pendingBlobRemovals.append(relativePath);
+        else
+            QFile::remove(getStorageFolderPath() + relativePath);
+    }
+}
+
+bool FileStorageManager::packBlob(const BlobEntity &blob)
+{
+    QSharedPointer<QIODevice> content = throttleReads(openBlob(blob.internalFileName));
+    ContentChunker chunker;
+
+    if(content.isNull() || !chunker.open(content.data()))
+        return false;
+
+    QList<ChunkEntity> chunkList;
+
+    bool isStaged = stageChunks(chunker, chunkList) &&
+                    chunker.getHash() == blob.hash &&
+                    packWriter->flush();
+
+    if(!isStaged)
+        return false;
+
+    BlobEntity newBlob;
+    newBlob.internalFileName = generateRandomFileName(".chunks");
+    newBlob.hash = blob.hash;
+    newBlob.size = blob.size;
+    newBlob.layout = BlobEntity::Layout::Chunked;
+
+    if(!beginTransaction()) // Appended chunks stay in their pack unreferenced until the pack is compacted
+        return false;
+
+    bool result = adoptChunkList(newBlob.internalFileName, chunkList) && replaceBlob(blob, newBlob);
+
+    if(result)
+        result = commitTransaction();
+    else
+        rollbackTransaction();
+
+    return result;
+}
+
+bool FileStorageManager::replaceBlob(const BlobEntity &oldBlob, BlobEntity &newBlob)
+{
+    // New content is written and synced outside of the transaction, blob might be changed or released meanwhile
+    BlobEntity currentBlob = blobRepository->findByInternalFileName(oldBlob.internalFileName);
+
+    if(!currentBlob.isExist() || currentBlob.layout != oldBlob.layout || currentBlob.codec != oldBlob.codec)
+        return false;
+
+    newBlob.referenceCount = currentBlob.referenceCount;
+
+    // Versions and deltas move to the new blob, so reference count moves with them
+    bool result = blobRepository->insert(newBlob) &&
+                  fileVersionRepository->replaceInternalFileName(currentBlob.internalFileName, newBlob.internalFileName) &&
+                  blobRepository->replaceBase(currentBlob.internalFileName, newBlob.internalFileName) &&
+                  blobRepository->deleteEntity(currentBlob);
+
+    if(result && !newBlob.baseInternalFileName.isEmpty())
+        result = blobRepository->addReference(newBlob.baseInternalFileName);
+
+    if(result)
+    {
+        pendingBlobRemovals.append(currentBlob.internalFileName);
+        isStorageFolderChanged = isStorageFolderChanged || newBlob.layout != BlobEntity::Layout::Chunked;
+    }
+
+    return result;
+}
+
+QString FileStorageManager::getPackFolderPath() const
+{
+    return getStorageFolderPath() + "packs" + QDir::separator();
+}
+
+QSharedPointer<QIODevice> FileStorageManager::openBlob(const QString &internalFileName) const
+{
+    QList<BlobReader::Layer> chain;
+    QString currentFileName = internalFileName;
+
+    while(!currentFileName.isEmpty())
+    {
+        if(chain.size() > maxDeltaChainDepth) // Broken chain, never follow it forever
+            return nullptr;
+
+        BlobEntity blob = blobRepository->findByInternalFileName(currentFileName);
+
+        if(!blob.isExist())
+            return nullptr;
+
+        BlobReader::Layer layer;
+
+        if(blob.layout == BlobEntity::Layout::Chunked)
+        {
+            layer.kind = BlobReader::Kind::Chunked;
+
+            const QList<ChunkEntity> chunkList = chunkRepository->findChunkListOfBlob(currentFileName);
+
+            for(const ChunkEntity &chunkEntity : chunkList)
+            {
+                BlobReader::Chunk chunk;
+                chunk.packFilePath = getPackFolderPath() + chunkEntity.packFileName;
+                chunk.offset = chunkEntity.packOffset;
+                chunk.size = chunkEntity.size;
+                layer.chunkList.append(chunk);
+            }
+        }
+        else
+        {
+            if(blob.layout == BlobEntity::Layout::Delta)
+                layer.kind = BlobReader::Kind::Delta;
+            else if(blob.codec != BlobEntity::Codec::None)
+                layer.kind = BlobReader::Kind::Compressed;
+            else
+                layer.kind = BlobReader::Kind::File;
+
+            layer.filePath = getStorageFolderPath() + currentFileName;
+        }
+
+        chain.append(layer);
+
+        currentFileName = blob.baseInternalFileName;
+    }
+
+    auto result = QSharedPointer<BlobReader>::create(chain);
+
+    if(!result->open(QIODevice::OpenModeFlag::ReadOnly))
+        return nullptr;
+
+    return result;
+}
+
+QSharedPointer<QIODevice> FileStorageManager::throttleReads(QSharedPointer<QIODevice> content) const
+{
+    if(content.isNull() || readThrottle == nullptr)
+        return content;
+
+    auto result = QSharedPointer<ThrottledDevice>::create(content, readThrottle);
+
+    if(!result->open(QIODevice::OpenModeFlag::ReadOnly))
+        return nullptr;
+
+    return result;
+}
+
+FolderDto FileStorageManager::folderEntityToDto(const FolderEntity &entity) const
+{
+    FolderDto result;
+
+    result.isExist = entity.isExist();
+    result.parentFolderPath = entity.parentFolderPath;
+    result.suffixPath = entity.suffixPath;
+    result.symbolFolderPath = entity.symbolFolderPath();
+    result.isFrozen = entity.isFrozen;
+
+    if(!entity.isFrozen)
+        result.userFolderPath = entity.userFolderPath;
+
+    for(const FolderEntity &entityChildFolder : entity.getChildFolders())
+        result.childFolders.append(folderEntityToDto(entityChildFolder));
+
+    for(const FileEntity &entityFile : entity.getChildFiles())
+        result.childFiles.append(fileEntityToDto(entityFile));
+
+    return result;
+}
+
+FileDto FileStorageManager::fileEntityToDto(const FileEntity &entity) const
+{
+    FileDto result;
+
+    result.isExist = entity.isExist();
+    result.fileName = entity.fileName;
+    result.isFrozen = entity.isFrozen;
+    result.symbolFolderPath = entity.symbolFolderPath;
+    result.symbolFilePath = entity.symbolFilePath();
+    result.maxVersionNumber = entity.getMaxVersionNumber();
+
+    if(!entity.getParentUserFolderPath().isEmpty() && !entity.isFrozen)
+        result.userFilePath = entity.getParentUserFolderPath() + entity.fileName;
+
+    for(const FileVersionEntity &entityFileVersion : entity.getVersionList())
+        result.versionList.append(fileVersionEntityToDto(entityFileVersion));
+
+    return result;
+}
+
+FileVersionDto FileStorageManager::fileVersionEntityToDto(const FileVersionEntity &entity) const
+{
+    FileVersionDto result;
+
+    result.isExist = entity.isExist();
+    result.symbolFilePath = entity.symbolFilePath;
+    result.versionNumber = entity.versionNumber;
+    result.size = entity.size;
+    result.timestamp = entity.timestamp;
+    result.description = entity.description;
+    result.hash = entity.hash;
+    result.internalFileName = entity.internalFileName;
 
     return result;
 }
@@ -4,8 +4,17 @@
 #include "ORM/Repository/FolderRepository.h"
 #include "ORM/Repository/FileRepository.h"
 #include "ORM/Repository/FileVersionRepository.h"
-
+#include "ORM/Repository/BlobRepository.h"
+#include "ORM/Repository/ChunkRepository.h"
+#include "PackWriter.h"
+#include "ReadThrottle.h"
+#include "ContentChunker.h"
+#include "Utility/DtoTypes.h"
+
+#include <QStack>
+#include <QIODevice>
 #include <QJsonObject>
+#include <QSharedPointer>
 
 class FileStorageManager
 {
@@ -13,6 +22,27 @@ private:
     FileStorageManager(const QSqlDatabase &db, const QString &backupFolderPath);
 
 public:
+    enum IngestStrategy
+    {
+        CopyWhileHashing, // Single read, best for content that is most likely new
+        HashBeforeCopy    // Skips the copy when the content is already stored, best for content that is most likely unchanged
+    };
+
+    // Content written to the storage folder but not yet recorded in the database. Recording it is all the unit of
+    // work does then, so staging is best done before the unit of work begins.
+    struct StagedFile
+    {
+        QString pathToFile;
+        QString tempFilePath; // Empty when content has no file of its own, or is only hashed since it's stored already
+        QString hash;
+        qlonglong size = 0;
+        BlobEntity::Layout layout = BlobEntity::Layout::File;
+        BlobEntity::Codec codec = BlobEntity::Codec::None; // Of the temp file, size and hash are of the content
+        QString baseInternalFileName; // Deltas only
+        QList<ChunkEntity> chunkList; // Chunked only, in content order. Chunks stored already have no pack location.
+        bool isStaged = false;
+    };
+
     static const inline QString separator = "/";
     static QSharedPointer<FileStorageManager> instance();
 
@@ -25,22 +55,62 @@ public:
                     const QString &pathToFile,
                     bool isFrozen = false,
                     const QString newFileName = "",
+                    const QString &description = "",
+                    IngestStrategy strategy = IngestStrategy::CopyWhileHashing);
+
+    bool addNewFile(const QString &symbolFolderPath,
+                    const StagedFile &stagedFile,
+                    bool isFrozen = false,
+                    const QString &newFileName = "",
                     const QString &description = "");
 
     bool appendVersion(const QString &symbolFilePath,
                        const QString &pathToFile,
+                       const QString &description = "",
+                       IngestStrategy strategy = IngestStrategy::CopyWhileHashing);
+
+    bool appendVersion(const QString &symbolFilePath,
+                       const StagedFile &stagedFile,
                        const QString &description = "");
 
+    // Thread safe, does not touch the database. Result is consumed by addNewFile() or appendVersion().
+    StagedFile stageFile(const QString &pathToFile) const;
+
+    // Stages the way path overloads of addNewFile() and appendVersion() store content: as a delta against the latest
+    // version of symbolFilePath, as chunks, or as a copy. Reads the database, written content isn't recorded yet.
+    StagedFile stageVersion(const QString &pathToFile,
+                            IngestStrategy strategy = IngestStrategy::CopyWhileHashing,
+                            const QString &symbolFilePath = "");
+
+    void packStagedFile(StagedFile &stagedFile); // Small copies staged by other threads are moved into packs
+    void discardStagedFile(const StagedFile &stagedFile); // For staged files never consumed
+
+    // Unit of work, everything between begin and commit is written with a single sync. Calls can be nested.
+    bool beginTransaction();
+    bool commitTransaction();
+    bool rollbackTransaction();
+
     bool deleteFolder(const QString &symbolFolderPath);
     bool deleteFile(const QString &symbolFilePath);
     bool deleteFileVersion(const QString &symbolFilePath, qlonglong versionNumber);
 
     bool updateFolderEntity(QJsonObject folderDto, bool updateFrozenStatusOfChildren = false);
+    bool updateFolderEntity(const FolderDto &folderDto, bool updateFrozenStatusOfChildren = false);
     bool updateFileEntity(QJsonObject fileDto);
+    bool updateFileEntity(const FileDto &fileDto);
     bool updateFileVersionEntity(QJsonObject versionDto);
 
     bool sortFileVersionsInIncreasingOrder(const QString &symbolFilePath);
 
+    FolderDto getFolderBySymbolPath(const QString &symbolFolderPath, bool includeChildren = false) const;
+    FolderDto getFolderByUserPath(const QString &userFolderPath, bool includeChildren = false) const;
+    FileDto getFileBySymbolPath(const QString &symbolFilePath, bool includeVersions = false) const;
+    FileDto getFileByUserPath(const QString &userFilePath, bool includeVersions = false) const;
+    FileVersionDto getFileVersion(const QString &symbolFilePath, qlonglong versionNumber) const;
+    QList<FolderDto> getActiveFolders() const;
+    QList<FileDto> getActiveFiles() const;
+    QSet<QString> getFrozenUserPathsInTree(const QString &userFolderPath) const; // Folders and files, two queries per tree
+
     QJsonObject getFolderJsonBySymbolPath(const QString &symbolFolderPath, bool includeChildren = false) const;
     QJsonObject getFolderJsonByUserPath(const QString &userFolderPath, bool includeChildren = false) const;
     QJsonObject getFileJsonBySymbolPath(const QString &symbolFilePath, bool includeVersions = false) const;
@@ -49,14 +119,56 @@ public:
     QJsonArray getActiveFolderList() const;
     QJsonArray getActiveFileList() const;
 
+    // Content of a version however it's stored, opened for reading. Null when version can't be read.
+    QSharedPointer<QIODevice> openFileVersion(const QString &symbolFilePath, qlonglong versionNumber) const;
+
+    // Writes content of a version to the destination, replacing the file if it exists
+    bool copyFileVersion(const QString &symbolFilePath, qlonglong versionNumber, const QString &destinationFilePath) const;
+
+    // Cold blob maintenance, meant for a low priority thread. Each call is a unit of work of its own.
+    QStringList getColdBlobs(const QDateTime &lastUsedBefore) const; // Most recently used first
+    qlonglong compactBlob(const QString &internalFileName); // Content bytes read, -1 on error
+    QStringList getSparsePacks() const; // Packs mostly holding released chunks, or too small to be kept apart
+    qlonglong compactPack(const QString &packFileName); // Live chunks move to a new pack, bytes moved, -1 on error
+    void setReadThrottle(ReadThrottle *throttle); // Compaction reads go through it, not owned. nullptr reads at full speed
+
     QString getStorageFolderPath() const;
     void setStorageFolderPath(const QString &newStorageFolderPath);
 
 private:
-    QString generateRandomFileName();
-    QJsonObject folderEntityToJsonObject(const FolderEntity &entity) const;
-    QJsonObject fileEntityToJsonObject(const FileEntity &entity) const;
-    QJsonObject fileVersionEntityToJsonObject(const FileVersionEntity &entity) const;
+    static const inline qint64 minDeltaFileSize = 1024 * 1024; // Smaller files are cheaper to keep as full copies
+    static const inline int maxDeltaChainDepth = 8; // Keyframe after this many deltas, bounds the work of a read
+    static const inline double maxDeltaRatio = 0.5; // Deltas larger than this part of the file are stored as full copies
+    static const inline int fastCompressionLevel = 1; // New versions, ingest speed matters most
+    static const inline int bestCompressionLevel = 9; // Cold versions, written once and rarely read
+    static const inline double maxCompressionRatio = 0.9; // Cold blobs which don't compress better than this are left as they are
+    static const inline qint64 maxPackedBlobSize = 64 * 1024; // Blobs up to this size are kept in packs, not in files of their own
+    static const inline double minPackUsage = 0.5; // Packs with less live content than this are rewritten
+    static const inline qint64 minPackFileSize = 4 * 1024 * 1024; // Smaller closed packs are merged together
+
+    QString generateRandomFileName(const QString &extension = ".file") const;
+    QString insertFileEntity(const QString &symbolFolderPath, const QString &fileName, bool isFrozen);
+    bool insertVersion(const QString &symbolFilePath, const BlobEntity &blob, const QString &description);
+    StagedFile stageDeltaFile(const QString &pathToFile, const QString &baseInternalFileName);
+    StagedFile stageChunkedFile(const QString &pathToFile);
+    bool stageChunks(ContentChunker &chunker, QList<ChunkEntity> &chunkList); // Appends new chunks to packs
+    BlobEntity adoptStagedFile(const StagedFile &stagedFile); // Within caller's transaction
+    bool adoptChunkList(const QString &internalFileName, const QList<ChunkEntity> &chunkList); // Within caller's transaction
+    void cancelBlobRemoval(const QString &relativePath); // Path relative to storage folder
+    void removePendingBlobFiles(); // Right after the outermost commit, files stay queued until their release is durable
+    void removeAdoptedBlobFiles(); // Right after the outermost rollback
+    bool checkpointDatabase(); // True once every commit of the connection is durable
+    static QString blobFileExtension(BlobEntity::Codec codec);
+    void releaseBlob(const QString &internalFileName);
+    void releaseChunkList(const QString &internalFileName);
+    bool packBlob(const BlobEntity &blob);
+    bool replaceBlob(const BlobEntity &oldBlob, BlobEntity &newBlob); // Within caller's transaction, new content must be synced to the disk already
+    QString getPackFolderPath() const;
+    QSharedPointer<QIODevice> openBlob(const QString &internalFileName) const;
+    QSharedPointer<QIODevice> throttleReads(QSharedPointer<QIODevice> content) const; // Content as is when there is no throttle
+    FolderDto folderEntityToDto(const FolderEntity &entity) const;
+    FileDto fileEntityToDto(const FileEntity &entity) const;
+    FileVersionDto fileVersionEntityToDto(const FileVersionEntity &entity) const;
     bool sortFileVersionEntities(const FileEntity &parentEntity);
 
 private:
@@ -65,6 +177,18 @@ private:
     FolderRepository *folderRepository;
     FileRepository *fileRepository;
     FileVersionRepository *fileVersionRepository;
+    BlobRepository *blobRepository;
+    ChunkRepository *chunkRepository;
+    PackWriter *packWriter; // Created on first chunked blob
+    ReadThrottle *readThrottle;
+    int transactionDepth;
+    bool isStorageFolderChanged; // New blob files in this unit of work, their folder entries are synced before commit
+    int storageFolderPathRevision; // Thread instance is replaced once storage folder path changes
+    bool isChunkStoreEnabled; // As of the time manager was created, tasks run on threads of their own so each one reads it anew
+    QStringList pendingBlobRemovals; // Released files, ones left over from an earlier commit wait for the next one
+    QStack<qsizetype> blobRemovalMarks;
+    QStringList adoptedBlobFiles; // Created by this unit of work, removed again when rows pointing to them are rolled back
+    QStack<qsizetype> blobAdoptionMarks;
 };
 
 #endif // FILESTORAGEMANAGER_H
@@ -0,0 +1,36 @@
+#include "BlobEntity.h"
+
+BlobEntity::BlobEntity()
+{
+    setIsExist(false);
+    setPrimaryKey("");
+
+    internalFileName = "";
+    hash = "";
+    size = 0;
+    referenceCount = 0;
+    layout = Layout::File;
+    codec = Codec::None;
+    baseInternalFileName = "";
+    chainDepth = 0;
+}
+
+bool BlobEntity::isExist() const
+{
+    return _isExist;
+}
+
+QString BlobEntity::getPrimaryKey() const
+{
+    return primaryKey;
+}
+
+void BlobEntity::setPrimaryKey(const QString &newPrimaryKey)
+{
+    primaryKey = newPrimaryKey;
+}
+
+void BlobEntity::setIsExist(bool newIsExist)
+{
+    _isExist = newIsExist;
+}
@@ -0,0 +1,48 @@
+#ifndef BLOBENTITY_H
+#define BLOBENTITY_H
+
+#include <QString>
+
+class BlobEntity
+{
+public:
+    friend class BlobRepository;
+
+    enum Layout
+    {
+        File = 0,   // Whole content in its own file
+        Delta = 1,  // Delta against the base blob in its own file
+        Chunked = 2 // Ordered list of chunks in chunk store, no file of its own
+    };
+
+    enum Codec
+    {
+        None = 0,     // Stored as is
+        ZlibFast = 1, // Block compressed at the fastest level, for new versions
+        ZlibBest = 2  // Block compressed at the smallest level, for cold versions
+    };
+
+    BlobEntity();
+
+    QString internalFileName;
+    QString hash;
+    qlonglong size;
+    qlonglong referenceCount;
+    Layout layout;
+    Codec codec; // Only full content files are compressed
+    QString baseInternalFileName; // Empty when blob holds the full content, delta against this blob otherwise
+    int chainDepth; // Number of deltas to go through until a full content, 0 for full content
+
+    bool isExist() const;
+
+    QString getPrimaryKey() const;
+
+private:
+    void setPrimaryKey(const QString &newPrimaryKey);
+    QString primaryKey;
+
+    void setIsExist(bool newIsExist);
+    bool _isExist;
+};
+
+#endif // BLOBENTITY_H
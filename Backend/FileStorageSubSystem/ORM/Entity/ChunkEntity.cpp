@@ -0,0 +1,33 @@
+#include "ChunkEntity.h"
+
+ChunkEntity::ChunkEntity()
+{
+    setIsExist(false);
+    setPrimaryKey("");
+
+    hash = "";
+    size = 0;
+    packFileName = "";
+    packOffset = 0;
+    referenceCount = 0;
+}
+
+bool ChunkEntity::isExist() const
+{
+    return _isExist;
+}
+
+QString ChunkEntity::getPrimaryKey() const
+{
+    return primaryKey;
+}
+
+void ChunkEntity::setPrimaryKey(const QString &newPrimaryKey)
+{
+    primaryKey = newPrimaryKey;
+}
+
+void ChunkEntity::setIsExist(bool newIsExist)
+{
+    _isExist = newIsExist;
+}
@@ -0,0 +1,31 @@
+#ifndef CHUNKENTITY_H
+#define CHUNKENTITY_H
+
+#include <QString>
+
+class ChunkEntity
+{
+public:
+    friend class ChunkRepository;
+
+    ChunkEntity();
+
+    QString hash;
+    qlonglong size;
+    QString packFileName;
+    qlonglong packOffset;
+    qlonglong referenceCount;
+
+    bool isExist() const;
+
+    QString getPrimaryKey() const;
+
+private:
+    void setPrimaryKey(const QString &newPrimaryKey);
+    QString primaryKey;
+
+    void setIsExist(bool newIsExist);
+    bool _isExist;
+};
+
+#endif // CHUNKENTITY_H
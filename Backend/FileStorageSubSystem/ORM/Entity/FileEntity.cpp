@@ -8,6 +8,8 @@ FileEntity::FileEntity()
     fileName = "";
     symbolFolderPath = "";
     isFrozen = false;
+    maxVersionNumber = 0;
+    parentUserFolderPath = "";
 }
 
 QString FileEntity::symbolFilePath() const
@@ -25,6 +27,16 @@ QList<FileVersionEntity> FileEntity::getVersionList() const
     return versionList;
 }
 
+qlonglong FileEntity::getMaxVersionNumber() const
+{
+    return maxVersionNumber;
+}
+
+QString FileEntity::getParentUserFolderPath() const
+{
+    return parentUserFolderPath;
+}
+
 QString FileEntity::getPrimaryKey() const
 {
     return primaryKey;
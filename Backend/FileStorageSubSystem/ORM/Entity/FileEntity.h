@@ -23,10 +23,16 @@ public:
 
     QList<FileVersionEntity> getVersionList() const;
 
+    // Loaded together with the file, so converting an entity never goes back to the database.
+    qlonglong getMaxVersionNumber() const;
+    QString getParentUserFolderPath() const;
+
     QString getPrimaryKey() const;
 
 private:
     QList<FileVersionEntity> versionList;
+    qlonglong maxVersionNumber;
+    QString parentUserFolderPath;
 
     void setPrimaryKey(const QString &newPrimaryKey);
     QString primaryKey;
@@ -0,0 +1,281 @@
+#include "BlobRepository.h"
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+BlobRepository::BlobRepository(const QSqlDatabase &db) : queryCache(db)
+{
+    database = db;
+
+    if(!database.isOpen())
+        database.open();
+}
+
+BlobRepository::~BlobRepository()
+{
+
+}
+
+QStringList BlobRepository::hotQueryTemplates()
+{
+    QStringList result;
+
+    result << queryFindByHash
+           << queryFindByInternalFileName
+           << queryCountDependentDeltas;
+
+    return result;
+}
+
+BlobEntity BlobRepository::findByHash(const QString &hash, qlonglong size) const
+{
+    BlobEntity result;
+
+    QString queryTemplate = queryFindByHash;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", hash);
+    query.bindValue(":2", size);
+    query.exec();
+
+    if(query.next())
+    {
+        QSqlRecord record = query.record();
+
+        result.setIsExist(true);
+        result.setPrimaryKey(record.value("internal_file_name").toString());
+        result.internalFileName = record.value("internal_file_name").toString();
+        result.hash = record.value("hash").toString();
+        result.size = record.value("size").toLongLong();
+        result.referenceCount = record.value("reference_count").toLongLong();
+        result.layout = static_cast<BlobEntity::Layout>(record.value("layout").toInt());
+        result.codec = static_cast<BlobEntity::Codec>(record.value("codec").toInt());
+        result.baseInternalFileName = record.value("base_internal_file_name").toString();
+        result.chainDepth = record.value("chain_depth").toInt();
+    }
+
+    query.finish();
+
+    return result;
+}
+
+BlobEntity BlobRepository::findByInternalFileName(const QString &internalFileName) const
+{
+    BlobEntity result;
+
+    QString queryTemplate = queryFindByInternalFileName;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", internalFileName);
+    query.exec();
+
+    if(query.next())
+    {
+        QSqlRecord record = query.record();
+
+        result.setIsExist(true);
+        result.setPrimaryKey(record.value("internal_file_name").toString());
+        result.internalFileName = record.value("internal_file_name").toString();
+        result.hash = record.value("hash").toString();
+        result.size = record.value("size").toLongLong();
+        result.referenceCount = record.value("reference_count").toLongLong();
+        result.layout = static_cast<BlobEntity::Layout>(record.value("layout").toInt());
+        result.codec = static_cast<BlobEntity::Codec>(record.value("codec").toInt());
+        result.baseInternalFileName = record.value("base_internal_file_name").toString();
+        result.chainDepth = record.value("chain_depth").toInt();
+    }
+
+    query.finish();
+
+    return result;
+}
+
+QStringList BlobRepository::findColdBlobs(const QDateTime &lastUsedBefore) const
+{
+    QStringList result;
+
+    QString queryTemplate = " SELECT BlobEntity.internal_file_name FROM BlobEntity"
+                            " JOIN (SELECT internal_file_name, MAX(timestamp) AS last_used"
+                            "       FROM FileVersionEntity GROUP BY internal_file_name) AS BlobUsage"
+                            " ON BlobUsage.internal_file_name = BlobEntity.internal_file_name"
+                            " WHERE BlobUsage.last_used < :1 AND BlobEntity.layout = 0"
+                            " ORDER BY BlobUsage.last_used DESC;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", lastUsedBefore);
+    query.exec();
+
+    while(query.next())
+        result.append(query.value(0).toString());
+
+    query.finish();
+
+    return result;
+}
+
+qlonglong BlobRepository::countDependentDeltas(const QString &internalFileName) const
+{
+    qlonglong result = -1;
+
+    QString queryTemplate = queryCountDependentDeltas;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", internalFileName);
+    query.exec();
+
+    if(query.next())
+        result = query.value(0).toLongLong();
+
+    query.finish();
+
+    return result;
+}
+
+bool BlobRepository::insert(BlobEntity &entity, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " INSERT INTO BlobEntity (internal_file_name, hash, size, reference_count,"
+                            "                         base_internal_file_name, chain_depth, layout, codec)"
+                            " VALUES (:1, :2, :3, :4, :5, :6, :7, :8);" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", entity.internalFileName);
+
+    if(entity.hash.isEmpty())
+        query.bindValue(":2", QVariant());
+    else
+        query.bindValue(":2", entity.hash);
+
+    query.bindValue(":3", entity.size);
+    query.bindValue(":4", entity.referenceCount);
+
+    if(entity.baseInternalFileName.isEmpty())
+        query.bindValue(":5", QVariant());
+    else
+        query.bindValue(":5", entity.baseInternalFileName);
+
+    query.bindValue(":6", entity.chainDepth);
+    query.bindValue(":7", entity.layout);
+    query.bindValue(":8", entity.codec);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.lastError().type() == QSqlError::ErrorType::NoError)
+    {
+        result = true;
+        entity.setIsExist(true);
+        entity.setPrimaryKey(entity.internalFileName);
+    }
+
+    return result;
+}
+
+bool BlobRepository::addReference(const QString &internalFileName, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " UPDATE BlobEntity"
+                            " SET reference_count = reference_count + 1"
+                            " WHERE internal_file_name = :1;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", internalFileName);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.numRowsAffected() == 1 && query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
+
+bool BlobRepository::removeReference(const QString &internalFileName, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " UPDATE BlobEntity"
+                            " SET reference_count = reference_count - 1"
+                            " WHERE internal_file_name = :1 AND reference_count >= 1;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", internalFileName);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.numRowsAffected() == 1 && query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
+
+bool BlobRepository::deleteIfUnreferenced(const QString &internalFileName, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " DELETE FROM BlobEntity"
+                            " WHERE internal_file_name = :1 AND reference_count <= 0;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", internalFileName);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    // Only report deletion when this call actually removed the row, so the caller owns the physical file.
+    if(query.numRowsAffected() == 1 && query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
+
+bool BlobRepository::replaceBase(const QString &oldInternalFileName, const QString &newInternalFileName, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " UPDATE BlobEntity"
+                            " SET base_internal_file_name = :1"
+                            " WHERE base_internal_file_name = :2;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", newInternalFileName);
+    query.bindValue(":2", oldInternalFileName);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
+
+bool BlobRepository::deleteEntity(BlobEntity &entity, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = "DELETE FROM BlobEntity WHERE internal_file_name = :1;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", entity.getPrimaryKey());
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.numRowsAffected() == 1 && query.lastError().type() == QSqlError::ErrorType::NoError)
+    {
+        entity.setIsExist(false);
+        result = true;
+    }
+
+    return result;
+}
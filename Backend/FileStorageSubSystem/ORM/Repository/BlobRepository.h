@@ -0,0 +1,45 @@
+#ifndef BLOBREPOSITORY_H
+#define BLOBREPOSITORY_H
+
+#include "Entity/BlobEntity.h"
+
+#include "Utility/QueryCache.h"
+
+#include <QDateTime>
+#include <QSqlError>
+#include <QStringList>
+#include <QSqlDatabase>
+
+class BlobRepository
+{
+public:
+    BlobRepository(const QSqlDatabase &db);
+    ~BlobRepository();
+
+    static QStringList hotQueryTemplates(); // Lookups run per file or per event, must be served by an index
+
+    BlobEntity findByHash(const QString &hash, qlonglong size) const;
+    BlobEntity findByInternalFileName(const QString &internalFileName) const;
+
+    // Full content blobs whose every version is older than lastUsedBefore, most recently used first
+    QStringList findColdBlobs(const QDateTime &lastUsedBefore) const;
+    qlonglong countDependentDeltas(const QString &internalFileName) const;
+    bool insert(BlobEntity &entity, QSqlError *error = nullptr);
+    bool addReference(const QString &internalFileName, QSqlError *error = nullptr);
+    bool removeReference(const QString &internalFileName, QSqlError *error = nullptr);
+    bool deleteIfUnreferenced(const QString &internalFileName, QSqlError *error = nullptr);
+    bool replaceBase(const QString &oldInternalFileName, const QString &newInternalFileName, QSqlError *error = nullptr);
+    bool deleteEntity(BlobEntity &entity, QSqlError *error = nullptr);
+
+private:
+    static const inline QString queryFindByHash = " SELECT * FROM BlobEntity"
+                                                  " WHERE hash = :1 AND size = :2 AND reference_count >= 1"
+                                                  " LIMIT 1;" ;
+    static const inline QString queryFindByInternalFileName = "SELECT * FROM BlobEntity WHERE internal_file_name = :1;" ;
+    static const inline QString queryCountDependentDeltas = "SELECT COUNT(*) FROM BlobEntity WHERE base_internal_file_name = :1;" ;
+
+    QSqlDatabase database;
+    mutable QueryCache queryCache;
+};
+
+#endif // BLOBREPOSITORY_H
@@ -0,0 +1,313 @@
+#include "ChunkRepository.h"
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+ChunkRepository::ChunkRepository(const QSqlDatabase &db) : queryCache(db)
+{
+    database = db;
+
+    if(!database.isOpen())
+        database.open();
+}
+
+ChunkRepository::~ChunkRepository()
+{
+
+}
+
+QStringList ChunkRepository::hotQueryTemplates()
+{
+    QStringList result;
+
+    result << queryFindByHash
+           << queryFindChunkListOfBlob
+           << queryFindChunksInPack
+           << queryCountChunksInPack
+           << querySumChunkSizesInPack;
+
+    return result;
+}
+
+ChunkEntity ChunkRepository::findByHash(const QString &hash) const
+{
+    ChunkEntity result;
+
+    QString queryTemplate = queryFindByHash;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", hash);
+    query.exec();
+
+    if(query.next())
+    {
+        QSqlRecord record = query.record();
+
+        result.setIsExist(true);
+        result.setPrimaryKey(record.value("hash").toString());
+        result.hash = record.value("hash").toString();
+        result.size = record.value("size").toLongLong();
+        result.packFileName = record.value("pack_file_name").toString();
+        result.packOffset = record.value("pack_offset").toLongLong();
+        result.referenceCount = record.value("reference_count").toLongLong();
+    }
+
+    query.finish();
+
+    return result;
+}
+
+QList<ChunkEntity> ChunkRepository::findChunkListOfBlob(const QString &internalFileName) const
+{
+    QList<ChunkEntity> result;
+
+    QString queryTemplate = queryFindChunkListOfBlob;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", internalFileName);
+    query.exec();
+
+    while(query.next())
+    {
+        ChunkEntity entity;
+        QSqlRecord record = query.record();
+
+        entity.setIsExist(true);
+        entity.setPrimaryKey(record.value("hash").toString());
+        entity.hash = record.value("hash").toString();
+        entity.size = record.value("size").toLongLong();
+        entity.packFileName = record.value("pack_file_name").toString();
+        entity.packOffset = record.value("pack_offset").toLongLong();
+        entity.referenceCount = record.value("reference_count").toLongLong();
+
+        result.append(entity);
+    }
+
+    return result;
+}
+
+QList<ChunkEntity> ChunkRepository::findChunksInPack(const QString &packFileName) const
+{
+    QList<ChunkEntity> result;
+
+    QString queryTemplate = queryFindChunksInPack;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", packFileName);
+    query.exec();
+
+    while(query.next())
+    {
+        ChunkEntity entity;
+        QSqlRecord record = query.record();
+
+        entity.setIsExist(true);
+        entity.setPrimaryKey(record.value("hash").toString());
+        entity.hash = record.value("hash").toString();
+        entity.size = record.value("size").toLongLong();
+        entity.packFileName = record.value("pack_file_name").toString();
+        entity.packOffset = record.value("pack_offset").toLongLong();
+        entity.referenceCount = record.value("reference_count").toLongLong();
+
+        result.append(entity);
+    }
+
+    query.finish();
+
+    return result;
+}
+
+qlonglong ChunkRepository::countChunksInPack(const QString &packFileName) const
+{
+    qlonglong result = -1;
+
+    QString queryTemplate = queryCountChunksInPack;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", packFileName);
+    query.exec();
+
+    if(query.next())
+        result = query.value(0).toLongLong();
+
+    query.finish();
+
+    return result;
+}
+
+qlonglong ChunkRepository::sumChunkSizesInPack(const QString &packFileName) const
+{
+    qlonglong result = -1;
+
+    QString queryTemplate = querySumChunkSizesInPack;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", packFileName);
+    query.exec();
+
+    if(query.next())
+        result = query.value(0).toLongLong();
+
+    query.finish();
+
+    return result;
+}
+
+bool ChunkRepository::insert(ChunkEntity &entity, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " INSERT INTO ChunkEntity (hash, size, pack_file_name, pack_offset, reference_count)"
+                            " VALUES (:1, :2, :3, :4, :5);" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", entity.hash);
+    query.bindValue(":2", entity.size);
+    query.bindValue(":3", entity.packFileName);
+    query.bindValue(":4", entity.packOffset);
+    query.bindValue(":5", entity.referenceCount);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.lastError().type() == QSqlError::ErrorType::NoError)
+    {
+        result = true;
+        entity.setIsExist(true);
+        entity.setPrimaryKey(entity.hash);
+    }
+
+    return result;
+}
+
+bool ChunkRepository::addReference(const QString &hash, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " UPDATE ChunkEntity"
+                            " SET reference_count = reference_count + 1"
+                            " WHERE hash = :1;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", hash);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.numRowsAffected() == 1 && query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
+
+bool ChunkRepository::removeReference(const QString &hash, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " UPDATE ChunkEntity"
+                            " SET reference_count = reference_count - 1"
+                            " WHERE hash = :1 AND reference_count >= 1;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", hash);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.numRowsAffected() == 1 && query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
+
+bool ChunkRepository::deleteIfUnreferenced(const QString &hash, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " DELETE FROM ChunkEntity"
+                            " WHERE hash = :1 AND reference_count <= 0;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", hash);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.numRowsAffected() == 1 && query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
+
+bool ChunkRepository::updatePackLocation(const ChunkEntity &entity, const QString &oldPackFileName, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = " UPDATE ChunkEntity"
+                            " SET pack_file_name = :1, pack_offset = :2"
+                            " WHERE hash = :3 AND pack_file_name = :4;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", entity.packFileName);
+    query.bindValue(":2", entity.packOffset);
+    query.bindValue(":3", entity.hash);
+    query.bindValue(":4", oldPackFileName);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
+
+bool ChunkRepository::insertChunkList(const QString &internalFileName, const QStringList &chunkHashList, QSqlError *error)
+{
+    QString queryTemplate = " INSERT INTO BlobChunkEntity (internal_file_name, chunk_number, chunk_hash)"
+                            " VALUES (:1, :2, :3);" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+
+    for(qsizetype index = 0; index < chunkHashList.size(); ++index)
+    {
+        query.bindValue(":1", internalFileName);
+        query.bindValue(":2", index);
+        query.bindValue(":3", chunkHashList.at(index));
+        query.exec();
+
+        if(query.lastError().type() != QSqlError::ErrorType::NoError)
+        {
+            if(error != nullptr)
+                *error = query.lastError();
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ChunkRepository::deleteChunkList(const QString &internalFileName, QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = "DELETE FROM BlobChunkEntity WHERE internal_file_name = :1;" ;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", internalFileName);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
+    return result;
+}
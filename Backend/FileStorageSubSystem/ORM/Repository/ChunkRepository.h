@@ -0,0 +1,50 @@
+#ifndef CHUNKREPOSITORY_H
+#define CHUNKREPOSITORY_H
+
+#include "Entity/ChunkEntity.h"
+
+#include "Utility/QueryCache.h"
+
+#include <QSqlError>
+#include <QStringList>
+#include <QSqlDatabase>
+
+// Chunk index of the chunk store and the ordered chunk lists of chunked blobs
+class ChunkRepository
+{
+public:
+    ChunkRepository(const QSqlDatabase &db);
+    ~ChunkRepository();
+
+    static QStringList hotQueryTemplates(); // Lookups run per file or per event, must be served by an index
+
+    ChunkEntity findByHash(const QString &hash) const;
+    QList<ChunkEntity> findChunkListOfBlob(const QString &internalFileName) const; // In content order
+    QList<ChunkEntity> findChunksInPack(const QString &packFileName) const; // In pack order
+    qlonglong countChunksInPack(const QString &packFileName) const;
+    qlonglong sumChunkSizesInPack(const QString &packFileName) const; // Live bytes of the pack
+    bool insert(ChunkEntity &entity, QSqlError *error = nullptr);
+    bool addReference(const QString &hash, QSqlError *error = nullptr);
+    bool removeReference(const QString &hash, QSqlError *error = nullptr);
+    bool deleteIfUnreferenced(const QString &hash, QSqlError *error = nullptr);
+    bool updatePackLocation(const ChunkEntity &entity, const QString &oldPackFileName, QSqlError *error = nullptr); // Chunk gone is no error
+    bool insertChunkList(const QString &internalFileName, const QStringList &chunkHashList, QSqlError *error = nullptr);
+    bool deleteChunkList(const QString &internalFileName, QSqlError *error = nullptr);
+
+private:
+    static const inline QString queryFindByHash = "SELECT * FROM ChunkEntity WHERE hash = :1;" ;
+    static const inline QString queryFindChunkListOfBlob = " SELECT ChunkEntity.* FROM BlobChunkEntity"
+                                                           " JOIN ChunkEntity ON ChunkEntity.hash = BlobChunkEntity.chunk_hash"
+                                                           " WHERE BlobChunkEntity.internal_file_name = :1"
+                                                           " ORDER BY BlobChunkEntity.chunk_number ASC;" ;
+    static const inline QString queryFindChunksInPack = " SELECT * FROM ChunkEntity"
+                                                        " WHERE pack_file_name = :1"
+                                                        " ORDER BY pack_offset ASC;" ;
+    static const inline QString queryCountChunksInPack = "SELECT COUNT(*) FROM ChunkEntity WHERE pack_file_name = :1;" ;
+    static const inline QString querySumChunkSizesInPack = "SELECT COALESCE(SUM(size), 0) FROM ChunkEntity WHERE pack_file_name = :1;" ;
+
+    QSqlDatabase database;
+    mutable QueryCache queryCache;
+};
+
+#endif // CHUNKREPOSITORY_H
@@ -1,11 +1,11 @@
 #include "FileRepository.h"
 
-#include "FileVersionRepository.h"
+#include "Utility/DatabaseRegistry.h"
 
 #include <QSqlQuery>
 #include <QSqlRecord>
 
-FileRepository::FileRepository(const QSqlDatabase &db)
+FileRepository::FileRepository(const QSqlDatabase &db) : queryCache(db), fileVersionRepository(db)
 {
     database = db;
 
@@ -18,14 +18,25 @@ FileRepository::~FileRepository()
 
 }
 
+QStringList FileRepository::hotQueryTemplates()
+{
+    QStringList result;
+
+    result << queryFindBySymbolPath
+           << queryFindActiveFiles
+           << queryFindAllChildFiles
+           << queryFindFrozenUserFilePaths;
+
+    return result;
+}
+
 FileEntity FileRepository::findBySymbolPath(const QString &symbolFilePath, bool includeVersions) const
 {
     FileEntity result;
 
-    QSqlQuery query(database);
-    QString queryTemplate = "SELECT * FROM FileEntity WHERE symbol_file_path = :1;" ;
+    QString queryTemplate = queryFindBySymbolPath;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", symbolFilePath);
     query.exec();
 
@@ -38,10 +49,14 @@ FileEntity FileRepository::findBySymbolPath(const QString &symbolFilePath, bool
         result.fileName = record.value("file_name").toString();
         result.symbolFolderPath = record.value("symbol_folder_path").toString();
         result.isFrozen = record.value("is_frozen").toBool();
+        result.maxVersionNumber = record.value("max_version_number").toLongLong();
+        result.parentUserFolderPath = record.value("user_folder_path").toString();
     }
 
+    query.finish();
+
     if(result.isExist() && includeVersions)
-        result.versionList = FileVersionRepository(database).findAllVersions(symbolFilePath);
+        result.versionList = fileVersionRepository.findAllVersions(symbolFilePath);
 
     return result;
 }
@@ -50,11 +65,10 @@ QList<FileEntity> FileRepository::findActiveFiles() const
 {
     QList<FileEntity> result;
 
-    QSqlQuery query(database);
-    QString queryTemplate = " SELECT * FROM FileEntity NATURAL JOIN FolderEntity"
-                            " WHERE user_folder_path IS NOT NULL AND is_frozen IS FALSE;" ;
+    // Starts from active folders, which are few compared to files. CROSS JOIN keeps that order.
+    QString queryTemplate = queryFindActiveFiles;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.exec();
 
     while(query.next())
@@ -67,6 +81,8 @@ QList<FileEntity> FileRepository::findActiveFiles() const
         entity.fileName = record.value("file_name").toString();
         entity.symbolFolderPath = record.value("symbol_folder_path").toString();
         entity.isFrozen = record.value("is_frozen").toBool();
+        entity.maxVersionNumber = record.value("max_version_number").toLongLong();
+        entity.parentUserFolderPath = record.value("user_folder_path").toString();
 
         result.append(entity);
     }
@@ -78,12 +94,11 @@ QList<FileEntity> FileRepository::findAllChildFiles(const QString &symbolFolderP
 {
     QList<FileEntity> result;
 
-    QSqlQuery query(database);
-    QString queryTemplate = " SELECT * FROM FileEntity"
-                            " WHERE symbol_file_path LIKE :1;" ;
+    QString queryTemplate = queryFindAllChildFiles;
 
-    query.prepare(queryTemplate);
-    query.bindValue(":1", QString("%1%").arg(symbolFolderPath));
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", symbolFolderPath);
+    query.bindValue(":2", DatabaseRegistry::prefixUpperBound(symbolFolderPath));
     query.exec();
 
     while(query.next())
@@ -96,6 +111,8 @@ QList<FileEntity> FileRepository::findAllChildFiles(const QString &symbolFolderP
         entity.fileName = record.value("file_name").toString();
         entity.symbolFolderPath = record.value("symbol_folder_path").toString();
         entity.isFrozen = record.value("is_frozen").toBool();
+        entity.maxVersionNumber = record.value("max_version_number").toLongLong();
+        entity.parentUserFolderPath = record.value("user_folder_path").toString();
 
         result.append(entity);
     }
@@ -103,12 +120,28 @@ QList<FileEntity> FileRepository::findAllChildFiles(const QString &symbolFolderP
     return result;
 }
 
+QStringList FileRepository::findFrozenUserFilePaths(const QString &userFolderPath) const
+{
+    QStringList result;
+
+    QString queryTemplate = queryFindFrozenUserFilePaths;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", userFolderPath);
+    query.bindValue(":2", DatabaseRegistry::prefixUpperBound(userFolderPath));
+    query.exec();
+
+    while(query.next())
+        result.append(query.value(0).toString() + query.value(1).toString());
+
+    return result;
+}
+
 bool FileRepository::save(FileEntity &entity, QSqlError *error)
 {
     bool result = false;
-    bool isExist = findBySymbolPath(entity.getPrimaryKey()).isExist();
+    bool isExist = entity.isExist(); // Loaded entities keep their old key, so renames are updated in place
 
-    QSqlQuery query(database);
     QString queryTemplate;
 
     if(isExist)
@@ -120,10 +153,12 @@ bool FileRepository::save(FileEntity &entity, QSqlError *error)
     else
     {
         queryTemplate = " INSERT INTO FileEntity (symbol_folder_path, file_name, is_frozen) "
-                        " VALUES (:1, :2, :3);" ;
+                        " VALUES (:1, :2, :3)"
+                        " ON CONFLICT (symbol_folder_path, file_name) DO UPDATE"
+                        " SET is_frozen = excluded.is_frozen;" ;
     }
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
 
     query.bindValue(":1", entity.symbolFolderPath);
     query.bindValue(":2", entity.fileName);
@@ -151,10 +186,9 @@ bool FileRepository::deleteEntity(FileEntity &entity, QSqlError *error)
 {
     bool result = false;
 
-    QSqlQuery query(database);
     QString queryTemplate = "DELETE FROM FileEntity WHERE symbol_file_path = :1;" ;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", entity.getPrimaryKey());
     query.exec();
 
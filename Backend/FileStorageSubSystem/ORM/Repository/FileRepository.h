@@ -2,8 +2,12 @@
 #define FILEREPOSITORY_H
 
 #include "Entity/FileEntity.h"
+#include "FileVersionRepository.h"
+
+#include "Utility/QueryCache.h"
 
 #include <QSqlError>
+#include <QStringList>
 #include <QSqlDatabase>
 
 class FileRepository
@@ -12,14 +16,39 @@ public:
     FileRepository(const QSqlDatabase &db);
     ~FileRepository();
 
+    static QStringList hotQueryTemplates(); // Lookups run per file or per event, must be served by an index
+
     FileEntity findBySymbolPath(const QString &symbolFilePath, bool includeVersions = false) const;
     QList<FileEntity> findActiveFiles() const;
     QList<FileEntity> findAllChildFiles(const QString &symbolFolderPath) const;
+    QStringList findFrozenUserFilePaths(const QString &userFolderPath) const; // Whole tree under the user path
     bool save(FileEntity &entity, QSqlError *error = nullptr);
     bool deleteEntity(FileEntity &entity, QSqlError *error = nullptr);
 
 private:
+    static const inline QString queryFindBySymbolPath = " SELECT FileEntity.*, FolderEntity.user_folder_path,"
+                                                        "        (SELECT MAX(version_number) FROM FileVersionEntity"
+                                                        "         WHERE FileVersionEntity.symbol_file_path = FileEntity.symbol_file_path) AS max_version_number"
+                                                        " FROM FileEntity JOIN FolderEntity ON FolderEntity.symbol_folder_path = FileEntity.symbol_folder_path"
+                                                        " WHERE FileEntity.symbol_file_path = :1;" ;
+    static const inline QString queryFindActiveFiles = " SELECT FileEntity.*, FolderEntity.user_folder_path,"
+                                                       "        (SELECT MAX(version_number) FROM FileVersionEntity"
+                                                       "         WHERE FileVersionEntity.symbol_file_path = FileEntity.symbol_file_path) AS max_version_number"
+                                                       " FROM FolderEntity CROSS JOIN FileEntity"
+                                                       " ON FileEntity.symbol_folder_path = FolderEntity.symbol_folder_path AND FileEntity.is_frozen = FolderEntity.is_frozen"
+                                                       " WHERE FolderEntity.user_folder_path IS NOT NULL AND FolderEntity.is_frozen = 0;" ;
+    static const inline QString queryFindAllChildFiles = " SELECT FileEntity.*, FolderEntity.user_folder_path,"
+                                                         "        (SELECT MAX(version_number) FROM FileVersionEntity"
+                                                         "         WHERE FileVersionEntity.symbol_file_path = FileEntity.symbol_file_path) AS max_version_number"
+                                                         " FROM FileEntity JOIN FolderEntity ON FolderEntity.symbol_folder_path = FileEntity.symbol_folder_path"
+                                                         " WHERE FileEntity.symbol_file_path >= :1 AND FileEntity.symbol_file_path < :2;" ;
+    static const inline QString queryFindFrozenUserFilePaths = " SELECT FolderEntity.user_folder_path, FileEntity.file_name"
+                                                               " FROM FolderEntity CROSS JOIN FileEntity ON FileEntity.symbol_folder_path = FolderEntity.symbol_folder_path"
+                                                               " WHERE FolderEntity.user_folder_path >= :1 AND FolderEntity.user_folder_path < :2 AND FileEntity.is_frozen = 1;" ;
+
     QSqlDatabase database;
+    mutable QueryCache queryCache;
+    FileVersionRepository fileVersionRepository;
 };
 
 #endif // FILEREPOSITORY_H
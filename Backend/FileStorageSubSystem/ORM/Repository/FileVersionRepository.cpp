@@ -3,7 +3,7 @@
 #include <QSqlQuery>
 #include <QSqlRecord>
 
-FileVersionRepository::FileVersionRepository(const QSqlDatabase &db)
+FileVersionRepository::FileVersionRepository(const QSqlDatabase &db) : queryCache(db)
 {
     database = db;
 
@@ -16,14 +16,26 @@ FileVersionRepository::~FileVersionRepository()
 
 }
 
+QStringList FileVersionRepository::hotQueryTemplates()
+{
+    QStringList result;
+
+    result << queryFindVersion
+           << queryFindAllVersions
+           << queryMaxVersionNumber
+           << queryFindNextVersionBlob
+           << queryReplaceInternalFileName;
+
+    return result;
+}
+
 FileVersionEntity FileVersionRepository::findVersion(const QString &symbolFilePath, qlonglong versionNumber) const
 {
     FileVersionEntity result;
 
-    QSqlQuery query(database);
-    QString queryTemplate = "SELECT * FROM FileVersionEntity WHERE symbol_file_path = :1 AND version_number = :2;" ;
+    QString queryTemplate = queryFindVersion;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", symbolFilePath);
     query.bindValue(":2", versionNumber);
     query.exec();
@@ -44,6 +56,8 @@ FileVersionEntity FileVersionRepository::findVersion(const QString &symbolFilePa
         result.hash = record.value("hash").toString();
     }
 
+    query.finish();
+
     return result;
 }
 
@@ -51,11 +65,9 @@ QList<FileVersionEntity> FileVersionRepository::findAllVersions(const QString &s
 {
     QList<FileVersionEntity> result;
 
-    QSqlQuery query(database);
-    QString queryTemplate = " SELECT * FROM FileVersionEntity WHERE symbol_file_path = :1"
-                            " ORDER BY version_number ASC;" ;
+    QString queryTemplate = queryFindAllVersions;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", symbolFilePath);
     query.exec();
 
@@ -84,14 +96,9 @@ qlonglong FileVersionRepository::maxVersionNumber(const QString &symbolFilePath)
     qlonglong result = -1;
 
     QString resultColumnName = "result_column";
-    QSqlQuery query(database);
-    QString queryTemplate = " SELECT MAX(version_number) AS %1"
-                            " FROM FileVersionEntity"
-                            " WHERE symbol_file_path = :1;" ;
+    QString queryTemplate = queryMaxVersionNumber; // Selects resultColumnName
 
-    queryTemplate = queryTemplate.arg(resultColumnName);
-
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", symbolFilePath);
     query.exec();
 
@@ -101,16 +108,57 @@ qlonglong FileVersionRepository::maxVersionNumber(const QString &symbolFilePath)
         result = record.value(resultColumnName).toLongLong();
     }
 
+    query.finish();
+
+    return result;
+}
+
+QString FileVersionRepository::findNextVersionBlob(const QString &internalFileName) const
+{
+    QString result = "";
+
+    QString queryTemplate = queryFindNextVersionBlob;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", internalFileName);
+    query.bindValue(":2", internalFileName);
+    query.exec();
+
+    if(query.next())
+        result = query.value(0).toString();
+
+    query.finish();
+
+    return result;
+}
+
+bool FileVersionRepository::replaceInternalFileName(const QString &oldInternalFileName,
+                                                    const QString &newInternalFileName,
+                                                    QSqlError *error)
+{
+    bool result = false;
+
+    QString queryTemplate = queryReplaceInternalFileName;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", newInternalFileName);
+    query.bindValue(":2", oldInternalFileName);
+    query.exec();
+
+    if(error != nullptr)
+        *error = query.lastError();
+
+    if(query.lastError().type() == QSqlError::ErrorType::NoError)
+        result = true;
+
     return result;
 }
 
 bool FileVersionRepository::save(FileVersionEntity &entity, QSqlError *error)
 {
     bool result = false;
-    bool isExist = findVersion(entity.getPrimaryKey().first,
-                               entity.getPrimaryKey().second).isExist();
+    bool isExist = entity.isExist(); // Loaded entities keep their old key, so renumbering is updated in place
 
-    QSqlQuery query(database);
     QString queryTemplate;
 
     if(isExist)
@@ -125,7 +173,7 @@ bool FileVersionRepository::save(FileVersionEntity &entity, QSqlError *error)
                         "     hash = :7 "
                         " WHERE symbol_file_path = :8 AND version_number = :9;" ;
     }
-    else
+    else // No upsert here, silently overwriting a version would leak its blob reference
     {
         queryTemplate = " INSERT INTO FileVersionEntity (symbol_file_path, "
                         "                                version_number,"
@@ -137,7 +185,7 @@ bool FileVersionRepository::save(FileVersionEntity &entity, QSqlError *error)
                         " VALUES (:1, :2, :3, :4, :5, :6, :7);" ;
     }
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
 
     query.bindValue(":1", entity.symbolFilePath);
     query.bindValue(":2", entity.versionNumber);
@@ -184,11 +232,10 @@ bool FileVersionRepository::deleteEntity(FileVersionEntity &entity, QSqlError *e
 {
     bool result = false;
 
-    QSqlQuery query(database);
     QString queryTemplate = " DELETE FROM FileVersionEntity"
                             " WHERE symbol_file_path = :1 AND version_number = :2;" ;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", entity.getPrimaryKey().first);
     query.bindValue(":2", entity.getPrimaryKey().second);
     query.exec();
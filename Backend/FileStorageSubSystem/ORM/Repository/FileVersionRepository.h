@@ -3,7 +3,10 @@
 
 #include "Entity/FileVersionEntity.h"
 
+#include "Utility/QueryCache.h"
+
 #include <QSqlError>
+#include <QStringList>
 #include <QSqlDatabase>
 
 class FileVersionRepository
@@ -12,14 +15,35 @@ public:
     FileVersionRepository(const QSqlDatabase &db);
     ~FileVersionRepository();
 
+    static QStringList hotQueryTemplates(); // Lookups run per file or per event, must be served by an index
+
     FileVersionEntity findVersion(const QString &symbolFilePath, qlonglong versionNumber) const;
     QList<FileVersionEntity> findAllVersions(const QString &symbolFilePath) const;
     qlonglong maxVersionNumber(const QString &symbolFilePath) const;
+    QString findNextVersionBlob(const QString &internalFileName) const; // Blob of a version following one stored in the given blob
+    bool replaceInternalFileName(const QString &oldInternalFileName, const QString &newInternalFileName, QSqlError *error = nullptr);
     bool save(FileVersionEntity &entity, QSqlError *error = nullptr);
     bool deleteEntity(FileVersionEntity &entity, QSqlError *error = nullptr);
 
 private:
+    static const inline QString queryFindVersion = "SELECT * FROM FileVersionEntity WHERE symbol_file_path = :1 AND version_number = :2;" ;
+    static const inline QString queryFindAllVersions = " SELECT * FROM FileVersionEntity WHERE symbol_file_path = :1"
+                                                       " ORDER BY version_number ASC;" ;
+    static const inline QString queryMaxVersionNumber = " SELECT MAX(version_number) AS result_column"
+                                                        " FROM FileVersionEntity"
+                                                        " WHERE symbol_file_path = :1;" ;
+    static const inline QString queryFindNextVersionBlob = " SELECT NextVersion.internal_file_name FROM FileVersionEntity AS Version"
+                                                           " JOIN FileVersionEntity AS NextVersion"
+                                                           " ON NextVersion.symbol_file_path = Version.symbol_file_path"
+                                                           " AND NextVersion.version_number = Version.version_number + 1"
+                                                           " WHERE Version.internal_file_name = :1 AND NextVersion.internal_file_name != :2"
+                                                           " LIMIT 1;" ;
+    static const inline QString queryReplaceInternalFileName = " UPDATE FileVersionEntity"
+                                                               " SET internal_file_name = :1"
+                                                               " WHERE internal_file_name = :2;" ;
+
     QSqlDatabase database;
+    mutable QueryCache queryCache;
 };
 
 #endif // FILEVERSIONREPOSITORY_H
@@ -1,9 +1,11 @@
 #include "FolderRepository.h"
 
+#include "Utility/DatabaseRegistry.h"
+
 #include <QSqlQuery>
 #include <QSqlRecord>
 
-FolderRepository::FolderRepository(const QSqlDatabase &db)
+FolderRepository::FolderRepository(const QSqlDatabase &db) : queryCache(db)
 {
     database = db;
 
@@ -16,14 +18,29 @@ FolderRepository::~FolderRepository()
 
 }
 
+QStringList FolderRepository::hotQueryTemplates()
+{
+    QStringList result;
+
+    result << queryFindBySymbolPath
+           << queryFindChildFolders
+           << queryFindChildFiles
+           << queryFindByUserFolderPath
+           << queryFindFrozenUserFolderPaths
+           << queryFindActiveFolders
+           << querySetIsFrozenOfChildFiles
+           << querySetIsFrozenOfChildFolders;
+
+    return result;
+}
+
 FolderEntity FolderRepository::findBySymbolPath(const QString &symbolFolderPath, bool includeChildren) const
 {
     FolderEntity result;
 
-    QSqlQuery query(database);
-    QString queryTemplate = "SELECT * FROM FolderEntity WHERE symbol_folder_path = :1;" ;
+    QString queryTemplate = queryFindBySymbolPath;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", symbolFolderPath);
     query.exec();
 
@@ -40,10 +57,9 @@ FolderEntity FolderRepository::findBySymbolPath(const QString &symbolFolderPath,
 
         if(result.isExist() && includeChildren)
         {
-            QSqlQuery childFolderQuery(database);
-            QString childFolderQueryTemplate = "SELECT * FROM FolderEntity WHERE parent_folder_path = :1;" ;
+            QString childFolderQueryTemplate = queryFindChildFolders;
 
-            childFolderQuery.prepare(childFolderQueryTemplate);
+            QSqlQuery &childFolderQuery = queryCache.prepare(childFolderQueryTemplate);
             childFolderQuery.bindValue(":1", result.symbolFolderPath());
             childFolderQuery.exec();
 
@@ -61,10 +77,9 @@ FolderEntity FolderRepository::findBySymbolPath(const QString &symbolFolderPath,
                 result.childFolders.append(childFolder);
             }
 
-            QSqlQuery childFileQuery(database);
-            QString childFileQueryTemplate = "SELECT * FROM FileEntity WHERE symbol_folder_path = :1;" ;
+            QString childFileQueryTemplate = queryFindChildFiles;
 
-            childFileQuery.prepare(childFileQueryTemplate);
+            QSqlQuery &childFileQuery = queryCache.prepare(childFileQueryTemplate);
             childFileQuery.bindValue(":1", result.symbolFolderPath());
             childFileQuery.exec();
 
@@ -77,22 +92,25 @@ FolderEntity FolderRepository::findBySymbolPath(const QString &symbolFolderPath,
                 childFile.fileName = record.value("file_name").toString();
                 childFile.symbolFolderPath = record.value("symbol_folder_path").toString();
                 childFile.isFrozen = record.value("is_frozen").toBool();
+                childFile.maxVersionNumber = record.value("max_version_number").toLongLong();
+                childFile.parentUserFolderPath = record.value("user_folder_path").toString();
 
                 result.childFiles.append(childFile);
             }
         }
     }
 
+    query.finish();
+
     return result;
 }
 
 QString FolderRepository::findSymbolPathByUserFolderPath(const QString &userFolderPath) const
 {
     QString result = "";
-    QSqlQuery query(database);
-    QString queryTemplate = "SELECT * FROM FolderEntity WHERE user_folder_path = :1;" ;
+    QString queryTemplate = queryFindByUserFolderPath;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", userFolderPath);
     query.exec();
 
@@ -102,6 +120,25 @@ QString FolderRepository::findSymbolPathByUserFolderPath(const QString &userFold
         result = record.value("symbol_folder_path").toString();
     }
 
+    query.finish();
+
+    return result;
+}
+
+QStringList FolderRepository::findFrozenUserFolderPaths(const QString &userFolderPath) const
+{
+    QStringList result;
+
+    QString queryTemplate = queryFindFrozenUserFolderPaths;
+
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
+    query.bindValue(":1", userFolderPath);
+    query.bindValue(":2", DatabaseRegistry::prefixUpperBound(userFolderPath));
+    query.exec();
+
+    while(query.next())
+        result.append(query.value(0).toString());
+
     return result;
 }
 
@@ -109,11 +146,9 @@ QList<FolderEntity> FolderRepository::findActiveFolders() const
 {
     QList<FolderEntity> result;
 
-    QSqlQuery query(database);
-    QString queryTemplate = " SELECT * FROM FolderEntity"
-                            " WHERE user_folder_path IS NOT NULL AND is_frozen IS FALSE;" ;
+    QString queryTemplate = queryFindActiveFolders;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.exec();
 
     while(query.next())
@@ -137,8 +172,7 @@ QList<FolderEntity> FolderRepository::findActiveFolders() const
 bool FolderRepository::save(FolderEntity &entity, QSqlError *error)
 {
     bool result = false;
-    bool isExist = findBySymbolPath(entity.getPrimaryKey()).isExist();
-    QSqlQuery query(database);
+    bool isExist = entity.isExist(); // Loaded entities keep their old key, so renames are updated in place
     QString queryTemplate;
 
     if(isExist)
@@ -150,10 +184,12 @@ bool FolderRepository::save(FolderEntity &entity, QSqlError *error)
     else
     {
         queryTemplate = " INSERT INTO FolderEntity (parent_folder_path, suffix_path, user_folder_path, is_frozen)"
-                        " VALUES(:1, :2, :3, :4);" ;
+                        " VALUES(:1, :2, :3, :4)"
+                        " ON CONFLICT (parent_folder_path, suffix_path) DO UPDATE"
+                        " SET user_folder_path = excluded.user_folder_path, is_frozen = excluded.is_frozen;" ;
     }
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
 
     if(entity.parentFolderPath.isEmpty())
         query.bindValue(":1", QVariant());
@@ -191,10 +227,9 @@ bool FolderRepository::deleteEntity(FolderEntity &entity, QSqlError *error)
 {
     bool result = false;
 
-    QSqlQuery query(database);
     QString queryTemplate = "DELETE FROM FolderEntity WHERE symbol_folder_path = :1;" ;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", entity.getPrimaryKey());
     query.exec();
 
@@ -214,14 +249,13 @@ bool FolderRepository::setIsFrozenOfChildren(const QString &symbolFolderPath, bo
 {
     bool result = false;
 
-    QSqlQuery query(database);
-    QString queryTemplate = " UPDATE FileEntity"
-                            " SET is_frozen = :1"
-                            " WHERE symbol_folder_path LIKE :2;" ;
+    QString upperBound = DatabaseRegistry::prefixUpperBound(symbolFolderPath); // Range instead of LIKE, so the index is used
+    QString queryTemplate = querySetIsFrozenOfChildFiles;
 
-    query.prepare(queryTemplate);
+    QSqlQuery &query = queryCache.prepare(queryTemplate);
     query.bindValue(":1", isFrozen);
-    query.bindValue(":2", QString("%1%").arg(symbolFolderPath));
+    query.bindValue(":2", symbolFolderPath);
+    query.bindValue(":3", upperBound);
     query.exec();
 
 
@@ -231,19 +265,18 @@ bool FolderRepository::setIsFrozenOfChildren(const QString &symbolFolderPath, bo
     if(query.lastError().type() != QSqlError::ErrorType::NoError)
         return false;
 
-    queryTemplate = " UPDATE FolderEntity"
-                    " SET is_frozen = :1"
-                    " WHERE parent_folder_path LIKE :2;" ;
+    queryTemplate = querySetIsFrozenOfChildFolders;
 
-    query.prepare(queryTemplate);
-    query.bindValue(":1", isFrozen);
-    query.bindValue(":2", QString("%1%").arg(symbolFolderPath));
-    query.exec();
+    QSqlQuery &folderQuery = queryCache.prepare(queryTemplate);
+    folderQuery.bindValue(":1", isFrozen);
+    folderQuery.bindValue(":2", symbolFolderPath);
+    folderQuery.bindValue(":3", upperBound);
+    folderQuery.exec();
 
     if(error != nullptr)
-        error = new QSqlError(query.lastError());
+        error = new QSqlError(folderQuery.lastError());
 
-    if(query.lastError().type() == QSqlError::ErrorType::NoError)
+    if(folderQuery.lastError().type() == QSqlError::ErrorType::NoError)
         result = true;
 
     return result;
@@ -3,7 +3,10 @@
 
 #include "Entity/FolderEntity.h"
 
+#include "Utility/QueryCache.h"
+
 #include <QSqlError>
+#include <QStringList>
 #include <QSqlDatabase>
 
 class FolderRepository
@@ -12,15 +15,33 @@ public:
     FolderRepository(const QSqlDatabase &db);
     ~FolderRepository();
 
+    static QStringList hotQueryTemplates(); // Lookups run per file or per event, must be served by an index
+
     FolderEntity findBySymbolPath(const QString &symbolFolderPath, bool includeChildren = false) const;
     QString findSymbolPathByUserFolderPath(const QString &userFolderPath) const;
     QList<FolderEntity> findActiveFolders() const;
+    QStringList findFrozenUserFolderPaths(const QString &userFolderPath) const; // Whole tree under the user path
     bool save(FolderEntity &entity, QSqlError *error = nullptr);
     bool deleteEntity(FolderEntity &entity, QSqlError *error = nullptr);
     bool setIsFrozenOfChildren(const QString &symbolFolderPath, bool isFrozen, QSqlError *error = nullptr);
 
 private:
+    static const inline QString queryFindBySymbolPath = "SELECT * FROM FolderEntity WHERE symbol_folder_path = :1;" ;
+    static const inline QString queryFindChildFolders = "SELECT * FROM FolderEntity WHERE parent_folder_path = :1;" ;
+    static const inline QString queryFindChildFiles = " SELECT FileEntity.*, FolderEntity.user_folder_path,"
+                                                      "        (SELECT MAX(version_number) FROM FileVersionEntity"
+                                                      "         WHERE FileVersionEntity.symbol_file_path = FileEntity.symbol_file_path) AS max_version_number"
+                                                      " FROM FileEntity JOIN FolderEntity ON FolderEntity.symbol_folder_path = FileEntity.symbol_folder_path"
+                                                      " WHERE FileEntity.symbol_folder_path = :1;" ;
+    static const inline QString queryFindByUserFolderPath = "SELECT * FROM FolderEntity WHERE user_folder_path = :1;" ;
+    static const inline QString queryFindFrozenUserFolderPaths = " SELECT user_folder_path FROM FolderEntity"
+                                                                 " WHERE user_folder_path >= :1 AND user_folder_path < :2 AND is_frozen = 1;" ;
+    static const inline QString queryFindActiveFolders = " SELECT * FROM FolderEntity WHERE user_folder_path IS NOT NULL AND is_frozen = 0;" ; // Matches FolderEntity_active_index
+    static const inline QString querySetIsFrozenOfChildFiles = " UPDATE FileEntity SET is_frozen = :1 WHERE symbol_folder_path >= :2 AND symbol_folder_path < :3;" ;
+    static const inline QString querySetIsFrozenOfChildFolders = " UPDATE FolderEntity SET is_frozen = :1 WHERE parent_folder_path >= :2 AND parent_folder_path < :3;" ;
+
     QSqlDatabase database;
+    mutable QueryCache queryCache;
 };
 
 #endif // FOLDERREPOSITORY_H
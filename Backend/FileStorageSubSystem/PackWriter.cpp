@@ -0,0 +1,128 @@
+#include "PackWriter.h"
+
+#include "Utility/FileSync.h"
+
+#include <QDir>
+#include <QUuid>
+#include <QMutexLocker>
+
+QMutex PackWriter::openPackMutex;
+QSet<QString> PackWriter::openPackFileNames;
+
+PackWriter::PackWriter(const QString &packFolderPath)
+{
+    this->packFolderPath = QDir::toNativeSeparators(packFolderPath);
+
+    if(!this->packFolderPath.endsWith(QDir::separator()))
+        this->packFolderPath.append(QDir::separator());
+
+    packFileName = "";
+    packSize = 0;
+    isPackFolderSynced = false;
+}
+
+PackWriter::~PackWriter()
+{
+    closePack();
+
+    QMutexLocker locker(&openPackMutex);
+
+    for(const QString &name : qAsConst(writtenPackFileNames))
+        openPackFileNames.remove(name);
+}
+
+bool PackWriter::append(const char *data, qint64 length, QString &packFileName, qint64 &offset)
+{
+    if(!packFile.isOpen() || packSize + length > maxPackFileSize)
+    {
+        // Records pointing into the full pack are committed with the ones of the next, so it's synced before leaving it
+        if(packFile.isOpen() && !syncPack())
+        {
+            closePack();
+            return false;
+        }
+
+        bool isOpened = openNewPack();
+
+        if(!isOpened)
+            return false;
+    }
+
+    qint64 bytesWritten = packFile.write(data, length);
+
+    if(bytesWritten != length) // Partial write leaves garbage in the pack, next data goes to a fresh one
+    {
+        closePack();
+        return false;
+    }
+
+    packFileName = this->packFileName;
+    offset = packSize;
+    packSize += length;
+
+    return true;
+}
+
+bool PackWriter::flush()
+{
+    if(!packFile.isOpen())
+        return true;
+
+    return syncPack();
+}
+
+bool PackWriter::isPackOpen(const QString &packFileName)
+{
+    QMutexLocker locker(&openPackMutex);
+
+    return openPackFileNames.contains(packFileName);
+}
+
+bool PackWriter::openNewPack()
+{
+    closePack();
+
+    QDir().mkpath(packFolderPath);
+
+    QString newPackFileName = QUuid::createUuid().toString(QUuid::StringFormat::Id128) + ".pack";
+    packFile.setFileName(packFolderPath + newPackFileName);
+
+    bool isOpened = packFile.open(QFile::OpenModeFlag::WriteOnly | QFile::OpenModeFlag::NewOnly);
+
+    if(!isOpened)
+        return false;
+
+    packFileName = newPackFileName;
+    packSize = 0;
+    isPackFolderSynced = false;
+    writtenPackFileNames.append(packFileName);
+
+    QMutexLocker locker(&openPackMutex);
+    openPackFileNames.insert(packFileName);
+
+    return true;
+}
+
+bool PackWriter::syncPack()
+{
+    bool result = FileSync::syncFile(packFile);
+
+    if(result && !isPackFolderSynced)
+    {
+        result = FileSync::syncFolder(packFolderPath);
+        isPackFolderSynced = result;
+    }
+
+    return result;
+}
+
+void PackWriter::closePack()
+{
+    if(!packFile.isOpen())
+        return;
+
+    packFile.close();
+
+    packFileName = "";
+    packSize = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef PACKWRITER_H
+#define PACKWRITER_H
+
+#include <QSet>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+// Appends small pieces of content into large pack files, so they don't cost a file each.
+// Every writer owns the pack it appends to, writers of different threads never share a file.
+class PackWriter
+{
+public:
+    static const inline qint64 maxPackFileSize = 256 * 1024 * 1024; // A new pack is started past this size
+
+    PackWriter(const QString &packFolderPath);
+    ~PackWriter();
+
+    // Reports where the data is placed, caller records it in the database
+    bool append(const char *data, qint64 length, QString &packFileName, qint64 &offset);
+    bool flush(); // Syncs the pack to the disk, before the records pointing into it are committed
+
+    // Packs written by a live writer are never removed, records pointing into them may not be committed yet
+    static bool isPackOpen(const QString &packFileName);
+
+private:
+    bool openNewPack();
+    bool syncPack();
+    void closePack();
+
+    static QMutex openPackMutex;
+    static QSet<QString> openPackFileNames;
+
+    QString packFolderPath;
+    QString packFileName;
+    QFile packFile;
+    qint64 packSize;
+    bool isPackFolderSynced; // Entry of a new pack is durable only once its folder is synced
+    QStringList writtenPackFileNames;
+};
+
+#endif // PACKWRITER_H
@@ -0,0 +1,74 @@
+#include "ReadThrottle.h"
+
+#include <QThread>
+
+ReadThrottle::ReadThrottle(qint64 maxBytesPerSecond)
+{
+    this->maxBytesPerSecond = maxBytesPerSecond;
+    bytesConsumed = 0;
+    timer.start();
+}
+
+void ReadThrottle::consume(qint64 byteCount)
+{
+    if(maxBytesPerSecond <= 0 || byteCount <= 0)
+        return;
+
+    bytesConsumed += byteCount;
+
+    qint64 allowedTime = (bytesConsumed * 1000) / maxBytesPerSecond; // Milliseconds reading bytesConsumed should take at least
+
+    while(timer.elapsed() < allowedTime && !QThread::currentThread()->isInterruptionRequested())
+        QThread::msleep(qMin<qint64>(sleepSlice, allowedTime - timer.elapsed()));
+}
+
+ThrottledDevice::ThrottledDevice(QSharedPointer<QIODevice> source, ReadThrottle *throttle)
+{
+    this->source = source;
+    this->throttle = throttle;
+}
+
+ThrottledDevice::~ThrottledDevice()
+{
+    close();
+}
+
+bool ThrottledDevice::open(OpenMode mode)
+{
+    if(mode != OpenModeFlag::ReadOnly || source.isNull() || !source->isOpen())
+        return false;
+
+    // Source does the buffering if any, reads are passed on as they come
+    return QIODevice::open(mode | OpenModeFlag::Unbuffered);
+}
+
+bool ThrottledDevice::isSequential() const
+{
+    return source->isSequential();
+}
+
+qint64 ThrottledDevice::size() const
+{
+    return source->size();
+}
+
+qint64 ThrottledDevice::readData(char *data, qint64 maxSize)
+{
+    if(!source->isSequential() && source->pos() != pos() && !source->seek(pos()))
+        return -1;
+
+    qint64 result = source->read(data, maxSize);
+
+    if(result > 0 && throttle != nullptr)
+        throttle->consume(result);
+
+    return result;
+}
+
+qint64 ThrottledDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+
+    return -1;
+}
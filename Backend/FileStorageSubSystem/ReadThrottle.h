@@ -0,0 +1,45 @@
+#ifndef READTHROTTLE_H
+#define READTHROTTLE_H
+
+#include <QIODevice>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+// Keeps reads of background work under a rate. Shared by every device it's applied to, so reads of a base and
+// its delta count against the same budget. Sleeping stops once the thread is asked to interrupt.
+class ReadThrottle
+{
+public:
+    static const inline int sleepSlice = 100; // Milliseconds, interruption is checked this often while sleeping
+
+    ReadThrottle(qint64 maxBytesPerSecond);
+
+    void consume(qint64 byteCount); // Blocks until byteCount more bytes fit the rate
+
+private:
+    qint64 maxBytesPerSecond;
+    qint64 bytesConsumed;
+    QElapsedTimer timer;
+};
+
+// Read only view of another device, each read is accounted to a throttle. Size and random access are passed on.
+class ThrottledDevice : public QIODevice
+{
+public:
+    ThrottledDevice(QSharedPointer<QIODevice> source, ReadThrottle *throttle);
+    ~ThrottledDevice();
+
+    bool open(OpenMode mode) override;
+    bool isSequential() const override;
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    QSharedPointer<QIODevice> source;
+    ReadThrottle *throttle;
+};
+
+#endif // READTHROTTLE_H
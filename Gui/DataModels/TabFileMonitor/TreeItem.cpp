@@ -81,6 +81,18 @@ void TreeItem::appendChild(TreeItem *item)
     childItems.append(item);
 }
 
+void TreeItem::insertChild(int row, TreeItem *item)
+{
+    childItems.insert(row, item);
+}
+
+TreeItem *TreeItem::takeChild(int row)
+{
+    if (row < 0 || row >= childItems.size())
+        return nullptr;
+    return childItems.takeAt(row);
+}
+
 TreeItem *TreeItem::child(int row)
 {
     if (row < 0 || row >= childItems.size())
@@ -43,6 +43,8 @@ public:
     void setDescription(const QString &newDescription);
 
     void appendChild(TreeItem *child);
+    void insertChild(int row, TreeItem *child);
+    TreeItem *takeChild(int row); // Caller owns the returned item
 
     TreeItem *child(int row);
     int childCount() const;
@@ -3,7 +3,6 @@
 #include "Utility/DatabaseRegistry.h"
 
 #include <QDir>
-#include <QStack>
 #include <QFileIconProvider>
 
 using namespace TreeModelFileMonitor;
@@ -247,60 +246,192 @@ int Model::rowCount(const QModelIndex &parent) const
     return parentItem->childCount();
 }
 
+void Model::applyChanges(const QSet<QString> &folderPaths, const QSet<QString> &filePaths)
+{
+    // Parents sort before their children, so a parent is already in place when its children are checked
+    QStringList sortedFolderPaths = folderPaths.values();
+    sortedFolderPaths.sort();
+
+    for(const QString &folderPath : sortedFolderPaths)
+    {
+        TreeItem *item = folderItemMap.value(folderPath, nullptr);
+        TreeItem *parentItem = nullptr;
+
+        if(fsEventDb->isFolderExist(folderPath))
+        {
+            if(fsEventDb->isActiveRootFolder(folderPath))
+                parentItem = treeRoot;
+            else
+                parentItem = folderItemMap.value(fsEventDb->getParentOfFolder(folderPath), nullptr);
+        }
+
+        if(item != nullptr && item->getParentItem() != parentItem) // Gone or moved under another item
+        {
+            removeItem(item);
+            item = nullptr;
+        }
+
+        if(item == nullptr && parentItem != nullptr)
+        {
+            TreeItem *folderTree = createFolderTree(folderPath);
+
+            if(folderTree != nullptr)
+                insertItem(folderTree, parentItem);
+        }
+        else if(item != nullptr)
+            updateItemStatus(item, fsEventDb->getStatusOfFolder(folderPath));
+    }
+
+    for(const QString &filePath : filePaths)
+    {
+        TreeItem *item = fileItemMap.value(filePath, nullptr);
+        TreeItem *parentItem = nullptr;
+        FileSystemEventDb::ItemStatus status = fsEventDb->getStatusOfFile(filePath);
+
+        if(status >= FileSystemEventDb::ItemStatus::NewAdded) // Only eventful files are shown
+            parentItem = folderItemMap.value(fsEventDb->getParentOfFile(filePath), nullptr);
+
+        if(item != nullptr && item->getParentItem() != parentItem)
+        {
+            removeItem(item);
+            item = nullptr;
+        }
+
+        if(item == nullptr && parentItem != nullptr)
+        {
+            item = createTreeItem(filePath, TreeItem::ItemType::File, status, nullptr);
+            fileItemMap.insert(filePath, item);
+            insertItem(item, parentItem);
+        }
+        else if(item != nullptr)
+            updateItemStatus(item, status);
+    }
+}
+
 void Model::setupModelData()
 {
-    QStringList rootFolders = fsEventDb->getActiveRootFolderList();
+    // Whole tree comes from a single event db call, no per item lookups
+    QList<TreeItem *> rootItems = createItemTree(fsEventDb->getEventfulTree());
 
-    for(const QString &currentRootFolderPath : rootFolders)
+    for(TreeItem *activeRoot : rootItems)
     {
-        TreeItem *activeRoot = createTreeItem(currentRootFolderPath, TreeItem::ItemType::Folder, nullptr);
-        QStack<TreeItem *> itemStack;
-        itemStack.push(activeRoot);
+        activeRoot->setParentItem(treeRoot);
+        treeRoot->appendChild(activeRoot);
+    }
+}
 
-        while(!itemStack.isEmpty())
+TreeItem *Model::createFolderTree(const QString &pathToFolder)
+{
+    QList<TreeItem *> rootItems = createItemTree(fsEventDb->getEventfulTree(pathToFolder));
+
+    return rootItems.value(0, nullptr);
+}
+
+QList<TreeItem *> Model::createItemTree(const QList<FileSystemEventDb::TreeEntry> &entryList)
+{
+    QList<TreeItem *> result;
+
+    // Entries list parents before their children, so every parent is created by the time it's needed
+    for(const FileSystemEventDb::TreeEntry &entry : entryList)
+    {
+        TreeItem *parentItem = folderItemMap.value(entry.parentPath, nullptr);
+
+        if(entry.isFolder)
         {
-            TreeItem *parentItem = itemStack.pop();
+            TreeItem *item = createTreeItem(entry.path, TreeItem::ItemType::Folder, entry.status, parentItem);
+            folderItemMap.insert(entry.path, item);
 
-            if(parentItem->getParentItem() == nullptr)
-            {
-                parentItem->setParentItem(treeRoot);
-                treeRoot->appendChild(activeRoot);
-                folderItemMap.insert(parentItem->getUserPath(), parentItem);
-            }
+            if(parentItem == nullptr)
+                result.append(item);
+            else
+                parentItem->appendChild(item);
+        }
+        else if(parentItem != nullptr)
+        {
+            TreeItem *item = createTreeItem(entry.path, TreeItem::ItemType::File, entry.status, parentItem);
+            fileItemMap.insert(entry.path, item);
+            parentItem->appendChild(item);
+        }
+    }
 
-            QStringList childFolderPathList = fsEventDb->getDirectChildFolderListOfFolder(parentItem->getUserPath());
-            QStringList eventFulFileList = fsEventDb->getEventfulFileListOfFolder(parentItem->getUserPath());
+    return result;
+}
 
-            for(const QString &childFilePath : eventFulFileList)
-            {
-                TreeItem *fileItem = createTreeItem(childFilePath, TreeItem::ItemType::File, parentItem);
-                parentItem->appendChild(fileItem);
-                fileItemMap.insert(fileItem->getUserPath(), fileItem);
-            }
+void Model::insertItem(TreeItem *item, TreeItem *parentItem)
+{
+    // Same order as a full build, files first then folders, both sorted by path
+    int row = 0;
 
-            for(const QString &currentChildFolderPath : childFolderPathList)
-            {
-                TreeItem *childItem = createTreeItem(currentChildFolderPath, TreeItem::ItemType::Folder, parentItem);
-                parentItem->appendChild(childItem);
-                itemStack.push(childItem);
-                folderItemMap.insert(childItem->getUserPath(), childItem);
-            }
+    for(; row < parentItem->childCount(); ++row)
+    {
+        TreeItem *sibling = parentItem->child(row);
+
+        if(item->getType() == TreeItem::ItemType::File)
+        {
+            if(sibling->getType() == TreeItem::ItemType::Folder || sibling->getUserPath() > item->getUserPath())
+                break;
         }
+        else if(sibling->getType() == TreeItem::ItemType::Folder && sibling->getUserPath() > item->getUserPath())
+            break;
     }
+
+    if(parentItem == treeRoot) // Roots are kept in arrival order
+        row = parentItem->childCount();
+
+    beginInsertRows(indexOfItem(parentItem), row, row);
+    item->setParentItem(parentItem);
+    parentItem->insertChild(row, item);
+    endInsertRows();
 }
 
-TreeItem *Model::createTreeItem(const QString &pathToFileOrFolder, TreeItem::ItemType type, TreeItem *root) const
+void Model::removeItem(TreeItem *item)
 {
-    TreeItem *result = new TreeItem(root);
-    result->setUserPath(pathToFileOrFolder);
+    TreeItem *parentItem = item->getParentItem();
+    int row = item->row();
 
-    auto status = FileSystemEventDb::ItemStatus::Invalid;
+    beginRemoveRows(indexOfItem(parentItem), row, row);
+    parentItem->takeChild(row);
+    endRemoveRows();
 
-    if(type == TreeItem::ItemType::Folder)
-        status = fsEventDb->getStatusOfFolder(pathToFileOrFolder);
+    unregisterItem(item);
+    delete item;
+}
+
+void Model::unregisterItem(TreeItem *item)
+{
+    if(item->getType() == TreeItem::ItemType::Folder)
+        folderItemMap.remove(item->getUserPath());
     else
-        status = fsEventDb->getStatusOfFile(pathToFileOrFolder);
+        fileItemMap.remove(item->getUserPath());
+
+    for(int index = 0; index < item->childCount(); ++index)
+        unregisterItem(item->child(index));
+}
+
+void Model::updateItemStatus(TreeItem *item, FileSystemEventDb::ItemStatus status)
+{
+    if(item->getStatus() == status)
+        return;
+
+    item->setStatus(status);
+
+    QModelIndex first = indexOfItem(item);
+    emit dataChanged(first, first.siblingAtColumn(TreeItem::ColumnCount - 1));
+}
 
+QModelIndex Model::indexOfItem(TreeItem *item) const
+{
+    if(item == treeRoot)
+        return QModelIndex();
+
+    return createIndex(item->row(), 0, item);
+}
+
+TreeItem *Model::createTreeItem(const QString &pathToFileOrFolder, TreeItem::ItemType type,
+                                FileSystemEventDb::ItemStatus status, TreeItem *root) const
+{
+    TreeItem *result = new TreeItem(root);
+    result->setUserPath(pathToFileOrFolder);
     result->setStatus(status);
     result->setType(type);
 
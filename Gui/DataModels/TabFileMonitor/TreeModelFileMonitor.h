@@ -40,6 +40,9 @@ public:
     QMap<QString, TreeItem *> getFileItemMap() const;
     int getTotalItemCount() const;
 
+    // Brings only the given paths in line with event db, using row inserts, removals and data changes
+    void applyChanges(const QSet<QString> &folderPaths, const QSet<QString> &filePaths);
+
     QVariant data(const QModelIndex &index, int role) const override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     QVariant headerData(int section, Qt::Orientation orientation,
@@ -55,7 +58,15 @@ signals:
 
 private:
     void setupModelData();
-    TreeItem *createTreeItem(const QString &pathToFileOrFolder, TreeItem::ItemType type, TreeItem *root) const;
+    TreeItem *createFolderTree(const QString &pathToFolder);
+    QList<TreeItem *> createItemTree(const QList<FileSystemEventDb::TreeEntry> &entryList);
+    TreeItem *createTreeItem(const QString &pathToFileOrFolder, TreeItem::ItemType type,
+                             FileSystemEventDb::ItemStatus status, TreeItem *root) const;
+    void insertItem(TreeItem *item, TreeItem *parentItem);
+    void removeItem(TreeItem *item);
+    void unregisterItem(TreeItem *item);
+    void updateItemStatus(TreeItem *item, FileSystemEventDb::ItemStatus status);
+    QModelIndex indexOfItem(TreeItem *item) const;
     QString itemStatusToString(FileSystemEventDb::ItemStatus status) const;
 
     TreeItem *treeRoot;
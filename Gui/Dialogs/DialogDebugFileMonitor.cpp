@@ -4,6 +4,7 @@
 #include <QSqlQueryModel>
 
 #include "Utility/DatabaseRegistry.h"
+#include "Backend/FileMonitorSubSystem/FileSystemEventDb.h"
 
 DialogDebugFileMonitor::DialogDebugFileMonitor(QWidget *parent) :
     QDialog(parent),
@@ -24,6 +25,9 @@ DialogDebugFileMonitor::~DialogDebugFileMonitor()
 
 void DialogDebugFileMonitor::on_buttonExecute_clicked()
 {
+    FileSystemEventDb fsEventDb(DatabaseRegistry::fileSystemEventDatabase());
+    fsEventDb.exportSnapshot(); // Monitor state lives in memory, tables are only filled for browsing
+
     int currentIndex = ui->tabWidget->currentIndex();
     if(currentIndex == 0)
     {
@@ -6,7 +6,9 @@
 #include <quazip/quazip.h>
 #include <quazip/quazipfile.h>
 
+#include <QSet>
 #include <QQueue>
+#include <QDateTime>
 #include <QFileDialog>
 #include <QJsonObject>
 #include <QtConcurrent>
@@ -152,6 +154,8 @@ void DialogExport::on_buttonExport_clicked()
         importJsonFile.write(document.toJson(QJsonDocument::JsonFormat::Indented));
 
         int zipProgressValue = 0;
+        QSet<QString> zippedInternalFileNames;
+
         for(const QJsonValue &currentFileJson : qAsConst(fileJsonArray))
         {
             QJsonObject fileJson = currentFileJson.toObject();
@@ -162,25 +166,36 @@ void DialogExport::on_buttonExport_clicked()
             {
                 QJsonObject versionJson = currentFileVersion.toObject();
                 QString internalFileName = versionJson[JsonKeys::FileVersion::InternalFileName].toString();
-                QString internalFilePath = fsm->getStorageFolderPath() + internalFileName;
 
-                QFile rawFile(internalFilePath);
-                bool isReadable = rawFile.open(QFile::OpenModeFlag::ReadOnly);
+                if(zippedInternalFileNames.contains(internalFileName)) // Versions with same content share one blob
+                {
+                    ++zipProgressValue;
+                    emit signalZipProgressUpdated(zipProgressValue);
+                    continue;
+                }
+
+                // Stored content may be a delta, chunked or compressed, read it through storage manager
+                QSharedPointer<QIODevice> content = fsm->openFileVersion(versionJson[JsonKeys::FileVersion::SymbolFilePath].toString(),
+                                                                         versionJson[JsonKeys::FileVersion::VersionNumber].toInteger());
 
-                if(!isReadable)
+                if(content.isNull())
                 {
                     emit signalZippingFinished(false);
                     return;
                 }
 
-                QuaZipNewInfo info(internalFileName, internalFilePath);
+                // Stored file may not exist or differ from the content, version's own timestamp is used
+                QuaZipNewInfo info(internalFileName);
+                info.dateTime = QDateTime::fromString(versionJson[JsonKeys::FileVersion::Timestamp].toString(),
+                                                      Qt::DateFormat::TextDate);
                 QuaZipFile fileInZip(&archive);
                 fileInZip.open(QFile::OpenModeFlag::WriteOnly, info);
 
-                while(!rawFile.atEnd())
+                while(!content->atEnd())
                 {
                     // Write up to 100mb in every iteration.
-                    qlonglong bytesWritten = fileInZip.write(rawFile.read(104857600));
+                    QByteArray data = content->read(104857600);
+                    qlonglong bytesWritten = data.isEmpty() ? -1 : fileInZip.write(data);
                     if(bytesWritten == -1)
                     {
                         emit signalZippingFinished(false);
@@ -188,6 +203,7 @@ void DialogExport::on_buttonExport_clicked()
                     }
                 }
 
+                zippedInternalFileNames.insert(internalFileName);
                 ++zipProgressValue;
                 emit signalZipProgressUpdated(zipProgressValue);
             }
@@ -188,13 +188,14 @@ void DialogImport::on_buttonImport_clicked()
                 continue;
             }
 
-            fsm->addNewFolder(mapIterator.key(), "");
+            // Versions of a folder are unzipped and staged first, then recorded in a single transaction.
+            // Results are published once it's committed.
+            QList<QPair<TreeModelDialogImport::TreeItem *, QList<FileStorageManager::StagedFile>>> stagedItems;
 
             for(int index = 0; index < folderItem->childCount(); index++)
             {
                 emit signalProgressUpdate(++progressValue);
 
-                bool addingFirstVersion = true;
                 TreeModelDialogImport::TreeItem *childFileItem = folderItem->child(index);
                 if(childFileItem->getAction() != TreeModelDialogImport::TreeItem::Action::Import &&
                    childFileItem->getAction() != TreeModelDialogImport::TreeItem::Action::Overwrite)
@@ -202,16 +203,9 @@ void DialogImport::on_buttonImport_clicked()
                     continue;
                 }
 
-                QString symbolFilePath = childFileItem->getFileJson()[JsonKeys::File::SymbolFilePath].toString();
-                QJsonObject previousFile = fsm->getFileJsonBySymbolPath(symbolFilePath);
-                fsm->deleteFile(symbolFilePath);
-
-                if(previousFile[JsonKeys::IsExist].toBool() && !previousFile[JsonKeys::File::IsFrozen].toBool())
-                    emit signalFileImportStartedForActiveFile(previousFile[JsonKeys::File::UserFilePath].toString());
-
-                emit signalFileImportStarted(symbolFilePath);
-
+                QList<FileStorageManager::StagedFile> stagedVersions;
                 QJsonArray versionList = childFileItem->getFileJson()[JsonKeys::File::VersionList].toArray();
+
                 for(const QJsonValue &currentValue : versionList)
                 {
                     QJsonObject versionJson = currentValue.toObject();
@@ -228,29 +222,77 @@ void DialogImport::on_buttonImport_clicked()
                         tempFile.flush();
                     }
 
+                    // Earlier versions aren't recorded yet, so there is no base for a delta. Compaction makes those later.
+                    stagedVersions.append(fsm->stageVersion(tempFile.fileName()));
+                }
+
+                stagedItems.append({childFileItem, stagedVersions});
+            }
+
+            if(!fsm->beginTransaction()) // Versions would be written one by one, outside of any unit of work otherwise
+            {
+                for(const auto &stagedItem : qAsConst(stagedItems))
+                {
+                    for(const FileStorageManager::StagedFile &stagedFile : stagedItem.second)
+                        fsm->discardStagedFile(stagedFile);
+
+                    emit signalFileImportFailed(stagedItem.first->getFileJson()[JsonKeys::File::SymbolFilePath].toString());
+                }
+
+                allFilesImportedSuccessfully = false;
+                continue;
+            }
+
+            fsm->addNewFolder(mapIterator.key(), "");
+            QList<QPair<QString, bool>> importResults;
+
+            for(const auto &stagedItem : qAsConst(stagedItems))
+            {
+                TreeModelDialogImport::TreeItem *childFileItem = stagedItem.first;
+                QString symbolFilePath = childFileItem->getFileJson()[JsonKeys::File::SymbolFilePath].toString();
+                QJsonObject previousFile = fsm->getFileJsonBySymbolPath(symbolFilePath);
+                fsm->deleteFile(symbolFilePath);
+
+                if(previousFile[JsonKeys::IsExist].toBool() && !previousFile[JsonKeys::File::IsFrozen].toBool())
+                    emit signalFileImportStartedForActiveFile(previousFile[JsonKeys::File::UserFilePath].toString());
+
+                emit signalFileImportStarted(symbolFilePath);
+
+                QJsonArray versionList = childFileItem->getFileJson()[JsonKeys::File::VersionList].toArray();
+                bool addingFirstVersion = true;
+
+                for(qsizetype versionIndex = 0; versionIndex < stagedItem.second.size(); ++versionIndex)
+                {
+                    const FileStorageManager::StagedFile &stagedFile = stagedItem.second.at(versionIndex);
+                    QString description = versionList.at(versionIndex).toObject()[JsonKeys::FileVersion::Description].toString();
                     bool isAdded = false;
-                    QString description = versionJson[JsonKeys::FileVersion::Description].toString();
 
                     if(!addingFirstVersion)
-                        isAdded = fsm->appendVersion(symbolFilePath, tempFile.fileName(), description);
+                        isAdded = fsm->appendVersion(symbolFilePath, stagedFile, description);
                     else
                     {
                         isAdded = fsm->addNewFile(childFileItem->getFileJson()[JsonKeys::File::SymbolFolderPath].toString(),
-                                                  tempFile.fileName(),
+                                                  stagedFile,
                                                   true,
                                                   childFileItem->getName(),
                                                   description);
                     }
 
                     addingFirstVersion = false;
+                    importResults.append({symbolFilePath, isAdded});
+                }
+            }
 
-                    if(isAdded)
-                        emit signalFileImported(symbolFilePath);
-                    else
-                    {
-                        emit signalFileImportFailed(symbolFilePath);
-                        allFilesImportedSuccessfully = false;
-                    }
+            bool isCommitted = fsm->commitTransaction();
+
+            for(const QPair<QString, bool> &result : importResults)
+            {
+                if(result.second && isCommitted)
+                    emit signalFileImported(result.first);
+                else
+                {
+                    emit signalFileImportFailed(result.first);
+                    allFilesImportedSuccessfully = false;
                 }
             }
         }
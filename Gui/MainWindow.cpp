@@ -2,7 +2,6 @@
 #include "ui_MainWindow.h"
 
 #include "Utility/AppConfig.h"
-#include "Utility/JsonDtoFormat.h"
 #include "Backend/FileStorageSubSystem/FileStorageManager.h"
 
 #include <QDir>
@@ -51,10 +50,15 @@ MainWindow::MainWindow(QWidget *parent) :
                      ui->tab2Action_SaveAll, &QAction::setEnabled);
 
     createFileMonitorThread(dialogImport, tabFileExplorer);
+    createCompactionTask();
 }
 
 MainWindow::~MainWindow()
 {
+    compactionTimer->stop();
+    taskCompactStorage->requestInterruption();
+    taskCompactStorage->wait();
+
     fileMonitorThread->quit();
     fileMonitorThread->wait();
 
@@ -190,15 +194,13 @@ void MainWindow::createFileMonitorThread(const DialogImport * const dialogImport
 
     auto fsm = FileStorageManager::instance();
 
-    QJsonArray activeFolders = fsm->getActiveFolderList();
-    QJsonArray activeFiles = fsm->getActiveFileList();
     QStringList predictionList;
 
-    for(const QJsonValue &value : activeFolders)
-        predictionList << value.toObject()[JsonKeys::Folder::UserFolderPath].toString();
+    for(const FolderDto &folder : fsm->getActiveFolders())
+        predictionList << folder.userFolderPath;
 
-    for(const QJsonValue &value : activeFiles)
-        predictionList << value.toObject()[JsonKeys::File::UserFilePath].toString();
+    for(const FileDto &file : fsm->getActiveFiles())
+        predictionList << file.userFilePath;
 
     fmm->setPredictionList(predictionList);
 
@@ -241,6 +243,22 @@ QString MainWindow::fileMonitorThreadName() const
     return "File Monitor Thread";
 }
 
+void MainWindow::createCompactionTask()
+{
+    taskCompactStorage = new TaskCompactStorage(this);
+    compactionTimer = new QTimer(this);
+    compactionTimer->setInterval(TaskCompactStorage::runInterval);
+
+    // Cold data can wait, first run starts one interval after launch
+    QObject::connect(compactionTimer, &QTimer::timeout,
+                     this, [=]{
+        if(!taskCompactStorage->isRunning())
+            taskCompactStorage->start(QThread::Priority::LowestPriority);
+    });
+
+    compactionTimer->start();
+}
+
 void MainWindow::on_tab1Action_AddNewFolder_triggered()
 {
     Qt::WindowFlags flags = dialogAddNewFolder->windowFlags();
@@ -7,8 +7,10 @@
 #include "Dialogs/DialogSettings.h"
 #include "Dialogs/DialogAddNewFolder.h"
 #include "Dialogs/DialogDebugFileMonitor.h"
+#include "Tasks/TaskCompactStorage.h"
 #include "Backend/FileMonitorSubSystem/FileMonitoringManager.h"
 
+#include <QTimer>
 #include <QThread>
 #include <QMainWindow>
 #include <QSystemTrayIcon>
@@ -57,6 +59,7 @@ private:
     void createFileMonitorThread(const DialogImport * const dialogImport,
                                  const TabFileExplorer * const tabFileExplorer);
     QString fileMonitorThreadName() const;
+    void createCompactionTask();
 
 private:
     Ui::MainWindow *ui;
@@ -69,6 +72,8 @@ private:
     DialogDebugFileMonitor *dialogDebugFileMonitor;
     FileMonitoringManager *fmm;
     QThread *fileMonitorThread;
+    TaskCompactStorage *taskCompactStorage;
+    QTimer *compactionTimer;
 
 };
 
@@ -416,15 +416,14 @@ void TabFileExplorer::on_contextActionListView_DeleteVersion_triggered()
 
         QFuture<void> future = QtConcurrent::run([=, &fileJson]{
             qlonglong recentMaxVersion = fileJson[JsonKeys::File::MaxVersionNumber].toInteger();
-            fsm->deleteFileVersion(symbolFilePath, selectedVersionNumber);
+            auto storage = FileStorageManager::instance(); // Storage connections belong to the thread that opened them
+            storage->deleteFileVersion(symbolFilePath, selectedVersionNumber);
 
             if(recentMaxVersion == selectedVersionNumber) // If current version is deleted
             {
-                fileJson = fsm->getFileJsonBySymbolPath(symbolFilePath);
-                QJsonObject versionJson = fsm->getFileVersionJson(symbolFilePath, fileJson[JsonKeys::File::MaxVersionNumber].toInteger());
-                QString internalFilePath = fsm->getStorageFolderPath() + versionJson[JsonKeys::FileVersion::InternalFileName].toString();
+                fileJson = storage->getFileJsonBySymbolPath(symbolFilePath);
                 QFile::remove(userFilePath);
-                QFile::copy(internalFilePath, userFilePath);
+                storage->copyFileVersion(symbolFilePath, fileJson[JsonKeys::File::MaxVersionNumber].toInteger(), userFilePath);
 
                 emit signalStopMonitoringItem(userFilePath);
                 emit signalStartMonitoringItem(userFilePath);
@@ -493,10 +492,8 @@ void TabFileExplorer::on_contextActionListView_SetAsCurrentVersion_triggered()
             fsm->updateFileVersionEntity(versionJson);
             fsm->sortFileVersionsInIncreasingOrder(symbolFilePath);
 
-            QString internalFilePath = fsm->getStorageFolderPath();
-            internalFilePath += versionJson[JsonKeys::FileVersion::InternalFileName].toString();
-
-            QFile::copy(internalFilePath, userFilePath);
+            qlonglong currentVersionNumber = fsm->getFileBySymbolPath(symbolFilePath).maxVersionNumber; // Selected version is the latest now
+            fsm->copyFileVersion(symbolFilePath, currentVersionNumber, userFilePath);
         });
 
         futureWatcher.setFuture(future);
@@ -551,7 +548,6 @@ void TabFileExplorer::on_contextActionTableView_Delete_triggered()
 
     if(result == QMessageBox::StandardButton::Yes)
     {
-        auto fsm = FileStorageManager::instance();
         QFutureWatcher<void> futureWatcher;
         QProgressDialog dialog(this);
         dialog.setCancelButton(nullptr);
@@ -566,7 +562,8 @@ void TabFileExplorer::on_contextActionTableView_Delete_triggered()
             dialog.setLabelText(tr("Deleting folder <b>%1</b>...").arg(name));
 
             QFuture<void> future = QtConcurrent::run([=]{
-                fsm->deleteFolder(symbolPath);
+                auto storage = FileStorageManager::instance(); // Storage connections belong to the thread that opened them
+                storage->deleteFolder(symbolPath);
 
                 if(!isFrozen)
                     emit signalStopMonitoringItem(userPath);
@@ -588,7 +585,8 @@ void TabFileExplorer::on_contextActionTableView_Delete_triggered()
             dialog.setLabelText(tr("Deleting file <b>%1</b>...").arg(name));
 
             QFuture<void> future = QtConcurrent::run([=]{
-                fsm->deleteFile(symbolPath);
+                auto storage = FileStorageManager::instance(); // Storage connections belong to the thread that opened them
+                storage->deleteFile(symbolPath);
 
                 if(!isFrozen)
                     emit signalStopMonitoringItem(userPath);
@@ -709,10 +707,9 @@ void TabFileExplorer::executeFreezingOrThawingOfFile(const QString &name, const
             return;
         }
 
-        QJsonObject versionJson = fsm->getFileVersionJson(symbolPath, fileJson[JsonKeys::File::MaxVersionNumber].toInteger());
+        qlonglong versionNumber = fileJson[JsonKeys::File::MaxVersionNumber].toInteger();
         QString userFolderPath = parentFolderJson[JsonKeys::Folder::UserFolderPath].toString();
         QString userFilePath = userFolderPath + name;
-        QString internalFilePath = fsm->getStorageFolderPath() + versionJson[JsonKeys::FileVersion::InternalFileName].toString();
 
         bool isExist = QFile::exists(userFilePath);
         if(isExist)
@@ -745,7 +742,8 @@ void TabFileExplorer::executeFreezingOrThawingOfFile(const QString &name, const
             if(isExist)
                 QFile::remove(userFilePath);
 
-            isCopied = QFile::copy(internalFilePath, userFilePath);
+            auto storage = FileStorageManager::instance(); // Storage connections belong to the thread that opened them
+            isCopied = storage->copyFileVersion(symbolPath, versionNumber, userFilePath);
         });
 
         futureWatcher.setFuture(future);
@@ -810,14 +808,11 @@ void TabFileExplorer::thawFolderTree(const QString folderName, const QString &pa
                 for(const QJsonValue &currentChildFile : childFiles)
                 {
                     QJsonObject fileJson = currentChildFile.toObject();
-                    QJsonObject versionJson = fsm->getFileVersionJson(fileJson[JsonKeys::File::SymbolFilePath].toString(),
-                                                                      fileJson[JsonKeys::File::MaxVersionNumber].toInteger());
-
-                    QString internalFilePath = fsm->getStorageFolderPath();
-                    internalFilePath.append(versionJson[JsonKeys::FileVersion::InternalFileName].toString());
                     QString userFilePath = currentUserPath + fileJson[JsonKeys::File::FileName].toString();
 
-                    bool isCopied = QFile::copy(internalFilePath, userFilePath);
+                    bool isCopied = fsm->copyFileVersion(fileJson[JsonKeys::File::SymbolFilePath].toString(),
+                                                         fileJson[JsonKeys::File::MaxVersionNumber].toInteger(),
+                                                         userFilePath);
                     if(isCopied)
                         emit signalStartMonitoringItem(userFilePath); // Notify about copied file
                 }
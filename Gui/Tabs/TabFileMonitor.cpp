@@ -5,6 +5,8 @@
 #include "Utility/DatabaseRegistry.h"
 #include "DataModels/TabFileMonitor/TreeModelFileMonitor.h"
 
+#include <QMessageBox>
+
 TabFileMonitor::TabFileMonitor(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::TabFileMonitor)
@@ -18,6 +20,9 @@ TabFileMonitor::TabFileMonitor(QWidget *parent) :
     timer.setInterval(2000);
     timer.stop();
 
+    isSaveInProgress = false;
+    isRebuildRequired = true;
+
     QObject::connect(&timer, &QTimer::timeout,
                      this, &TabFileMonitor::displayFileMonitorContent);
 }
@@ -61,9 +66,25 @@ void TabFileMonitor::saveChanges(FileMonitoringManager *fmm)
                      fmm, &FileMonitoringManager::addTargetAtRuntime,
                      Qt::ConnectionType::BlockingQueuedConnection);
 
+    QObject::connect(task, &TaskSaveChanges::savingFailed,
+                     this, [=]{
+        QString title = tr("Some changes are not saved");
+        QString message = tr("Storage couldn't be written. Changes not saved are still listed, you can try saving them again.");
+        QMessageBox::warning(this, title, message);
+    });
+
     QObject::connect(task, &QThread::finished,
                      task, &QThread::deleteLater);
 
+    // Task holds pointers to tree items, model is left untouched until it finishes
+    QObject::connect(task, &QThread::finished,
+                     this, [=]{
+        isSaveInProgress = false;
+        isRebuildRequired = true; // Delegates were disabled for saving
+        onEventDbUpdated();
+    });
+
+    isSaveInProgress = true;
     treeModel->disableComboBoxes();
 
     task->start();
@@ -92,8 +113,15 @@ void TabFileMonitor::displayFileMonitorContent()
 {
     timer.stop();
 
+    if(isSaveInProgress) // Refreshed once saving finishes
+        return;
+
     FileSystemEventDb fsEventDb(DatabaseRegistry::fileSystemEventDatabase());
 
+    QSet<QString> changedFolderPaths;
+    QSet<QString> changedFilePaths;
+    bool isChangeListComplete = fsEventDb.takeChangedPaths(changedFolderPaths, changedFilePaths);
+
     if(fsEventDb.isContainAnyFolderEvent() || fsEventDb.isContainAnyFileEvent())
     {
         emit signalEnableSaveAllButton(true);
@@ -107,6 +135,17 @@ void TabFileMonitor::displayFileMonitorContent()
     ui->buttonAddDescription->setEnabled(true);
     ui->buttonDeleteDescription->setEnabled(true);
 
+    auto currentModel = (TreeModelFileMonitor::Model *) ui->treeView->model();
+
+    if(currentModel != nullptr && isChangeListComplete && !isRebuildRequired)
+    {
+        // Descriptions and selected actions of untouched items are kept
+        currentModel->applyChanges(changedFolderPaths, changedFilePaths);
+        return;
+    }
+
+    isRebuildRequired = false;
+
     TreeModelFileMonitor::Model *treeModel = new TreeModelFileMonitor::Model();
     QAbstractItemModel *oldModel = ui->treeView->model();
 
@@ -114,6 +153,16 @@ void TabFileMonitor::displayFileMonitorContent()
         delete oldModel;
 
     ui->treeView->setModel(treeModel);
+
+    QObject::connect(treeModel, &QAbstractItemModel::rowsInserted,
+                     this, [=](const QModelIndex &parent, int first, int last){
+        for(int row = first; row <= last; ++row)
+            openItemEditors(treeModel->index(row, 0, parent), true);
+    });
+
+    QObject::connect(treeModel, &QAbstractItemModel::dataChanged,
+                     this, &TabFileMonitor::reopenItemEditors);
+
     ui->comboBoxDescriptionNumber->setModel(treeModel->getDescriptionNumberListModel());
 
     QHeaderView *header = ui->treeView->header();
@@ -141,6 +190,43 @@ void TabFileMonitor::displayFileMonitorContent()
     ui->treeView->selectionModel()->clearSelection();
 }
 
+void TabFileMonitor::openItemEditors(const QModelIndex &index, bool isRecursive)
+{
+    ui->treeView->openPersistentEditor(index.siblingAtColumn(TreeModelFileMonitor::Model::ColumnIndexAction));
+    ui->treeView->openPersistentEditor(index.siblingAtColumn(TreeModelFileMonitor::Model::ColumnIndexDescription));
+    ui->treeView->expand(index);
+
+    if(!isRecursive)
+        return;
+
+    int childCount = ui->treeView->model()->rowCount(index);
+
+    for(int row = 0; row < childCount; ++row)
+        openItemEditors(ui->treeView->model()->index(row, 0, index), true);
+}
+
+void TabFileMonitor::reopenItemEditors(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    // Offered actions depend on the item's status and its parent's status
+    for(int row = topLeft.row(); row <= bottomRight.row(); ++row)
+    {
+        QModelIndex index = topLeft.siblingAtRow(row);
+        int childCount = ui->treeView->model()->rowCount(index);
+
+        ui->treeView->closePersistentEditor(index.siblingAtColumn(TreeModelFileMonitor::Model::ColumnIndexAction));
+        ui->treeView->closePersistentEditor(index.siblingAtColumn(TreeModelFileMonitor::Model::ColumnIndexDescription));
+        openItemEditors(index, false);
+
+        for(int childRow = 0; childRow < childCount; ++childRow)
+        {
+            QModelIndex childIndex = ui->treeView->model()->index(childRow, 0, index);
+
+            ui->treeView->closePersistentEditor(childIndex.siblingAtColumn(TreeModelFileMonitor::Model::ColumnIndexAction));
+            openItemEditors(childIndex, false);
+        }
+    }
+}
+
 void TabFileMonitor::on_buttonAddDescription_clicked()
 {
     QTextEdit *textEdit = ui->textEditDescription;
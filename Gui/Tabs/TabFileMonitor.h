@@ -38,10 +38,15 @@ private slots:
     void on_comboBoxDescriptionNumber_activated(int index);
 
 private:
+    void openItemEditors(const QModelIndex &index, bool isRecursive);
+    void reopenItemEditors(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
     Ui::TabFileMonitor *ui;
     TreeModelFileMonitor::ItemDelegateAction *itemDelegateAction;
     TreeModelFileMonitor::ItemDelegateDescription *itemDelegateDescription;
     QTimer timer;
+    bool isSaveInProgress;
+    bool isRebuildRequired; // Next refresh builds a new model instead of applying changes
 };
 
 #endif // TABFILEMONITOR_H
@@ -3,6 +3,10 @@
 #include "Backend/FileStorageSubSystem/FileStorageManager.h"
 
 #include <QDir>
+#include <QQueue>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent>
 
 TaskAddNewFolders::TaskAddNewFolders(QList<DialogAddNewFolder::FolderItem> list, QObject *parent)
     : QThread{parent}
@@ -27,44 +31,145 @@ int TaskAddNewFolders::fileCount() const
 void TaskAddNewFolders::run()
 {
     auto fsm = FileStorageManager::instance();
-    int fileNumber = 1;
-    bool isAllRequestSuccessful = true;
+    isAllRequestSuccessful = true;
+    fileNumber = 1;
+
+    // First create folders, files can only be added under existing folders.
+    bool isFoldersAdded = fsm->beginTransaction();
+
+    if(isFoldersAdded)
+    {
+        for(const DialogAddNewFolder::FolderItem &item : list)
+            fsm->addNewFolder(item.symbolFolderPath, item.userFolderPath);
+
+        isFoldersAdded = fsm->commitTransaction();
+    }
+
+    if(!isFoldersAdded) // None of the files has a folder to be added under
+    {
+        for(const DialogAddNewFolder::FolderItem &item : list)
+        {
+            for(auto cursor = item.files.cbegin(); cursor != item.files.cend(); ++cursor)
+            {
+                emit signalFileAddingFailed(cursor.key());
+                emit signalFileProcessed(fileNumber);
+                emit signalGenericFileEvent();
+                ++fileNumber;
+            }
+        }
+
+        emit finished(false);
+        return;
+    }
+
+    QList<FileJob> jobList;
 
-    // First create folders
     for(const DialogAddNewFolder::FolderItem &item : list)
     {
-        fsm->addNewFolder(item.symbolFolderPath, item.userFolderPath);
         emit signalFolderAdded(item.userFolderPath);
 
-        // Then add files
         QHashIterator<QString, bool> cursor(item.files);
         while(cursor.hasNext())
         {
             cursor.next();
+            jobList.append({item.symbolFolderPath, cursor.key(), cursor.value()});
+        }
+    }
 
-            emit signalFileBeingProcessed(cursor.key());
-            emit signalGenericFileEvent();
+    // Then add files, workers copy & hash while this thread is the only one writing to the database.
+    QThreadPool workerPool;
+    workerPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
 
-            QString description = "Initial version of <b>%1</b>";
-            description = description.arg(QFileInfo(cursor.key()).fileName());
-            bool requestResult = fsm->addNewFile(item.symbolFolderPath, cursor.key(), cursor.value(), "", description);
+    const FileStorageManager *storage = fsm.data();
+    const int maxStagedFileCount = workerPool.maxThreadCount() * 2;
+    QQueue<QFuture<FileStorageManager::StagedFile>> stagingQueue;
+    int nextJobIndex = 0;
+    int currentJobIndex = 0;
 
-            if(requestResult == true)
-                emit signalFileAddedSuccessfully(cursor.key());
-            else
-            {
-                isAllRequestSuccessful = false;
-                emit signalFileAddingFailed(cursor.key());
-            }
+    while(currentJobIndex < jobList.size())
+    {
+        // Keep the pool busy but bound the number of staged files waiting in the storage folder.
+        while(nextJobIndex < jobList.size() && stagingQueue.size() < maxStagedFileCount)
+        {
+            QString pathToFile = jobList.at(nextJobIndex).pathToFile;
 
-            emit signalFileProcessed(fileNumber);
+            emit signalFileBeingProcessed(pathToFile);
             emit signalGenericFileEvent();
-            ++fileNumber;
+
+            stagingQueue.enqueue(QtConcurrent::run(&workerPool, [storage, pathToFile] {
+                return storage->stageFile(pathToFile);
+            }));
+
+            ++nextJobIndex;
         }
+
+        // Don't keep already staged files waiting behind a slow copy.
+        if(!stagingQueue.head().isFinished() && !stagedJobs.isEmpty())
+            commitBatch(fsm.data());
+
+        FileStorageManager::StagedFile stagedFile = stagingQueue.dequeue().result();
+        fsm->packStagedFile(stagedFile);
+
+        stagedJobs.append({jobList.at(currentJobIndex), stagedFile});
+
+        if(stagedJobs.size() >= batchSize)
+            commitBatch(fsm.data());
+
+        ++currentJobIndex;
     }
 
+    commitBatch(fsm.data());
+
     if(isAllRequestSuccessful == false)
         emit finished(false);
     else
         emit finished(true);
 }
+
+void TaskAddNewFolders::commitBatch(FileStorageManager *fsm)
+{
+    if(stagedJobs.isEmpty())
+        return;
+
+    // Files are staged already, unit of work only records them
+    bool isStarted = fsm->beginTransaction();
+    QList<FileResult> results;
+
+    for(const StagedJob &stagedJob : qAsConst(stagedJobs))
+    {
+        const FileJob &job = stagedJob.job;
+        bool isAdded = false;
+
+        if(isStarted)
+        {
+            QString description = "Initial version of <b>%1</b>";
+            description = description.arg(QFileInfo(job.pathToFile).fileName());
+            isAdded = fsm->addNewFile(job.symbolFolderPath, stagedJob.stagedFile, job.isFrozen, "", description);
+        }
+        else
+            fsm->discardStagedFile(stagedJob.stagedFile);
+
+        results.append({job.pathToFile, isAdded});
+    }
+
+    // Staged files are renamed into place when adopted, a failed commit removes the ones no row refers to anymore
+    bool isCommitted = isStarted && fsm->commitTransaction();
+
+    // Results are published only after commit, so listeners always find the files in the database.
+    for(const FileResult &result : qAsConst(results))
+    {
+        if(result.isAdded && isCommitted)
+            emit signalFileAddedSuccessfully(result.pathToFile);
+        else
+        {
+            isAllRequestSuccessful = false;
+            emit signalFileAddingFailed(result.pathToFile);
+        }
+
+        emit signalFileProcessed(fileNumber);
+        emit signalGenericFileEvent();
+        ++fileNumber;
+    }
+
+    stagedJobs.clear();
+}
@@ -2,6 +2,7 @@
 #define TASKADDNEWFOLDERS_H
 
 #include "Dialogs/DialogAddNewFolder.h"
+#include "Backend/FileStorageSubSystem/FileStorageManager.h"
 
 #include <QThread>
 #include <QObject>
@@ -30,7 +31,36 @@ signals:
     void finished(bool isAllRequestsSuccessful); // Overloaded QThread::finished()
 
 private:
+    typedef struct
+    {
+        QString symbolFolderPath;
+        QString pathToFile;
+        bool isFrozen;
+
+    } FileJob;
+
+    typedef struct
+    {
+        QString pathToFile;
+        bool isAdded;
+
+    } FileResult;
+
+    typedef struct
+    {
+        FileJob job;
+        FileStorageManager::StagedFile stagedFile;
+
+    } StagedJob;
+
+    static const inline int batchSize = 256; // Files committed per transaction
+
+    void commitBatch(FileStorageManager *fsm);
+
     QList<DialogAddNewFolder::FolderItem> list;
+    QList<StagedJob> stagedJobs; // Waiting to be recorded in the next batch
+    bool isAllRequestSuccessful;
+    int fileNumber;
 };
 
 #endif // TASKADDNEWFOLDERS_H
@@ -0,0 +1,47 @@
+#include "TaskCompactStorage.h"
+
+#include "Backend/FileStorageSubSystem/FileStorageManager.h"
+
+#include <QDateTime>
+
+TaskCompactStorage::TaskCompactStorage(QObject *parent)
+    : QThread{parent}
+{
+}
+
+TaskCompactStorage::~TaskCompactStorage()
+{
+}
+
+void TaskCompactStorage::run()
+{
+    auto fsm = FileStorageManager::instance();
+    QStringList blobList = fsm->getColdBlobs(QDateTime::currentDateTime().addDays(-coldAge));
+
+    // Every read of compaction counts against the rate, also the ones inside a single large blob
+    ReadThrottle throttle(maxBytesPerSecond);
+    fsm->setReadThrottle(&throttle);
+
+    for(const QString &internalFileName : qAsConst(blobList))
+    {
+        // Each blob is replaced in a transaction of its own, stopping between two leaves nothing half done.
+        // Codecs also give up midway once interruption is requested, their output is removed then.
+        if(isInterruptionRequested())
+            break;
+
+        fsm->compactBlob(internalFileName);
+    }
+
+    // Blobs moved into packs above may have released chunks, so packs are looked at afterwards
+    const QStringList packList = isInterruptionRequested() ? QStringList() : fsm->getSparsePacks();
+
+    for(const QString &packFileName : packList)
+    {
+        if(isInterruptionRequested())
+            break;
+
+        fsm->compactPack(packFileName);
+    }
+
+    fsm->setReadThrottle(nullptr); // Manager outlives this run
+}
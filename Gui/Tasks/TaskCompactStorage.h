@@ -0,0 +1,23 @@
+#ifndef TASKCOMPACTSTORAGE_H
+#define TASKCOMPACTSTORAGE_H
+
+#include <QThread>
+
+// Rewrites cold blobs into smaller encodings and sparse packs into full ones at a limited read rate. Can be started again once it's finished.
+class TaskCompactStorage : public QThread
+{
+    Q_OBJECT
+public:
+    static const inline int runInterval = 60 * 60 * 1000; // Milliseconds between two runs
+    static const inline int coldAge = 30; // Days since the newest version using a blob
+    static const inline qint64 maxBytesPerSecond = 8 * 1024 * 1024; // Leaves the disk to the user
+
+    explicit TaskCompactStorage(QObject *parent = nullptr);
+    ~TaskCompactStorage();
+
+    // QThread interface
+protected:
+    void run() override;
+};
+
+#endif // TASKCOMPACTSTORAGE_H
@@ -2,9 +2,9 @@
 
 #include "Backend/FileStorageSubSystem/FileStorageManager.h"
 #include "Utility/DatabaseRegistry.h"
-#include "Utility/JsonDtoFormat.h"
 
 #include <QDir>
+#include <QHash>
 #include <QFile>
 
 TaskSaveChanges::TaskSaveChanges(const QMap<QString, TreeModelFileMonitor::TreeItem *> folderItemMap,
@@ -14,6 +14,7 @@ TaskSaveChanges::TaskSaveChanges(const QMap<QString, TreeModelFileMonitor::TreeI
 {
     totalItemCount = folderItemMap.size() + fileItemMap.size();
     currentItemNumber = 0;
+    isAllItemsSaved = true;
 }
 
 TaskSaveChanges::~TaskSaveChanges()
@@ -25,6 +26,9 @@ void TaskSaveChanges::run()
 {
     saveFolderChanges();
     saveFileChanges();
+
+    if(!isAllItemsSaved)
+        emit savingFailed();
 }
 
 void TaskSaveChanges::saveFolderChanges()
@@ -32,20 +36,28 @@ void TaskSaveChanges::saveFolderChanges()
     auto fsm = FileStorageManager::instance();
     FileSystemEventDb fsEventDb(DatabaseRegistry::fileSystemEventDatabase());
 
+    if(!fsm->beginTransaction()) // Items would be written one by one, outside of any batch otherwise
+    {
+        isAllItemsSaved = false;
+        return;
+    }
+
     while(folderItemIterator.hasNext())
     {
-        folderItemIterator.next();
+        if(!commitBatchIfFull(fsm.data(), fsEventDb))
+            return;
 
+        folderItemIterator.next();
         ++currentItemNumber;
         emit itemBeingProcessed(currentItemNumber);
 
         TreeModelFileMonitor::TreeItem *item = folderItemIterator.value();
-        QJsonObject folderJson = fsm->getFolderJsonByUserPath(item->getUserPath());
+        FolderDto folderDto = fsm->getFolderByUserPath(item->getUserPath());
         FileSystemEventDb::ItemStatus status = item->getStatus();
         TreeModelFileMonitor::TreeItem::Action action = item->getAction();
         QDir dir(item->getUserPath());
 
-        if(folderJson[JsonKeys::IsExist].toBool()) // If folder info exist in db
+        if(folderDto.isExist) // If folder info exist in db
         {
             if(action == TreeModelFileMonitor::TreeItem::Action::Restore) // Restore deleted folders
             {
@@ -55,22 +67,22 @@ void TaskSaveChanges::saveFolderChanges()
             }
             else if(action == TreeModelFileMonitor::TreeItem::Action::Delete) // Remove deleted folders from db
             {
-                bool isRemoved = fsm->deleteFolder(folderJson[JsonKeys::Folder::SymbolFolderPath].toString());
+                bool isRemoved = fsm->deleteFolder(folderDto.symbolFolderPath);
                 if(isRemoved)
-                    fsEventDb.deleteFolder(item->getUserPath());
+                    uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){ db.deleteFolder(item->getUserPath()); });
             }
             else if(action ==  TreeModelFileMonitor::TreeItem::Action::Freeze) // Freeze deleted folders
             {
-                folderJson[JsonKeys::Folder::IsFrozen] = true;
-                bool isUpdated = fsm->updateFolderEntity(folderJson, true);
+                folderDto.isFrozen = true;
+                bool isUpdated = fsm->updateFolderEntity(folderDto, true);
                 if(isUpdated)
-                    fsEventDb.deleteFolder(item->getUserPath());
+                    uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){ db.deleteFolder(item->getUserPath()); });
             }
         }
         else // If folder info not exist in db
         {
-            QJsonObject parentFolderJson = fsm->getFolderJsonByUserPath(item->getParentItem()->getUserPath());
-            QString symbolFolderPath = parentFolderJson[JsonKeys::Folder::SymbolFolderPath].toString();
+            FolderDto parentFolderDto = fsm->getFolderByUserPath(item->getParentItem()->getUserPath());
+            QString symbolFolderPath = parentFolderDto.symbolFolderPath;
 
             if(action == TreeModelFileMonitor::TreeItem::Action::Save)
             {
@@ -79,34 +91,40 @@ void TaskSaveChanges::saveFolderChanges()
                     symbolFolderPath += dir.dirName();
                     bool isSaved = fsm->addNewFolder(symbolFolderPath, item->getUserPath());
                     if(isSaved)
-                        fsEventDb.setStatusOfFolder(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+                    {
+                        uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){
+                            db.setStatusOfFolder(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+                        });
+                    }
                 }
                 else if(status == FileSystemEventDb::ItemStatus::Renamed)
                 {
                     symbolFolderPath += fsEventDb.getOldNameOfFolder(item->getUserPath());
                     symbolFolderPath += FileStorageManager::separator;
 
-                    folderJson = fsm->getFolderJsonBySymbolPath(symbolFolderPath);
-                    folderJson[JsonKeys::Folder::SuffixPath] = dir.dirName();
-                    folderJson[JsonKeys::Folder::UserFolderPath] = item->getUserPath();
+                    folderDto = fsm->getFolderBySymbolPath(symbolFolderPath);
+                    folderDto.suffixPath = dir.dirName();
+                    folderDto.userFolderPath = item->getUserPath();
 
-                    bool isSaved = fsm->updateFolderEntity(folderJson);
+                    bool isSaved = fsm->updateFolderEntity(folderDto);
 
                     if(isSaved)
                     {
-                        fsEventDb.setOldNameOfFolder(item->getUserPath(), "");
-                        fsEventDb.setStatusOfFolder(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+                        uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){
+                            db.setOldNameOfFolder(item->getUserPath(), "");
+                            db.setStatusOfFolder(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+                        });
                     }
                 }
             }
             else if(action == TreeModelFileMonitor::TreeItem::Action::Restore) // Restore renamed folders
             {
-                QString oldFolderPath = parentFolderJson[JsonKeys::Folder::UserFolderPath].toString();
+                QString oldFolderPath = parentFolderDto.userFolderPath;
                 oldFolderPath += fsEventDb.getOldNameOfFolder(item->getUserPath());
                 dir.removeRecursively();
                 bool isCreated = dir.mkpath(oldFolderPath);
 
-                if(isCreated)
+                if(isCreated) // Restores don't write the storage, nothing to wait for
                 {
                     fsEventDb.setOldNameOfFolder(item->getUserPath(), "");
                     fsEventDb.setStatusOfFolder(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
@@ -115,6 +133,8 @@ void TaskSaveChanges::saveFolderChanges()
             }
         }
     }
+
+    commitBatch(fsm.data(), fsEventDb); // Folders are committed on their own, a failing file batch can't roll them back
 }
 
 void TaskSaveChanges::saveFileChanges()
@@ -124,96 +144,186 @@ void TaskSaveChanges::saveFileChanges()
 
     while(fileItemIterator.hasNext())
     {
-        fileItemIterator.next();
+        // Content is staged and restores are copied before the batch begins, so the unit of work only writes rows.
+        QList<TreeModelFileMonitor::TreeItem *> batch;
+        QHash<QString, FileStorageManager::StagedFile> stagedFiles;
 
-        ++currentItemNumber;
-        emit itemBeingProcessed(currentItemNumber);
+        while(fileItemIterator.hasNext() && batch.size() < batchSize)
+        {
+            fileItemIterator.next();
+            ++currentItemNumber;
+            emit itemBeingProcessed(currentItemNumber);
 
-        TreeModelFileMonitor::TreeItem *item = fileItemIterator.value();
-        QJsonObject fileJson = fsm->getFileJsonByUserPath(fileItemIterator.key());
-        QString symbolFilePath = fileJson[JsonKeys::File::SymbolFilePath].toString();
-        FileSystemEventDb::ItemStatus status = item->getStatus();
-        TreeModelFileMonitor::TreeItem::Action action = item->getAction();
+            TreeModelFileMonitor::TreeItem *item = fileItemIterator.value();
+            bool isRowWriteNeeded = prepareFileChange(fsm.data(), fsEventDb, item, stagedFiles);
+
+            if(isRowWriteNeeded)
+                batch.append(item);
+        }
+
+        if(batch.isEmpty())
+            continue;
 
-        if(fileJson[JsonKeys::IsExist].toBool()) // If file info exist in db
+        if(!fsm->beginTransaction()) // Items would be written one by one, outside of any batch otherwise
         {
-            if(action == TreeModelFileMonitor::TreeItem::Action::Delete)
-            {
-                bool isDeleted = fsm->deleteFile(symbolFilePath);
-                if(isDeleted)
-                    fsEventDb.deleteFile(item->getUserPath());
-            }
-            else if(action == TreeModelFileMonitor::TreeItem::Action::Save) // Saves FileSystemEventDb::ItemStatus::Updated files
-            {
-                bool isAppended = fsm->appendVersion(symbolFilePath, item->getUserPath(), item->getDescription());
-                if(isAppended)
-                    fsEventDb.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
-            }
-            else if(action == TreeModelFileMonitor::TreeItem::Action::Freeze) // Freezes FileSystemEventDb::ItemStatus::Deleted files
+            for(const FileStorageManager::StagedFile &stagedFile : qAsConst(stagedFiles))
+                fsm->discardStagedFile(stagedFile);
+
+            isAllItemsSaved = false;
+            return;
+        }
+
+        for(TreeModelFileMonitor::TreeItem *item : qAsConst(batch))
+            saveFileChange(fsm.data(), fsEventDb, item, stagedFiles.take(item->getUserPath()));
+
+        commitBatch(fsm.data(), fsEventDb);
+    }
+}
+
+bool TaskSaveChanges::prepareFileChange(FileStorageManager *fsm,
+                                        FileSystemEventDb &fsEventDb,
+                                        TreeModelFileMonitor::TreeItem *item,
+                                        QHash<QString, FileStorageManager::StagedFile> &stagedFiles)
+{
+    FileDto fileDto = fsm->getFileByUserPath(item->getUserPath());
+    TreeModelFileMonitor::TreeItem::Action action = item->getAction();
+
+    // Restores don't write the storage, nothing to wait for
+    if(action == TreeModelFileMonitor::TreeItem::Action::Restore)
+    {
+        if(!fileDto.isExist) // Renamed and UpdatedAndRenamed files, old one may be in another folder
+            fileDto = fsm->getFileByUserPath(fsEventDb.getOldPathOfFile(item->getUserPath()));
+
+        QFile::remove(item->getUserPath()); // If restored file exist remove it
+        bool isCopied = fsm->copyFileVersion(fileDto.symbolFilePath, fileDto.maxVersionNumber, fileDto.userFilePath);
+        if(isCopied)
+            fsEventDb.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+
+        return false;
+    }
+
+    if(action == TreeModelFileMonitor::TreeItem::Action::Save)
+    {
+        FileStorageManager::StagedFile stagedFile;
+
+        if(fileDto.isExist) // Updated files are often rewritten with identical content, hash first to skip copying those.
+        {
+            stagedFile = fsm->stageVersion(item->getUserPath(),
+                                           FileStorageManager::IngestStrategy::HashBeforeCopy,
+                                           fileDto.symbolFilePath);
+        }
+        else if(item->getStatus() == FileSystemEventDb::ItemStatus::NewAdded)
+            stagedFile = fsm->stageVersion(item->getUserPath(), FileStorageManager::IngestStrategy::CopyWhileHashing);
+
+        if(stagedFile.isStaged)
+            stagedFiles.insert(item->getUserPath(), stagedFile);
+    }
+
+    return true;
+}
+
+void TaskSaveChanges::saveFileChange(FileStorageManager *fsm,
+                                     FileSystemEventDb &fsEventDb,
+                                     TreeModelFileMonitor::TreeItem *item,
+                                     const FileStorageManager::StagedFile &stagedFile)
+{
+    FileDto fileDto = fsm->getFileByUserPath(item->getUserPath());
+    QString symbolFilePath = fileDto.symbolFilePath;
+    FileSystemEventDb::ItemStatus status = item->getStatus();
+    TreeModelFileMonitor::TreeItem::Action action = item->getAction();
+
+    if(fileDto.isExist) // If file info exist in db
+    {
+        if(action == TreeModelFileMonitor::TreeItem::Action::Delete)
+        {
+            bool isDeleted = fsm->deleteFile(symbolFilePath);
+            if(isDeleted)
+                uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){ db.deleteFile(item->getUserPath()); });
+        }
+        else if(action == TreeModelFileMonitor::TreeItem::Action::Save) // Saves FileSystemEventDb::ItemStatus::Updated files
+        {
+            bool isAppended = fsm->appendVersion(symbolFilePath, stagedFile, item->getDescription());
+            if(isAppended)
             {
-                fileJson[JsonKeys::File::IsFrozen] = true;
-                bool isUpdated = fsm->updateFileEntity(fileJson);
-                if(isUpdated)
-                    fsEventDb.deleteFile(item->getUserPath());
+                uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){
+                    db.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+                });
             }
-            else if(action == TreeModelFileMonitor::TreeItem::Action::Restore)
+        }
+        else if(action == TreeModelFileMonitor::TreeItem::Action::Freeze) // Freezes FileSystemEventDb::ItemStatus::Deleted files
+        {
+            fileDto.isFrozen = true;
+            bool isUpdated = fsm->updateFileEntity(fileDto);
+            if(isUpdated)
+                uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){ db.deleteFile(item->getUserPath()); });
+        }
+    }
+    else if(action == TreeModelFileMonitor::TreeItem::Action::Save) // If file info NOT exist in db
+    {
+        if(status == FileSystemEventDb::ItemStatus::NewAdded)
+        {
+            FolderDto folderDto = fsm->getFolderByUserPath(item->getParentItem()->getUserPath());
+            bool isAdded = fsm->addNewFile(folderDto.symbolFolderPath, stagedFile);
+            if(isAdded)
             {
-                qlonglong maxVersionNumber = fileJson[JsonKeys::File::MaxVersionNumber].toInteger();
-                QJsonObject versionJson = fsm->getFileVersionJson(symbolFilePath, maxVersionNumber);
-                QString internalFileName = versionJson[JsonKeys::FileVersion::InternalFileName].toString();
-                auto internalFilePath = fsm->getStorageFolderPath() + internalFileName;
-                QString userFilePath = fileJson[JsonKeys::File::UserFilePath].toString();
-
-                QFile::remove(item->getUserPath()); // If restored file exist remove it
-                bool isCopied = QFile::copy(internalFilePath, userFilePath);
-                if(isCopied)
-                    fsEventDb.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+                uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){
+                    db.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+                });
             }
         }
-        else // If file info NOT exist in db
+        else if(status == FileSystemEventDb::ItemStatus::Renamed)
         {
-            QString userPathToOldFile = item->getParentItem()->getUserPath() + fsEventDb.getOldNameOfFile(item->getUserPath());
-            fileJson = fsm->getFileJsonByUserPath(userPathToOldFile);
-            symbolFilePath = fileJson[JsonKeys::File::SymbolFilePath].toString();
+            QString userPathToOldFile = fsEventDb.getOldPathOfFile(item->getUserPath()); // May be in another folder
+            fileDto = fsm->getFileByUserPath(userPathToOldFile);
 
-            if(action == TreeModelFileMonitor::TreeItem::Action::Restore) // Restores FileSystemEventDb::ItemStatus::Renamed and UpdatedAndRenamed files
+            // Rename file, moving it under its current folder keeps versions attached
+            FolderDto folderDto = fsm->getFolderByUserPath(item->getParentItem()->getUserPath());
+            fileDto.symbolFolderPath = folderDto.symbolFolderPath;
+            fileDto.fileName = fsEventDb.getNameOfFile(item->getUserPath());
+            bool isUpdated = fsm->updateFileEntity(fileDto);
+            if(isUpdated)
             {
-                qlonglong maxVersionNumber = fileJson[JsonKeys::File::MaxVersionNumber].toInteger();
-                QJsonObject versionJson = fsm->getFileVersionJson(symbolFilePath, maxVersionNumber);
-                QString internalFileName = versionJson[JsonKeys::FileVersion::InternalFileName].toString();
-                auto internalFilePath = fsm->getStorageFolderPath() + internalFileName;
-                QString userFilePath = fileJson[JsonKeys::File::UserFilePath].toString();
-
-                QFile::remove(item->getUserPath());
-                bool isCopied = QFile::copy(internalFilePath, userFilePath);
-                if(isCopied)
-                    fsEventDb.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
-            }
-            else if(action == TreeModelFileMonitor::TreeItem::Action::Save)
-            {
-                if(status == FileSystemEventDb::ItemStatus::NewAdded)
-                {
-                    QJsonObject folderJson = fsm->getFolderJsonByUserPath(item->getParentItem()->getUserPath());
-                    bool isAdded = fsm->addNewFile(folderJson[JsonKeys::Folder::SymbolFolderPath].toString(), item->getUserPath());
-                    if(isAdded)
-                        fsEventDb.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
-                }
-                else if(status == FileSystemEventDb::ItemStatus::Renamed)
-                {
-                    // Rename file
-                    fileJson[JsonKeys::File::FileName] = fsEventDb.getNameOfFile(item->getUserPath());
-                    bool isUpdated = fsm->updateFileEntity(fileJson);
-                    if(isUpdated)
-                    {
-                        fsEventDb.setOldNameOfFile(item->getUserPath(), "");
-                        fsEventDb.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
-                    }
-                }
+                uncommittedEventDbUpdates.append([=](FileSystemEventDb &db){
+                    db.setOldNameOfFile(item->getUserPath(), "");
+                    db.setStatusOfFile(item->getUserPath(), FileSystemEventDb::ItemStatus::Monitored);
+                });
             }
         }
     }
 }
 
+bool TaskSaveChanges::commitBatchIfFull(FileStorageManager *fsm, FileSystemEventDb &fsEventDb)
+{
+    if(currentItemNumber > 0 && currentItemNumber % batchSize == 0)
+    {
+        commitBatch(fsm, fsEventDb);
+
+        if(!fsm->beginTransaction())
+        {
+            isAllItemsSaved = false;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TaskSaveChanges::commitBatch(FileStorageManager *fsm, FileSystemEventDb &fsEventDb)
+{
+    bool isCommitted = fsm->commitTransaction(); // Failed commit is rolled back
+
+    // Monitor state follows the storage only once the batch is durable, items of a failed one are listed again.
+    if(isCommitted)
+    {
+        for(const auto &update : qAsConst(uncommittedEventDbUpdates))
+            update(fsEventDb);
+    }
+    else
+        isAllItemsSaved = false;
+
+    uncommittedEventDbUpdates.clear();
+}
+
 int TaskSaveChanges::getTotalItemCount() const
 {
     return totalItemCount;
@@ -2,9 +2,14 @@
 #define TASKSAVECHANGES_H
 
 #include <QSet>
+#include <QHash>
+#include <QList>
 #include <QThread>
 
+#include <functional>
+
 #include "DataModels/TabFileMonitor/TreeItem.h"
+#include "Backend/FileStorageSubSystem/FileStorageManager.h"
 
 class TaskSaveChanges : public QThread
 {
@@ -20,19 +25,37 @@ public:
 signals:
     void folderRestored(const QString &pathToFolder);
     void itemBeingProcessed(int itemNumber);
+    void savingFailed(); // Some items are not saved, they keep their status
 
     // QThread interface
 protected:
     void run();
 
 private:
+    static const inline int batchSize = 256; // Items committed per transaction
+
     void saveFolderChanges();
     void saveFileChanges();
 
+    // Stages content of an item, restores are done right away. False when item has no rows to write.
+    bool prepareFileChange(FileStorageManager *fsm,
+                           FileSystemEventDb &fsEventDb,
+                           TreeModelFileMonitor::TreeItem *item,
+                           QHash<QString, FileStorageManager::StagedFile> &stagedFiles);
+
+    void saveFileChange(FileStorageManager *fsm,
+                        FileSystemEventDb &fsEventDb,
+                        TreeModelFileMonitor::TreeItem *item,
+                        const FileStorageManager::StagedFile &stagedFile);
+    bool commitBatchIfFull(FileStorageManager *fsm, FileSystemEventDb &fsEventDb); // False when next batch can't begin
+    void commitBatch(FileStorageManager *fsm, FileSystemEventDb &fsEventDb);
+
     QMapIterator<QString, TreeModelFileMonitor::TreeItem *> folderItemIterator;
     QMapIterator<QString, TreeModelFileMonitor::TreeItem *> fileItemIterator;
     int totalItemCount;
     int currentItemNumber;
+    bool isAllItemsSaved;
+    QList<std::function<void(FileSystemEventDb &)>> uncommittedEventDbUpdates; // Applied once the batch is committed
 };
 
 #endif // TASKSAVECHANGES_H
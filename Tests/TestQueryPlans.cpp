@@ -0,0 +1,60 @@
+#include "Utility/AppConfig.h"
+#include "Utility/DatabaseRegistry.h"
+#include "Backend/FileStorageSubSystem/ORM/Repository/FolderRepository.h"
+#include "Backend/FileStorageSubSystem/ORM/Repository/FileRepository.h"
+#include "Backend/FileStorageSubSystem/ORM/Repository/FileVersionRepository.h"
+#include "Backend/FileStorageSubSystem/ORM/Repository/BlobRepository.h"
+#include "Backend/FileStorageSubSystem/ORM/Repository/ChunkRepository.h"
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+// Plans the hot queries of every repository against a freshly created and migrated file storage database.
+// A query which reads a whole table means an index is missing or the query stopped matching one.
+class TestQueryPlans : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(storageFolder.isValid());
+
+        AppConfig config; // Settings file sits next to the test executable, not the application
+        config.setStorageFolderPath(storageFolder.path());
+
+        database = DatabaseRegistry::fileStorageDatabase();
+        QVERIFY(database.isOpen());
+    }
+
+    void cleanupTestCase()
+    {
+        DatabaseRegistry::releaseFileStorageDatabase(database);
+    }
+
+    void hotQueriesUseIndexes_data()
+    {
+        QTest::addColumn<QStringList>("queryList");
+
+        QTest::newRow("FolderRepository") << FolderRepository::hotQueryTemplates();
+        QTest::newRow("FileRepository") << FileRepository::hotQueryTemplates();
+        QTest::newRow("FileVersionRepository") << FileVersionRepository::hotQueryTemplates();
+        QTest::newRow("BlobRepository") << BlobRepository::hotQueryTemplates();
+        QTest::newRow("ChunkRepository") << ChunkRepository::hotQueryTemplates();
+    }
+
+    void hotQueriesUseIndexes()
+    {
+        QFETCH(QStringList, queryList);
+
+        QStringList fullScans = DatabaseRegistry::findFullTableScans(database, queryList);
+        QVERIFY2(fullScans.isEmpty(), qPrintable(fullScans.join("\n")));
+    }
+
+private:
+    QTemporaryDir storageFolder;
+    QSqlDatabase database;
+};
+
+QTEST_GUILESS_MAIN(TestQueryPlans)
+#include "TestQueryPlans.moc"
@@ -6,6 +6,7 @@
 #include <QCoreApplication>
 
 QReadWriteLock AppConfig::lock;
+QAtomicInt AppConfig::storageFolderPathRevision;
 
 AppConfig::AppConfig()
 {
@@ -93,4 +94,27 @@ void AppConfig::setStorageFolderPath(const QString &newStorageFolderPath)
         value.append(QDir::separator());
 
     settings->setValue(KeyStorageFolderPath, value);
+    storageFolderPathRevision.ref();
+}
+
+int AppConfig::getStorageFolderPathRevision()
+{
+    return storageFolderPathRevision.loadAcquire();
+}
+
+bool AppConfig::isChunkStoreEnabled() const
+{
+    QReadLocker readLocker(&lock);
+
+    if(settings->value(KeyChunkStoreEnabled).toString() == "true")
+        return true;
+
+    return false;
+}
+
+void AppConfig::setChunkStoreEnabled(bool newChunkStoreEnabled)
+{
+    QWriteLocker writeLocker(&lock);
+
+    settings->setValue(KeyChunkStoreEnabled, newChunkStoreEnabled);
 }
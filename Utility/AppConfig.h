@@ -2,6 +2,7 @@
 #define APPCONFIG_H
 
 #include <QSettings>
+#include <QAtomicInt>
 #include <QReadWriteLock>
 
 class AppConfig
@@ -19,13 +20,19 @@ public:
     bool isStorageFolderPathValid() const;
     QString getStorageFolderPath() const;
     void setStorageFolderPath(const QString &newStorageFolderPath);
+    static int getStorageFolderPathRevision(); // Increases every time storage folder path is set
+
+    bool isChunkStoreEnabled() const; // New versions are split into content defined chunks shared across files
+    void setChunkStoreEnabled(bool newChunkStoreEnabled);
 
 private:
     static const inline QString KeyDisclaimerAccepted = "disclaimer_accepted";
     static const inline QString KeyTrayIconInformed = "tray_icon_informed";
     static const inline QString KeyStorageFolderPath = "storage_folder_path";
+    static const inline QString KeyChunkStoreEnabled = "chunk_store_enabled";
 
     static QReadWriteLock lock;
+    static QAtomicInt storageFolderPathRevision;
 
 private:
     QSettings *settings;
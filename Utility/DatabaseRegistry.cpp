@@ -6,10 +6,17 @@
 #include <QUuid>
 #include <QSqlQuery>
 #include <QSqlError>
+#include <QSqlRecord>
 
 QSqlDatabase DatabaseRegistry::dbFileStorage;
 QSqlDatabase DatabaseRegistry::dbFileMonitor;
 
+QMutex DatabaseRegistry::poolMutex;
+QWaitCondition DatabaseRegistry::poolCondition;
+QMultiHash<QThread *, QString> DatabaseRegistry::idleConnections;
+DatabaseRegistry::ConnectionOptions DatabaseRegistry::connectionOptions;
+DatabaseRegistry::PoolMetrics DatabaseRegistry::poolMetrics;
+
 DatabaseRegistry::DatabaseRegistry()
 {
 
@@ -17,20 +24,119 @@ DatabaseRegistry::DatabaseRegistry()
 
 QSqlDatabase DatabaseRegistry::fileStorageDatabase()
 {
+    QMutexLocker locker(&poolMutex);
+
     bool isCreated = dbFileStorage.isValid();
 
     if(!isCreated)
         createDbFileStorage();
 
+    ++poolMetrics.checkouts;
+
+    QThread *currentThread = QThread::currentThread();
+    auto iterator = idleConnections.find(currentThread);
+
+    if(iterator != idleConnections.end())
+    {
+        QString connectionName = iterator.value();
+        idleConnections.erase(iterator);
+        --poolMetrics.idleConnections;
+        ++poolMetrics.reuses;
+
+        return QSqlDatabase::database(connectionName);
+    }
+
+    if(poolMetrics.openConnections >= connectionOptions.maxOpenConnections)
+    {
+        ++poolMetrics.waits;
+
+        // Idle connections of other threads can't be handed over, only closed. So wait for a slot to be freed instead.
+        bool isSlotFreed = poolCondition.wait(&poolMutex, connectionOptions.checkoutTimeout);
+
+        if(!isSlotFreed || poolMetrics.openConnections >= connectionOptions.maxOpenConnections)
+            ++poolMetrics.overflows; // Never fail a checkout, limit is a soft limit
+    }
+
     QString newConnectionName = QUuid::createUuid().toString(QUuid::StringFormat::Id128);
 
     QSqlDatabase result =  QSqlDatabase::cloneDatabase(dbFileStorage, newConnectionName);
     result.open();
-    result.exec("PRAGMA foreign_keys = ON;");
+    applyConnectionOptions(result);
+    ++poolMetrics.openConnections;
 
     return result;
 }
 
+void DatabaseRegistry::releaseFileStorageDatabase(QSqlDatabase &db)
+{
+    QString connectionName = db.connectionName();
+    QThread *currentThread = QThread::currentThread();
+
+    db = QSqlDatabase(); // Drop caller's handle, connection can't be removed while it's referenced
+
+    QMutexLocker locker(&poolMutex);
+
+    if(currentThread->isFinished()) // Finishing threads release their thread local managers
+    {
+        QStringList connectionNames = idleConnections.values(currentThread);
+        poolMetrics.idleConnections -= connectionNames.size();
+        idleConnections.remove(currentThread);
+        connectionNames.append(connectionName);
+
+        for(const QString &name : connectionNames)
+        {
+            closeConnection(name);
+            --poolMetrics.openConnections;
+            poolCondition.wakeOne();
+        }
+    }
+    else
+    {
+        idleConnections.insert(currentThread, connectionName);
+        ++poolMetrics.idleConnections;
+    }
+}
+
+DatabaseRegistry::ConnectionOptions DatabaseRegistry::fileStorageConnectionOptions()
+{
+    QMutexLocker locker(&poolMutex);
+
+    return connectionOptions;
+}
+
+void DatabaseRegistry::setFileStorageConnectionOptions(const ConnectionOptions &options)
+{
+    QMutexLocker locker(&poolMutex);
+
+    connectionOptions = options;
+}
+
+DatabaseRegistry::PoolMetrics DatabaseRegistry::fileStoragePoolMetrics()
+{
+    QMutexLocker locker(&poolMutex);
+
+    return poolMetrics;
+}
+
+void DatabaseRegistry::applyConnectionOptions(QSqlDatabase &db)
+{
+    db.exec("PRAGMA foreign_keys = ON;");
+    db.exec(QString("PRAGMA busy_timeout = %1;").arg(connectionOptions.busyTimeout));
+    db.exec(QString("PRAGMA synchronous = %1;").arg(connectionOptions.synchronous));
+    db.exec(QString("PRAGMA cache_size = %1;").arg(connectionOptions.cacheSize));
+    db.exec(QString("PRAGMA mmap_size = %1;").arg(connectionOptions.mmapSize));
+}
+
+void DatabaseRegistry::closeConnection(const QString &connectionName)
+{
+    {
+        QSqlDatabase db = QSqlDatabase::database(connectionName, false);
+        db.close();
+    }
+
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
 QSqlDatabase DatabaseRegistry::fileSystemEventDatabase()
 {
     bool isCreated = dbFileMonitor.isValid();
@@ -62,6 +168,7 @@ void DatabaseRegistry::createDbFileStorage()
     dbFileStorage = QSqlDatabase::addDatabase("QSQLITE", "file_storage_db");
     dbFileStorage.setDatabaseName(dbPath);
     dbFileStorage.open();
+    dbFileStorage.exec(QString("PRAGMA journal_mode = %1;").arg(connectionOptions.journalMode)); // Persistent, stored in the db file
 
     if(!isExist)
     {
@@ -94,25 +201,220 @@ void DatabaseRegistry::createDbFileStorage()
         queryCreateTableFileEntity += " PRIMARY KEY (symbol_folder_path, file_name)";
         queryCreateTableFileEntity += ");" ;
 
-        QString queryCreateTableFileVersionEntity;
-        queryCreateTableFileVersionEntity += "CREATE TABLE FileVersionEntity (";
-        queryCreateTableFileVersionEntity += " symbol_file_path NOT NULL CHECK (symbol_file_path != \"\"),";
-        queryCreateTableFileVersionEntity += " version_number INTEGER NOT NULL CHECK (version_number >= 1),";
-        queryCreateTableFileVersionEntity += " internal_file_name TEXT NOT NULL UNIQUE CHECK (internal_file_name != \"\"),";
-        queryCreateTableFileVersionEntity += " size INTEGER NOT NULL DEFAULT 0 CHECK(size >= 0),";
-        queryCreateTableFileVersionEntity += " timestamp TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP,";
-        queryCreateTableFileVersionEntity += " description TEXT DEFAULT NULL CHECK (description != \"\"),";
-        queryCreateTableFileVersionEntity += " hash TEXT DEFAULT NULL CHECK (hash != \"\"),";
-        queryCreateTableFileVersionEntity += " FOREIGN KEY (symbol_file_path) REFERENCES FileEntity (symbol_file_path)";
-        queryCreateTableFileVersionEntity += " ON DELETE CASCADE ON UPDATE CASCADE,";
-        queryCreateTableFileVersionEntity += " PRIMARY KEY (symbol_file_path, version_number)";
-        queryCreateTableFileVersionEntity += ");" ;
-
         dbFileStorage.exec(queryCreateTableFolderEntity);
         dbFileStorage.exec(queryCreateTableFileEntity);
-        dbFileStorage.exec(queryCreateTableFileVersionEntity);
+        dbFileStorage.exec(queryCreateTableFileVersionEntity("FileVersionEntity"));
+
+        for(const QString &statement : queryCreateTableBlobEntity())
+            dbFileStorage.exec(statement);
+
         dbFileStorage.exec("INSERT INTO FolderEntity (suffix_path) VALUES('/');");
+        dbFileStorage.exec("PRAGMA user_version = 1;"); // Base schema, migrations bring it up to date
+    }
+
+    migrateDbFileStorage();
+}
+
+void DatabaseRegistry::migrateDbFileStorage()
+{
+    QSqlQuery query(dbFileStorage);
+    query.exec("PRAGMA user_version;");
+
+    int schemaVersion = 0;
+    if(query.next())
+        schemaVersion = query.value(0).toInt();
+
+    if(schemaVersion >= fileStorageSchemaVersion)
+        return;
+
+    // Each step is applied in a transaction of its own and stops the migration when it fails, so it's retried next time.
+    // Later steps are never applied over a half migrated schema.
+    if(schemaVersion < 1) // Versions started sharing content addressed blobs, internal_file_name is no longer unique
+    {
+        QStringList statementList;
+        statementList.append(queryCreateTableFileVersionEntity("FileVersionEntity_new"));
+        statementList.append(" INSERT INTO FileVersionEntity_new"
+                             " SELECT symbol_file_path, version_number, internal_file_name, size, timestamp, description, hash"
+                             " FROM FileVersionEntity;");
+        statementList.append("DROP TABLE FileVersionEntity;");
+        statementList.append("ALTER TABLE FileVersionEntity_new RENAME TO FileVersionEntity;");
+        statementList.append(queryCreateTableBlobEntity());
+        statementList.append(" INSERT INTO BlobEntity (internal_file_name, hash, size, reference_count)"
+                             " SELECT internal_file_name, MAX(hash), MAX(size), COUNT(*)"
+                             " FROM FileVersionEntity GROUP BY internal_file_name;");
+
+        if(!applyMigration(1, statementList))
+            return;
+    }
+
+    if(schemaVersion < 2) // Monitoring starts from active folders instead of scanning every file
+    {
+        QStringList statementList;
+        statementList.append(" CREATE INDEX FolderEntity_active_index ON FolderEntity (user_folder_path)"
+                             " WHERE user_folder_path IS NOT NULL AND is_frozen = 0;");
+
+        if(!applyMigration(2, statementList))
+            return;
+    }
+
+    if(schemaVersion < 3) // Blobs can be stored as a delta against another blob
+    {
+        QStringList statementList;
+        statementList.append(" ALTER TABLE BlobEntity ADD COLUMN base_internal_file_name TEXT DEFAULT NULL"
+                             " CHECK (base_internal_file_name != \"\");");
+        statementList.append(" ALTER TABLE BlobEntity ADD COLUMN chain_depth INTEGER NOT NULL DEFAULT 0"
+                             " CHECK (chain_depth >= 0);");
+
+        if(!applyMigration(3, statementList))
+            return;
+    }
+
+    if(schemaVersion < 4) // Blobs can be stored as a list of content defined chunks, chunks live in pack files
+    {
+        QString queryCreateTableChunkEntity;
+        queryCreateTableChunkEntity += "CREATE TABLE ChunkEntity (";
+        queryCreateTableChunkEntity += " hash TEXT NOT NULL PRIMARY KEY CHECK (hash != \"\"),";
+        queryCreateTableChunkEntity += " size INTEGER NOT NULL CHECK (size >= 0),";
+        queryCreateTableChunkEntity += " pack_file_name TEXT NOT NULL CHECK (pack_file_name != \"\"),";
+        queryCreateTableChunkEntity += " pack_offset INTEGER NOT NULL CHECK (pack_offset >= 0),";
+        queryCreateTableChunkEntity += " reference_count INTEGER NOT NULL DEFAULT 0 CHECK (reference_count >= 0)";
+        queryCreateTableChunkEntity += ");" ;
+
+        // Chunks are shared between blobs, so a blob only keeps the ordered list of chunk hashes
+        QString queryCreateTableBlobChunkEntity;
+        queryCreateTableBlobChunkEntity += "CREATE TABLE BlobChunkEntity (";
+        queryCreateTableBlobChunkEntity += " internal_file_name TEXT NOT NULL CHECK (internal_file_name != \"\"),";
+        queryCreateTableBlobChunkEntity += " chunk_number INTEGER NOT NULL CHECK (chunk_number >= 0),";
+        queryCreateTableBlobChunkEntity += " chunk_hash TEXT NOT NULL CHECK (chunk_hash != \"\"),";
+        queryCreateTableBlobChunkEntity += " PRIMARY KEY (internal_file_name, chunk_number)";
+        queryCreateTableBlobChunkEntity += ");" ;
+
+        QStringList statementList;
+        statementList.append(" ALTER TABLE BlobEntity ADD COLUMN layout INTEGER NOT NULL DEFAULT 0"
+                             " CHECK (layout BETWEEN 0 AND 2);");
+        statementList.append("UPDATE BlobEntity SET layout = 1 WHERE base_internal_file_name IS NOT NULL;");
+        statementList.append(queryCreateTableChunkEntity);
+        statementList.append("CREATE INDEX ChunkEntity_pack_file_name_index ON ChunkEntity (pack_file_name);");
+        statementList.append(queryCreateTableBlobChunkEntity);
+
+        if(!applyMigration(4, statementList))
+            return;
+    }
+
+    if(schemaVersion < 5) // Full content files can be block compressed
+    {
+        QStringList statementList;
+        statementList.append(" ALTER TABLE BlobEntity ADD COLUMN codec INTEGER NOT NULL DEFAULT 0"
+                             " CHECK (codec BETWEEN 0 AND 2);");
+
+        if(!applyMigration(5, statementList))
+            return;
+    }
+
+    if(schemaVersion < 6) // Maintenance finds versions and deltas of a blob, cold blobs by their last use
+    {
+        QStringList statementList;
+        statementList.append(" CREATE INDEX FileVersionEntity_internal_file_name_index"
+                             " ON FileVersionEntity (internal_file_name, timestamp);");
+        statementList.append(" CREATE INDEX BlobEntity_base_internal_file_name_index ON BlobEntity (base_internal_file_name)"
+                             " WHERE base_internal_file_name IS NOT NULL;");
+
+        if(!applyMigration(6, statementList))
+            return;
+    }
+}
+
+bool DatabaseRegistry::applyMigration(int schemaVersion, const QStringList &statementList)
+{
+    bool result = dbFileStorage.transaction();
+    QSqlQuery query(dbFileStorage);
+
+    for(const QString &statement : statementList)
+    {
+        if(!result)
+            break;
+
+        result = query.exec(statement);
     }
+
+    if(result)
+        result = query.exec(QString("PRAGMA user_version = %1;").arg(schemaVersion));
+
+    if(result)
+        result = dbFileStorage.commit();
+
+    if(!result)
+        dbFileStorage.rollback();
+
+    return result;
+}
+
+QString DatabaseRegistry::prefixUpperBound(const QString &prefix)
+{
+    QString result = prefix;
+
+    if(!result.isEmpty())
+        result.back() = QChar(result.back().unicode() + 1);
+
+    return result;
+}
+
+QStringList DatabaseRegistry::findFullTableScans(const QSqlDatabase &db, const QStringList &queryList)
+{
+    QStringList result;
+
+    for(const QString &currentQuery : queryList)
+    {
+        QSqlQuery query(db);
+        query.exec("EXPLAIN QUERY PLAN " + currentQuery); // Unbound parameters are planned as NULL
+
+        while(query.next())
+        {
+            QString detail = query.record().value("detail").toString();
+
+            // Index scans read "SCAN table USING INDEX", bare table scans don't mention any index
+            if(detail.startsWith("SCAN ") && !detail.contains(" USING "))
+                result.append(QString("%1 -> %2").arg(currentQuery, detail));
+        }
+    }
+
+    return result;
+}
+
+QString DatabaseRegistry::queryCreateTableFileVersionEntity(const QString &tableName)
+{
+    QString result;
+    result += "CREATE TABLE %1 (";
+    result += " symbol_file_path NOT NULL CHECK (symbol_file_path != \"\"),";
+    result += " version_number INTEGER NOT NULL CHECK (version_number >= 1),";
+    result += " internal_file_name TEXT NOT NULL CHECK (internal_file_name != \"\"),";
+    result += " size INTEGER NOT NULL DEFAULT 0 CHECK(size >= 0),";
+    result += " timestamp TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP,";
+    result += " description TEXT DEFAULT NULL CHECK (description != \"\"),";
+    result += " hash TEXT DEFAULT NULL CHECK (hash != \"\"),";
+    result += " FOREIGN KEY (symbol_file_path) REFERENCES FileEntity (symbol_file_path)";
+    result += " ON DELETE CASCADE ON UPDATE CASCADE,";
+    result += " PRIMARY KEY (symbol_file_path, version_number)";
+    result += ");" ;
+
+    return result.arg(tableName);
+}
+
+QStringList DatabaseRegistry::queryCreateTableBlobEntity()
+{
+    QString queryCreateTableBlobEntity;
+    queryCreateTableBlobEntity += "CREATE TABLE BlobEntity (";
+    queryCreateTableBlobEntity += " internal_file_name TEXT NOT NULL PRIMARY KEY CHECK (internal_file_name != \"\"),";
+    queryCreateTableBlobEntity += " hash TEXT DEFAULT NULL CHECK (hash != \"\"),";
+    queryCreateTableBlobEntity += " size INTEGER NOT NULL DEFAULT 0 CHECK(size >= 0),";
+    queryCreateTableBlobEntity += " reference_count INTEGER NOT NULL DEFAULT 0 CHECK(reference_count >= 0)";
+    queryCreateTableBlobEntity += ");" ;
+
+    QStringList result;
+    result.append(queryCreateTableBlobEntity);
+    result.append("CREATE INDEX BlobEntity_hash_index ON BlobEntity (hash, size);");
+
+    return result;
 }
 
 void DatabaseRegistry::createDbFileMonitor()
@@ -162,6 +464,7 @@ void DatabaseRegistry::createDbFileMonitor()
     queryCreateTableMonitoringError += " ); " ;
 
     dbFileMonitor.exec(queryCreateTableFolder);
+    dbFileMonitor.exec("CREATE INDEX Folder_parent_folder_path_index ON Folder (parent_folder_path);"); // Child listing and cascades
     dbFileMonitor.exec(queryCreateTableFile);
     dbFileMonitor.exec(queryCreateTableMonitoringError);
 }
@@ -1,21 +1,74 @@
 #ifndef DATABASEREGISTRY_H
 #define DATABASEREGISTRY_H
 
+#include <QHash>
+#include <QMutex>
+#include <QThread>
 #include <QSqlDatabase>
+#include <QWaitCondition>
 
 class DatabaseRegistry
 {
 public:
+    // Applied to every file storage connection. Changes take effect for connections opened afterwards.
+    struct ConnectionOptions
+    {
+        QString journalMode = "WAL";   // Readers never block on the writer
+        QString synchronous = "NORMAL"; // Durable at checkpoints, enough with WAL. Released files are removed after a checkpoint.
+        qlonglong mmapSize = 268435456; // 256 MiB
+        int cacheSize = -16384; // Negative values are KiB
+        int busyTimeout = 5000; // Milliseconds a connection waits for the write lock
+        int maxOpenConnections = 32;
+        int checkoutTimeout = 1000; // Milliseconds to wait for a free slot before opening beyond the limit
+    };
+
+    struct PoolMetrics
+    {
+        qlonglong checkouts = 0;
+        qlonglong reuses = 0;
+        qlonglong waits = 0;
+        qlonglong overflows = 0;
+        int openConnections = 0;
+        int idleConnections = 0;
+    };
+
     DatabaseRegistry();
 
+    // Checks out a connection owned by the calling thread. Hand it back with releaseFileStorageDatabase().
     static QSqlDatabase fileStorageDatabase();
+    static void releaseFileStorageDatabase(QSqlDatabase &db);
     static QSqlDatabase fileSystemEventDatabase();
 
+    static ConnectionOptions fileStorageConnectionOptions();
+    static void setFileStorageConnectionOptions(const ConnectionOptions &options);
+    static PoolMetrics fileStoragePoolMetrics();
+
+    // Smallest string after every string starting with prefix. Lets prefix matches run as index range scans.
+    static QString prefixUpperBound(const QString &prefix);
+
+    // Runs EXPLAIN QUERY PLAN on each query and returns the ones which read a whole table.
+    static QStringList findFullTableScans(const QSqlDatabase &db, const QStringList &queryList);
+
 private:
+    static const inline int fileStorageSchemaVersion = 6;
+
+    static void applyConnectionOptions(QSqlDatabase &db);
+    static void closeConnection(const QString &connectionName);
+
     static void createDbFileStorage();
+    static void migrateDbFileStorage();
+    static bool applyMigration(int schemaVersion, const QStringList &statementList); // Version is set only when every statement succeeds
+    static QString queryCreateTableFileVersionEntity(const QString &tableName);
+    static QStringList queryCreateTableBlobEntity();
     static void createDbFileMonitor();
     static QSqlDatabase dbFileStorage;
     static QSqlDatabase dbFileMonitor;
+
+    static QMutex poolMutex;
+    static QWaitCondition poolCondition;
+    static QMultiHash<QThread *, QString> idleConnections; // Connections can only be used by the thread that opened them
+    static ConnectionOptions connectionOptions;
+    static PoolMetrics poolMetrics;
 };
 
 #endif // DATABASEREGISTRY_H
@@ -0,0 +1,90 @@
+#include "DtoTypes.h"
+
+#include "JsonDtoFormat.h"
+
+QJsonObject FileVersionDto::toJson() const
+{
+    QJsonObject result;
+
+    result[JsonKeys::IsExist] = isExist;
+    result[JsonKeys::FileVersion::SymbolFilePath] = symbolFilePath;
+    result[JsonKeys::FileVersion::VersionNumber] = versionNumber;
+    result[JsonKeys::FileVersion::Size] = size;
+    result[JsonKeys::FileVersion::Timestamp] = timestamp.toString(Qt::DateFormat::TextDate);
+    result[JsonKeys::FileVersion::Description] = description;
+    result[JsonKeys::FileVersion::Hash] = hash;
+    result[JsonKeys::FileVersion::InternalFileName] = internalFileName;
+
+    result[JsonKeys::FileVersion::NewVersionNumber] = QJsonValue(QJsonValue::Type::Null);
+
+    return result;
+}
+
+QJsonObject FileDto::toJson() const
+{
+    QJsonObject result;
+
+    result[JsonKeys::IsExist] = isExist;
+    result[JsonKeys::File::FileName] = fileName;
+    result[JsonKeys::File::IsFrozen] = isFrozen;
+    result[JsonKeys::File::SymbolFolderPath] = symbolFolderPath;
+    result[JsonKeys::File::SymbolFilePath] = symbolFilePath;
+    result[JsonKeys::File::MaxVersionNumber] = maxVersionNumber;
+    result[JsonKeys::File::UserFilePath] = QJsonValue(QJsonValue::Type::Null);
+    result[JsonKeys::File::VersionList] = QJsonValue(QJsonValue::Type::Null);
+
+    if(!userFilePath.isEmpty())
+        result[JsonKeys::File::UserFilePath] = userFilePath;
+
+    if(!versionList.isEmpty())
+    {
+        QJsonArray jsonArrayVersionList;
+
+        for(const FileVersionDto &version : versionList)
+            jsonArrayVersionList.append(version.toJson());
+
+        result[JsonKeys::File::VersionList] = jsonArrayVersionList;
+    }
+
+    return result;
+}
+
+QJsonObject FolderDto::toJson() const
+{
+    QJsonObject result;
+
+    result[JsonKeys::IsExist] = isExist;
+    result[JsonKeys::Folder::ParentFolderPath] = parentFolderPath;
+    result[JsonKeys::Folder::SuffixPath] = suffixPath;
+    result[JsonKeys::Folder::SymbolFolderPath] = symbolFolderPath;
+    result[JsonKeys::Folder::IsFrozen] = isFrozen;
+
+    result[JsonKeys::Folder::UserFolderPath] = QJsonValue(QJsonValue::Type::Null);
+    result[JsonKeys::Folder::ChildFolders] = QJsonValue(QJsonValue::Type::Null);
+    result[JsonKeys::Folder::ChildFiles] = QJsonValue(QJsonValue::Type::Null);
+
+    if(!isFrozen)
+        result[JsonKeys::Folder::UserFolderPath] = userFolderPath;
+
+    if(!childFolders.isEmpty())
+    {
+        QJsonArray jsonArrayChildFolder;
+
+        for(const FolderDto &childFolder : childFolders)
+            jsonArrayChildFolder.append(childFolder.toJson());
+
+        result[JsonKeys::Folder::ChildFolders] = jsonArrayChildFolder;
+    }
+
+    if(!childFiles.isEmpty())
+    {
+        QJsonArray jsonArrayFileList;
+
+        for(const FileDto &childFile : childFiles)
+            jsonArrayFileList.append(childFile.toJson());
+
+        result[JsonKeys::Folder::ChildFiles] = jsonArrayFileList;
+    }
+
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef DTOTYPES_H
+#define DTOTYPES_H
+
+#include <QList>
+#include <QString>
+#include <QDateTime>
+#include <QJsonObject>
+
+// Typed counterparts of the json dtos described in JsonDtoFormat.h.
+// Used on internal paths, json is only produced where data leaves the backend (gui models, import & export).
+
+struct FileVersionDto
+{
+    bool isExist = false;
+    QString symbolFilePath;
+    qlonglong versionNumber = 0;
+    qlonglong size = 0;
+    QDateTime timestamp;
+    QString description;
+    QString hash;
+    QString internalFileName;
+
+    QJsonObject toJson() const;
+};
+
+struct FileDto
+{
+    bool isExist = false;
+    QString fileName;
+    QString symbolFolderPath;
+    QString symbolFilePath;
+    QString userFilePath; // Empty when file is frozen or its folder isn't monitored
+    bool isFrozen = false;
+    qlonglong maxVersionNumber = 0;
+    QList<FileVersionDto> versionList;
+
+    QJsonObject toJson() const;
+};
+
+struct FolderDto
+{
+    bool isExist = false;
+    QString parentFolderPath;
+    QString suffixPath;
+    QString symbolFolderPath;
+    QString userFolderPath; // Empty when folder is frozen
+    bool isFrozen = false;
+    QList<FolderDto> childFolders;
+    QList<FileDto> childFiles;
+
+    QJsonObject toJson() const;
+};
+
+#endif // DTOTYPES_H
@@ -0,0 +1,58 @@
+#include "FileSync.h"
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool FileSync::syncFile(QFile &file)
+{
+    if(!file.isOpen() || !file.flush()) // Bytes buffered by Qt never reached the OS yet
+        return false;
+
+    bool result = false;
+
+#if defined(Q_OS_WIN)
+    HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()));
+    result = handle != INVALID_HANDLE_VALUE && FlushFileBuffers(handle);
+#elif defined(Q_OS_DARWIN)
+    // Plain fsync() leaves the data in the drive cache on macOS
+    result = ::fcntl(file.handle(), F_FULLFSYNC) == 0 || ::fsync(file.handle()) == 0;
+#else
+    result = ::fsync(file.handle()) == 0;
+#endif
+
+    return result;
+}
+
+bool FileSync::syncFile(const QString &filePath)
+{
+    QFile file(filePath);
+
+    bool result = file.open(QFile::OpenModeFlag::ReadWrite | QFile::OpenModeFlag::ExistingOnly) && syncFile(file);
+
+    file.close();
+
+    return result;
+}
+
+bool FileSync::syncFolder(const QString &folderPath)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(folderPath);
+    return true; // Folder entries are journaled by NTFS, and folders can't be opened for flushing
+#else
+    int descriptor = ::open(QFile::encodeName(folderPath).constData(), O_RDONLY);
+
+    if(descriptor < 0)
+        return false;
+
+    bool result = ::fsync(descriptor) == 0;
+    ::close(descriptor);
+
+    return result;
+#endif
+}
@@ -0,0 +1,17 @@
+#ifndef FILESYNC_H
+#define FILESYNC_H
+
+#include <QFile>
+#include <QString>
+
+// Forces written content out of the OS cache onto the disk. A database row may only point to a file once this returns,
+// otherwise a power cut can leave a durable row and an empty or torn file behind it.
+class FileSync
+{
+public:
+    static bool syncFile(QFile &file); // File must be open for writing
+    static bool syncFile(const QString &filePath);
+    static bool syncFolder(const QString &folderPath); // Entries of newly created or renamed files are durable only after this
+};
+
+#endif // FILESYNC_H
@@ -0,0 +1,97 @@
+#ifndef MPSCRINGBUFFER_H
+#define MPSCRINGBUFFER_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+// Bounded lock free queue, any number of threads may push while a single thread pops.
+// Every slot carries a sequence number telling whose turn it is, so neither side ever blocks.
+template<typename T>
+class MpscRingBuffer
+{
+public:
+    // Capacity is rounded up to the next power of two
+    explicit MpscRingBuffer(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while(size < capacity)
+            size *= 2;
+
+        cells = std::make_unique<Cell[]>(size);
+        mask = size - 1;
+
+        for(std::size_t index = 0; index < size; ++index)
+            cells[index].sequence.store(index, std::memory_order_relaxed);
+
+        enqueuePosition.store(0, std::memory_order_relaxed);
+        dequeuePosition = 0;
+    }
+
+    MpscRingBuffer(const MpscRingBuffer &) = delete;
+    MpscRingBuffer &operator=(const MpscRingBuffer &) = delete;
+
+    // Returns false without touching item when buffer is full
+    bool tryPush(T &&item)
+    {
+        Cell *cell = nullptr;
+        std::size_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            cell = &cells[position & mask];
+            std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t difference = (std::ptrdiff_t) sequence - (std::ptrdiff_t) position;
+
+            if(difference == 0) // Slot is free, try to claim it
+            {
+                if(enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(difference < 0) // Slot still holds an item from the previous lap
+                return false;
+            else // Another producer claimed the slot
+                position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+
+        cell->data = std::move(item);
+        cell->sequence.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Must only be called from the consumer thread
+    bool tryPop(T &item)
+    {
+        Cell &cell = cells[dequeuePosition & mask];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+        if(sequence != dequeuePosition + 1) // Nothing published yet
+            return false;
+
+        item = std::move(cell.data);
+        cell.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+        ++dequeuePosition;
+
+        return true;
+    }
+
+    std::size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    alignas(64) std::atomic<std::size_t> enqueuePosition; // Kept apart from consumer position to avoid false sharing
+    alignas(64) std::size_t dequeuePosition;
+};
+
+#endif // MPSCRINGBUFFER_H
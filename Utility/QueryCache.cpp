@@ -0,0 +1,39 @@
+#include "QueryCache.h"
+
+QueryCache::QueryCache(const QSqlDatabase &db)
+{
+    database = db;
+}
+
+QueryCache::~QueryCache()
+{
+    clear();
+}
+
+QSqlQuery &QueryCache::prepare(const QString &queryTemplate)
+{
+    QSharedPointer<QSqlQuery> &query = queries[queryTemplate];
+
+    if(query.isNull())
+    {
+        query = QSharedPointer<QSqlQuery>::create(database);
+        query->setForwardOnly(true);
+    }
+    else if(preparedTemplates.contains(queryTemplate))
+    {
+        query->finish();
+        return *query;
+    }
+
+    // Failures (e.g. table not created yet) are prepared again on next call, exec() reports the error to the caller.
+    if(query->prepare(queryTemplate))
+        preparedTemplates.insert(queryTemplate);
+
+    return *query;
+}
+
+void QueryCache::clear()
+{
+    queries.clear();
+    preparedTemplates.clear();
+}
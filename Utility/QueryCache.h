@@ -0,0 +1,30 @@
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <QSet>
+#include <QHash>
+#include <QSqlQuery>
+#include <QSqlDatabase>
+#include <QSharedPointer>
+
+// Keeps one prepared statement per query template for a single connection.
+// Callers only rebind values, so SQL is parsed once per connection instead of once per call.
+class QueryCache
+{
+public:
+    QueryCache(const QSqlDatabase &db);
+    ~QueryCache();
+
+    // Returned query is reset and ready for binding. Queries are owned by the cache, so references stay valid
+    // while other templates are prepared (nested reads are fine) until clear(). Preparing the same template again resets it.
+    // Reads which stop before the last row should call finish() so the connection doesn't keep a read lock.
+    QSqlQuery &prepare(const QString &queryTemplate);
+    void clear();
+
+private:
+    QSqlDatabase database;
+    QHash<QString, QSharedPointer<QSqlQuery>> queries; // Heap allocated because QHash moves its values on rehash
+    QSet<QString> preparedTemplates;
+};
+
+#endif // QUERYCACHE_H